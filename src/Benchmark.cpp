@@ -0,0 +1,540 @@
+//
+//  Benchmark.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "Benchmark.h"
+#include "OSCRecorder.h"
+#include "Playlist.h"
+#include <ofxHapImage.h>
+#include <OscReceivedElements.h>
+#include <new>
+
+#if defined(BENCHMARK_ALLOCATIONS)
+/*
+ Heap allocations are counted per thread, only while a RouterScope is open on it. Replacing
+ operator new costs every allocation a thread-local test, so it is only built when
+ BENCHMARK_ALLOCATIONS is defined.
+ */
+#if defined(_MSC_VER)
+#define BENCHMARK_THREAD_LOCAL __declspec(thread)
+#else
+#define BENCHMARK_THREAD_LOCAL __thread
+#endif
+
+static BENCHMARK_THREAD_LOCAL bool counting_allocations = false;
+static BENCHMARK_THREAD_LOCAL unsigned long allocation_count = 0;
+
+void *operator new(std::size_t size)
+{
+    if (counting_allocations)
+    {
+        allocation_count++;
+    }
+    void *result = malloc(size == 0 ? 1 : size);
+    if (result == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) throw()
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer) throw()
+{
+    free(pointer);
+}
+#else
+static bool counting_allocations = false;
+static const unsigned long allocation_count = 0;
+#endif
+
+/*
+ Calls function with the address of each message in the packet
+ */
+template <typename Function>
+static void forEachMessage(const osc::ReceivedBundle& bundle, Function& function)
+{
+    for (osc::ReceivedBundle::const_iterator it = bundle.ElementsBegin(); it != bundle.ElementsEnd(); ++it) {
+        if (it->IsBundle())
+        {
+            forEachMessage(osc::ReceivedBundle(*it), function);
+        }
+        else
+        {
+            function(osc::ReceivedMessage(*it).AddressPattern());
+        }
+    }
+}
+
+template <typename Function>
+static void forEachMessage(const char *data, int size, Function& function)
+{
+    osc::ReceivedPacket packet(data, size);
+    if (packet.IsBundle())
+    {
+        forEachMessage(osc::ReceivedBundle(packet), function);
+    }
+    else
+    {
+        function(osc::ReceivedMessage(packet).AddressPattern());
+    }
+}
+
+/*
+ Counts the messages in a recorded packet, and notes the first client ID and the outputs of
+ that client addressed by them
+ */
+class RecordedAddresses {
+public:
+    RecordedAddresses(std::string& client_id, std::vector<std::string>& outputs)
+    : client_id_(client_id), outputs_(outputs), messages_(0) {}
+    void operator()(const char *address)
+    {
+        messages_++;
+        std::vector<std::string> segments = ofSplitString(address, "/", true, true);
+        if (segments.size() < 3 || segments[0] != "client")
+        {
+            return;
+        }
+        if (client_id_.empty())
+        {
+            client_id_ = segments[1];
+        }
+        if (segments[1] == client_id_ && segments.size() >= 4 && segments[2] == "output"
+            && std::find(outputs_.begin(), outputs_.end(), segments[3]) == outputs_.end())
+        {
+            outputs_.push_back(segments[3]);
+        }
+    }
+    unsigned int getMessageCount() const { return messages_; }
+private:
+    std::string& client_id_;
+    std::vector<std::string>& outputs_;
+    unsigned int messages_;
+};
+
+Benchmark::Settings::Settings()
+: report("benchmark.json"), outputs(12), message_rate(720), frames(10000), frame_rate(60), duration(30)
+{
+
+}
+
+bool Benchmark::parseArguments(int argc, char *argv[], Settings& settings)
+{
+    bool found = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--benchmark")
+        {
+            found = true;
+            continue;
+        }
+        std::string::size_type equals = argument.find('=');
+        if (!found || equals == std::string::npos)
+        {
+            continue;
+        }
+        std::string key = argument.substr(0, equals);
+        std::string value = argument.substr(equals + 1);
+        if (key == "source")
+        {
+            settings.source = value;
+        }
+        else if (key == "report")
+        {
+            settings.report = value;
+        }
+        else if (key == "outputs")
+        {
+            settings.outputs = std::max(ofToInt(value), 1);
+        }
+        else if (key == "rate")
+        {
+            settings.message_rate = std::max(ofToFloat(value), 0.0f);
+        }
+        else if (key == "frames")
+        {
+            settings.frames = std::max(ofToInt(value), 1);
+        }
+        else if (key == "fps")
+        {
+            settings.frame_rate = std::max(ofToFloat(value), 1.0f);
+        }
+        else if (key == "duration")
+        {
+            settings.duration = std::max(ofToFloat(value), 0.0f);
+        }
+        else if (key == "messages")
+        {
+            settings.messages = value;
+        }
+        else
+        {
+            ofLogWarning("Benchmark") << "Ignoring unknown argument " << argument;
+        }
+    }
+    return found;
+}
+
+Benchmark::Benchmark(const Settings& settings)
+: settings_(settings), client_id_("benchmark"), start_(0), last_update_(0), started_(false),
+frame_number_(0), messages_sent_(0), frame_numbers_sent_(0), updates_(0), playlist_load_time_(0),
+recorded_duration_(0), replay_index_(0), replay_base_(0)
+{
+    for (unsigned int i = 0; i < settings_.outputs; i++)
+    {
+        output_names_.push_back(ofToString(i + 1));
+    }
+}
+
+Benchmark::RouterCost::RouterCost()
+: messages(0), micros(0), allocations(0)
+{
+
+}
+
+void Benchmark::RouterCost::add(unsigned long count, uint64_t duration, unsigned long allocated)
+{
+    messages += count;
+    micros += duration;
+    allocations += allocated;
+}
+
+Benchmark::RouterScope::RouterScope(Benchmark *benchmark, RouterPhase phase, OSCRouter::Leaf leaf)
+: benchmark_(benchmark), phase_(phase), leaf_(leaf), messages_(1), start_(0), allocations_(0)
+{
+    if (benchmark_)
+    {
+        counting_allocations = true;
+        allocations_ = allocation_count;
+        start_ = ofGetElapsedTimeMicros();
+    }
+}
+
+Benchmark::RouterScope::~RouterScope()
+{
+    if (benchmark_)
+    {
+        uint64_t duration = ofGetElapsedTimeMicros() - start_;
+        unsigned long allocations = allocation_count - allocations_;
+        counting_allocations = false;
+        benchmark_->router_costs_[phase_].add(messages_, duration, allocations);
+        if (phase_ == RouterDispatch)
+        {
+            benchmark_->leaf_costs_[leaf_].add(messages_, duration, allocations);
+        }
+    }
+}
+
+void Benchmark::RouterScope::setMessageCount(unsigned long count)
+{
+    messages_ = count;
+}
+
+std::string Benchmark::setup()
+{
+    std::vector<std::string> frames;
+    ofDirectory directory(settings_.source);
+    if (directory.isDirectory())
+    {
+        directory.allowExt(ofxHapImage::HapImageFileExtension());
+        directory.listDir();
+        directory.sort();
+        for (unsigned int i = 0; i < directory.size(); i++)
+        {
+            frames.push_back(directory.getPath(i));
+        }
+    }
+    else
+    {
+        frames.push_back(settings_.source);
+    }
+    if (settings_.source.empty() || frames.empty())
+    {
+        ofLogError("Benchmark") << "No source frames in \"" << settings_.source << "\"";
+    }
+
+    /*
+     A playlist of one <file> per frame, cycling through the source frames
+     */
+    std::string playlist_path = ofToDataPath("benchmark_playlist.xml");
+    std::ofstream playlist(playlist_path.c_str());
+    playlist << "<playlist>\n";
+    for (unsigned int i = 0; i < settings_.frames && !frames.empty(); i++)
+    {
+        playlist << "\t<file>" << frames[i % frames.size()] << "</file>\n";
+    }
+    playlist << "</playlist>\n";
+    playlist.close();
+
+    /*
+     Time parsing on its own; the client loads its copy in the background
+     */
+    {
+        Playlist playlist;
+        uint64_t load_start = ofGetElapsedTimeMicros();
+        playlist.load(playlist_path);
+        playlist_load_time_ = ofGetElapsedTimeMicros() - load_start;
+    }
+
+    if (!settings_.messages.empty())
+    {
+        loadMessages();
+    }
+    return playlist_path;
+}
+
+bool Benchmark::loadMessages()
+{
+    FILE *file = fopen(ofToDataPath(settings_.messages, true).c_str(), "rb");
+    OSCRecorder::Header header;
+    if (file == NULL || fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, OSCRecorder::Magic, sizeof(header.magic)) != 0
+        || header.version != OSCRecorder::Version)
+    {
+        ofLogError("Benchmark") << "Unable to read an OSC log from " << settings_.messages;
+        if (file)
+        {
+            fclose(file);
+        }
+        return false;
+    }
+    std::string client_id;
+    std::vector<std::string> outputs;
+    RecordedAddresses addresses(client_id, outputs);
+    OSCRecorder::RecordHeader record;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        RecordedPacket packet;
+        packet.offset = record.offset;
+        packet.endpoint = IpEndpointName(record.address, record.port);
+        packet.start = recorded_data_.size();
+        packet.size = record.size;
+        recorded_data_.resize(packet.start + record.size);
+        if (record.size == 0 || fread(&recorded_data_[packet.start], 1, record.size, file) != record.size)
+        {
+            recorded_data_.resize(packet.start);
+            break;
+        }
+        unsigned int before = addresses.getMessageCount();
+        try {
+            forEachMessage(&recorded_data_[packet.start], packet.size, addresses);
+        } catch (osc::Exception& e) {
+            ofLogWarning("Benchmark") << "Skipping a malformed recorded packet: " << e.what();
+            recorded_data_.resize(packet.start);
+            continue;
+        }
+        packet.messages = addresses.getMessageCount() - before;
+        recorded_.push_back(packet);
+    }
+    fclose(file);
+    if (recorded_.empty())
+    {
+        ofLogError("Benchmark") << "No packets in " << settings_.messages;
+        return false;
+    }
+    /*
+     Loop no faster than one pass per frame, so a recording of a single packet doesn't stall
+     */
+    recorded_duration_ = std::max(recorded_.back().offset - recorded_.front().offset, uint64_t(1000000.0 / settings_.frame_rate));
+    if (!client_id.empty())
+    {
+        client_id_ = client_id;
+    }
+    if (!outputs.empty())
+    {
+        output_names_ = outputs;
+    }
+    ofLogNotice("Benchmark") << "Replaying " << addresses.getMessageCount() << " messages in " << recorded_.size()
+        << " packets to client \"" << client_id_ << "\" with " << output_names_.size() << " outputs";
+    return true;
+}
+
+const std::string& Benchmark::getClientID() const
+{
+    return client_id_;
+}
+
+unsigned int Benchmark::getOutputCount() const
+{
+    return output_names_.size();
+}
+
+std::string Benchmark::getOutputName(unsigned int index) const
+{
+    return output_names_[index];
+}
+
+void Benchmark::update(OSCReceiveThread& receiver)
+{
+    uint64_t now = ofGetElapsedTimeMicros();
+    if (!started_)
+    {
+        start_ = now;
+        started_ = true;
+    }
+    last_update_ = now;
+    updates_++;
+    double elapsed = (now - start_) / 1000000.0;
+
+    if (!recorded_.empty())
+    {
+        replayMessages(receiver, now);
+        return;
+    }
+
+    long due_frame = elapsed * settings_.frame_rate;
+    while (frame_number_ < due_frame)
+    {
+        frame_number_++;
+        ofxOscMessage message;
+        message.setAddress("/frame_number");
+        message.addInt64Arg(frame_number_);
+        inject(receiver, message, now);
+        frame_numbers_sent_++;
+    }
+
+    /*
+     Cycle through every output and every crop, warp and blend address
+     */
+    const int first_leaf = OSCRouter::LeafCropX;
+    const int leaf_count = OSCRouter::LeafBlendBottom - first_leaf + 1;
+    unsigned long due_messages = elapsed * settings_.message_rate;
+    while (messages_sent_ < due_messages)
+    {
+        unsigned int output = messages_sent_ % output_names_.size();
+        OSCRouter::Leaf leaf = OSCRouter::Leaf(first_leaf + ((messages_sent_ / output_names_.size()) % leaf_count));
+        ofxOscMessage message;
+        message.setAddress("/client/" + client_id_ + "/output/" + getOutputName(output) + OSCRouter::getLeafAddress(leaf));
+        message.addFloatArg(10.0 + (10.0 * sin(messages_sent_ * 0.01)));
+        inject(receiver, message, now);
+        messages_sent_++;
+    }
+}
+
+bool Benchmark::isFinished() const
+{
+    return started_ && (last_update_ - start_) >= settings_.duration * 1000000.0;
+}
+
+void Benchmark::replayMessages(OSCReceiveThread& receiver, uint64_t now)
+{
+    uint64_t elapsed = now - start_;
+    const uint64_t first_offset = recorded_.front().offset;
+    while (replay_base_ + (recorded_[replay_index_].offset - first_offset) <= elapsed)
+    {
+        const RecordedPacket& packet = recorded_[replay_index_];
+        {
+            RouterScope scope(this, RouterInject);
+            scope.setMessageCount(packet.messages);
+            receiver.replay(&recorded_data_[packet.start], packet.size, now, packet.endpoint);
+        }
+        messages_sent_ += packet.messages;
+        if (++replay_index_ == recorded_.size())
+        {
+            replay_index_ = 0;
+            replay_base_ += recorded_duration_;
+        }
+    }
+}
+
+void Benchmark::inject(OSCReceiveThread& receiver, const ofxOscMessage& message, uint64_t now)
+{
+    bool queued;
+    {
+        RouterScope scope(this, RouterInject);
+        queued = receiver.inject(message, now, 0);
+    }
+    if (!queued)
+    {
+        ofLogWarning("Benchmark") << "Receive queue full";
+    }
+}
+
+bool Benchmark::writeReport(const StageTimings& timings) const
+{
+    double elapsed = (last_update_ - start_) / 1000000.0;
+    std::ofstream report(ofToDataPath(settings_.report).c_str());
+    report << "{\n";
+    report << "\t\"workload\": {\n";
+    report << "\t\t\"source\": \"" << settings_.source << "\",\n";
+    report << "\t\t\"outputs\": " << output_names_.size() << ",\n";
+    report << "\t\t\"messages\": \"" << settings_.messages << "\",\n";
+    report << "\t\t\"messages_per_second\": " << settings_.message_rate << ",\n";
+    report << "\t\t\"frames\": " << settings_.frames << ",\n";
+    report << "\t\t\"frames_per_second\": " << settings_.frame_rate << ",\n";
+    report << "\t\t\"duration\": " << settings_.duration << "\n";
+    report << "\t},\n";
+    report << "\t\"playlist_load_ms\": " << playlist_load_time_ / 1000.0 << ",\n";
+    report << "\t\"elapsed_seconds\": " << elapsed << ",\n";
+    report << "\t\"updates\": " << updates_ << ",\n";
+    report << "\t\"frame_numbers_sent\": " << frame_numbers_sent_ << ",\n";
+    report << "\t\"messages_sent\": " << messages_sent_ << ",\n";
+    report << "\t\"updates_per_second\": " << (elapsed > 0.0 ? updates_ / elapsed : 0.0) << ",\n";
+    report << "\t\"messages_per_second\": " << (elapsed > 0.0 ? (messages_sent_ + frame_numbers_sent_) / elapsed : 0.0) << ",\n";
+    report << "\t\"stages_ms\": {\n";
+    for (int i = 0; i < StageTimings::StageCount; i++)
+    {
+        StageTimings::Stage stage = StageTimings::Stage(i);
+        StageTimings::Summary summary = timings.getSummary(stage);
+        report << "\t\t\"" << StageTimings::getName(stage) << "\": {";
+        report << "\"samples\": " << summary.samples;
+        report << ", \"p50\": " << summary.p50 / 1000.0;
+        report << ", \"p99\": " << summary.p99 / 1000.0;
+        report << ", \"max\": " << summary.max / 1000.0;
+        report << "}" << (i + 1 < StageTimings::StageCount ? "," : "") << "\n";
+    }
+    report << "\t},\n";
+    report << "\t\"router\": {\n";
+    writeRouterCost(report, "inject", router_costs_[RouterInject]);
+    report << ",\n";
+    writeRouterCost(report, "drain", router_costs_[RouterDrain]);
+    report << ",\n";
+    writeRouterCost(report, "dispatch", router_costs_[RouterDispatch]);
+    report << ",\n";
+    report << "\t\t\"dispatch_by_address\": {";
+    bool first = true;
+    for (int i = 0; i < OSCRouter::LeafCount; i++)
+    {
+        if (leaf_costs_[i].messages > 0)
+        {
+            report << (first ? "\n" : ",\n") << "\t";
+            writeRouterCost(report, i == OSCRouter::LeafUnknown ? "unknown" : OSCRouter::getLeafAddress(OSCRouter::Leaf(i)), leaf_costs_[i]);
+            first = false;
+        }
+    }
+    report << "\n\t\t}\n";
+    report << "\t}\n";
+    report << "}\n";
+    report.close();
+    if (!report)
+    {
+        ofLogError("Benchmark") << "Unable to write report to " << settings_.report;
+        return false;
+    }
+    ofLogNotice("Benchmark") << "Report written to " << settings_.report;
+    return true;
+}
+
+void Benchmark::writeRouterCost(std::ostream& report, const char *name, const RouterCost& cost)
+{
+    report << "\t\t\"" << name << "\": {";
+    report << "\"messages\": " << cost.messages;
+    report << ", \"us_per_message\": " << (cost.messages > 0 ? double(cost.micros) / cost.messages : 0.0);
+#if defined(BENCHMARK_ALLOCATIONS)
+    report << ", \"allocations_per_message\": " << (cost.messages > 0 ? double(cost.allocations) / cost.messages : 0.0);
+#endif
+    report << "}";
+}
@@ -0,0 +1,134 @@
+//
+//  Benchmark.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__Benchmark__
+#define __MediaPlayer_client__Benchmark__
+
+#include "ofMain.h"
+#include "OSCReceiveThread.h"
+#include "StageTimings.h"
+
+/*
+ Drives the client from a scripted workload without a window or controller, and reports
+ the time taken by each stage of update() as JSON.
+
+ Run as
+
+    MediaPlayer_client --benchmark source=<.hpz file or folder> [outputs=12] [rate=720]
+        [frames=10000] [fps=60] [duration=30] [report=benchmark.json] [messages=<OSC log>]
+
+ A playlist of frames entries is generated which cycles through the source frames. Frame
+ numbers are sent at fps, and rate warp, crop and blend messages per second are spread
+ across the outputs. The time taken to load the playlist is reported too, so large values
+ of frames also benchmark playlist parsing.
+
+ If messages names a log written by OSCRecorder, its packets are sent in a loop at their
+ recorded intervals instead, and the client ID and outputs are taken from the addresses
+ in it. Either way the router stage reports the time per message of queueing, draining and
+ dispatching, the last by address, and heap allocations per message if built with
+ BENCHMARK_ALLOCATIONS defined.
+ */
+class Benchmark {
+public:
+    struct Settings {
+        Settings();
+        std::string source;
+        std::string report;
+        unsigned int outputs;
+        float message_rate;
+        unsigned int frames;
+        float frame_rate;
+        float duration;
+        std::string messages;
+    };
+    enum RouterPhase {
+        // Parsing and queueing on the receive side
+        RouterInject,
+        // Taking messages from the queue on the render thread
+        RouterDrain,
+        // Acting on each message
+        RouterDispatch,
+        RouterPhaseCount
+    };
+    /*
+     Adds the time, and heap allocations if counted, of the calling thread over the
+     enclosing scope to the router stage. Does nothing if benchmark is NULL.
+     */
+    class RouterScope {
+    public:
+        RouterScope(Benchmark *benchmark, RouterPhase phase, OSCRouter::Leaf leaf = OSCRouter::LeafUnknown);
+        ~RouterScope();
+        /*
+         The number of messages the scope covers, 1 by default
+         */
+        void setMessageCount(unsigned long count);
+    private:
+        Benchmark *benchmark_;
+        RouterPhase phase_;
+        OSCRouter::Leaf leaf_;
+        unsigned long messages_;
+        uint64_t start_;
+        unsigned long allocations_;
+    };
+    /*
+     Returns true if the arguments request a benchmark, filling settings from them
+     */
+    static bool parseArguments(int argc, char *argv[], Settings& settings);
+    Benchmark(const Settings& settings);
+    /*
+     Returns the path to the generated playlist to use as the source
+     */
+    std::string setup();
+    const std::string& getClientID() const;
+    unsigned int getOutputCount() const;
+    std::string getOutputName(unsigned int index) const;
+    /*
+     Injects messages due since the last call
+     */
+    void update(OSCReceiveThread& receiver);
+    bool isFinished() const;
+    bool writeReport(const StageTimings& timings) const;
+private:
+    struct RouterCost {
+        RouterCost();
+        void add(unsigned long messages, uint64_t micros, unsigned long allocations);
+        unsigned long messages;
+        uint64_t micros;
+        unsigned long allocations;
+    };
+    struct RecordedPacket {
+        uint64_t offset;
+        IpEndpointName endpoint;
+        size_t start;
+        int size;
+        unsigned int messages;
+    };
+    bool loadMessages();
+    void replayMessages(OSCReceiveThread& receiver, uint64_t now);
+    void inject(OSCReceiveThread& receiver, const ofxOscMessage& message, uint64_t now);
+    static void writeRouterCost(std::ostream& report, const char *name, const RouterCost& cost);
+    Settings settings_;
+    std::string client_id_;
+    std::vector<std::string> output_names_;
+    uint64_t start_;
+    uint64_t last_update_;
+    bool started_;
+    long frame_number_;
+    unsigned long messages_sent_;
+    unsigned long frame_numbers_sent_;
+    unsigned long updates_;
+    uint64_t playlist_load_time_;
+    std::vector<RecordedPacket> recorded_;
+    std::vector<char> recorded_data_;
+    uint64_t recorded_duration_;
+    size_t replay_index_;
+    // When the current pass through the recording started, relative to start_
+    uint64_t replay_base_;
+    RouterCost router_costs_[RouterPhaseCount];
+    RouterCost leaf_costs_[OSCRouter::LeafCount];
+};
+
+#endif /* defined(__MediaPlayer_client__Benchmark__) */
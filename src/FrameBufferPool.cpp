@@ -0,0 +1,178 @@
+//
+//  FrameBufferPool.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FrameBufferPool.h"
+
+/*
+ Buffers smaller than this share one class
+ */
+static const size_t MinimumClass = 64 * 1024;
+
+FrameBufferPool::Statistics::Statistics()
+: allocations(0), reuses(0), in_use(0), high_water(0), retained(0)
+{ }
+
+FrameBufferPool& FrameBufferPool::getShared()
+{
+    static FrameBufferPool *pool = new FrameBufferPool();
+    return *pool;
+}
+
+FrameBufferPool::FrameBufferPool()
+: retained_limit_(256 * 1024 * 1024)
+{ }
+
+FrameBufferPool::~FrameBufferPool()
+{
+    trim();
+}
+
+size_t FrameBufferPool::getSizeClass(size_t size)
+{
+    if (size <= MinimumClass)
+    {
+        return MinimumClass;
+    }
+    size_t power = MinimumClass;
+    while (power * 2 < size)
+    {
+        power *= 2;
+    }
+    // power < size <= power * 2, in steps of a quarter of power
+    size_t step = power / 4;
+    return power + ((size - power + step - 1) / step) * step;
+}
+
+FrameBufferPool::Buffer FrameBufferPool::acquire(size_t size)
+{
+    size_t size_class = getSizeClass(size);
+    ofBuffer *buffer = NULL;
+    {
+        ofScopedLock lock(mutex_);
+        std::map<size_t, std::vector<ofBuffer *> >::iterator found = free_.find(size_class);
+        if (found != free_.end() && !found->second.empty())
+        {
+            buffer = found->second.back();
+            found->second.pop_back();
+            statistics_.retained -= size_class;
+            statistics_.reuses++;
+        }
+        else
+        {
+            statistics_.allocations++;
+        }
+        statistics_.in_use += size_class;
+        statistics_.high_water = std::max(statistics_.high_water, statistics_.in_use);
+    }
+    if (buffer == NULL)
+    {
+        /*
+         Allocate the whole class so any size in it can later be set without reallocating
+         */
+        buffer = new ofBuffer();
+        buffer->allocate(size_class);
+    }
+    buffer->allocate(size);
+    Recycler recycler = {this, size_class};
+    return Buffer(buffer, recycler);
+}
+
+void FrameBufferPool::Recycler::operator()(ofBuffer *buffer) const
+{
+    pool->recycle(buffer, size_class);
+}
+
+void FrameBufferPool::recycle(ofBuffer *buffer, size_t size_class)
+{
+    ofScopedLock lock(mutex_);
+    statistics_.in_use -= size_class;
+    if (statistics_.retained + size_class > retained_limit_)
+    {
+        delete buffer;
+        return;
+    }
+    free_[size_class].push_back(buffer);
+    statistics_.retained += size_class;
+}
+
+void FrameBufferPool::setRetainedLimit(uint64_t bytes)
+{
+    ofScopedLock lock(mutex_);
+    retained_limit_ = bytes;
+    trimTo(bytes);
+}
+
+void FrameBufferPool::trim()
+{
+    ofScopedLock lock(mutex_);
+    trimTo(0);
+}
+
+uint64_t FrameBufferPool::getMemoryUsage() const
+{
+    ofScopedLock lock(mutex_);
+    return statistics_.retained;
+}
+
+bool FrameBufferPool::getEvictionCandidate(uint64_t& bytes, double& value) const
+{
+    ofScopedLock lock(mutex_);
+    std::map<size_t, std::vector<ofBuffer *> >::const_reverse_iterator largest = findLargestFree();
+    if (largest == free_.rend())
+    {
+        return false;
+    }
+    bytes = largest->first;
+    value = 0.0;
+    return true;
+}
+
+void FrameBufferPool::evictCandidate()
+{
+    ofScopedLock lock(mutex_);
+    std::map<size_t, std::vector<ofBuffer *> >::const_reverse_iterator largest = findLargestFree();
+    if (largest != free_.rend())
+    {
+        trimTo(statistics_.retained - largest->first);
+    }
+}
+
+/*
+ The largest size class with a free buffer. Called with mutex_ locked.
+ */
+std::map<size_t, std::vector<ofBuffer *> >::const_reverse_iterator FrameBufferPool::findLargestFree() const
+{
+    std::map<size_t, std::vector<ofBuffer *> >::const_reverse_iterator it = free_.rbegin();
+    while (it != free_.rend() && it->second.empty())
+    {
+        ++it;
+    }
+    return it;
+}
+
+void FrameBufferPool::trimTo(uint64_t bytes)
+{
+    /*
+     Release the largest buffers first, as they're the least likely to be shared
+     */
+    std::map<size_t, std::vector<ofBuffer *> >::reverse_iterator it = free_.rbegin();
+    while (statistics_.retained > bytes && it != free_.rend())
+    {
+        while (statistics_.retained > bytes && !it->second.empty())
+        {
+            delete it->second.back();
+            it->second.pop_back();
+            statistics_.retained -= it->first;
+        }
+        ++it;
+    }
+}
+
+FrameBufferPool::Statistics FrameBufferPool::getStatistics() const
+{
+    ofScopedLock lock(mutex_);
+    return statistics_;
+}
@@ -0,0 +1,72 @@
+//
+//  FrameBufferPool.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FrameBufferPool__
+#define __MediaPlayer_client__FrameBufferPool__
+
+#include "ofMain.h"
+#include "MemoryGovernor.h"
+
+/*
+ Recycles the buffers frames are read and decompressed into, so playback doesn't allocate
+ and free several megabytes for every frame.
+
+ Sizes are rounded up to size classes a quarter of a power of two apart, so frames of
+ slightly different sizes share buffers. A buffer returns to the pool when its last
+ reference is released, and is reused by the next request in its class from any source.
+ Free buffers beyond the retained limit are released to the system.
+
+ As a MemoryConsumer only free buffers are counted, as buffers in use are counted by the
+ caches holding them. Free buffers have no value, so they are the first to go, the largest
+ one at a time.
+ */
+class FrameBufferPool : public MemoryConsumer {
+public:
+    typedef std::shared_ptr<ofBuffer> Buffer;
+    struct Statistics {
+        Statistics();
+        unsigned long allocations;
+        unsigned long reuses;
+        uint64_t in_use;
+        uint64_t high_water;
+        uint64_t retained;
+    };
+    /*
+     The pool shared by every source. It is never destroyed, so buffers may outlive the app.
+     */
+    static FrameBufferPool& getShared();
+    FrameBufferPool();
+    ~FrameBufferPool();
+    /*
+     Returns a buffer of size bytes. Its contents are undefined.
+     */
+    Buffer acquire(size_t size);
+    void setRetainedLimit(uint64_t bytes);
+    /*
+     Releases every free buffer
+     */
+    void trim();
+    Statistics getStatistics() const;
+    uint64_t getMemoryUsage() const;
+    bool getEvictionCandidate(uint64_t& bytes, double& value) const;
+    void evictCandidate();
+private:
+    struct Recycler {
+        FrameBufferPool *pool;
+        size_t size_class;
+        void operator()(ofBuffer *buffer) const;
+    };
+    static size_t getSizeClass(size_t size);
+    void recycle(ofBuffer *buffer, size_t size_class);
+    void trimTo(uint64_t bytes);
+    std::map<size_t, std::vector<ofBuffer *> >::const_reverse_iterator findLargestFree() const;
+    mutable ofMutex mutex_;
+    std::map<size_t, std::vector<ofBuffer *> > free_;
+    uint64_t retained_limit_;
+    Statistics statistics_;
+};
+
+#endif /* defined(__MediaPlayer_client__FrameBufferPool__) */
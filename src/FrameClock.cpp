@@ -0,0 +1,201 @@
+//
+//  FrameClock.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FrameClock.h"
+
+/*
+ Filter gains: a small alpha smooths arrival jitter, beta is chosen for critical damping
+ */
+static const double Alpha = 0.1;
+static const double Beta = (Alpha * Alpha) / (2.0 - Alpha);
+// A residual larger than this (in frames) is treated as a discontinuity and reacquired
+static const double SnapThreshold = 4.0;
+// Observations within a frame of prediction needed before the clock is trusted
+static const int LockObservations = 8;
+// Consecutive observations a frame or more from prediction which lose the lock
+static const int UnlockObservations = 4;
+// Once locked, the largest residual (in frames) one observation may correct by, so a
+// single late packet doesn't pull the estimates
+static const double MaxCorrection = 1.0;
+// How fast the time tag offset may drift upwards, in seconds per second
+static const double OffsetDrift = 0.001;
+
+FrameClock::FrameClock()
+: gap_limit_(0.5)
+{
+    reset();
+}
+
+void FrameClock::reset()
+{
+    observations_ = 0;
+    stable_observations_ = 0;
+    unstable_observations_ = 0;
+    position_ = 0.0;
+    time_ = 0.0;
+    rate_ = 0.0;
+    residual_ = 0.0;
+    origin_ = 0;
+    has_origin_ = false;
+    offset_ = 0.0;
+    has_offset_ = false;
+    last_arrival_ = 0.0;
+}
+
+void FrameClock::setGapLimit(double seconds)
+{
+    gap_limit_ = seconds;
+}
+
+double FrameClock::getSampleTime(uint64_t arrival_micros, uint64_t time_tag)
+{
+    if (!has_origin_)
+    {
+        origin_ = arrival_micros;
+        has_origin_ = true;
+    }
+    double arrival = (double(int64_t(arrival_micros - origin_))) / 1000000.0;
+    last_arrival_ = arrival;
+    /*
+     A time tag of 1 means "immediately" and carries no timing information
+     */
+    if (time_tag > 1)
+    {
+        double tag = double(time_tag >> 32) + (double(time_tag & 0xFFFFFFFF) / 4294967296.0);
+        double offset = arrival - tag;
+        if (!has_offset_)
+        {
+            offset_ = offset;
+            has_offset_ = true;
+        }
+        else
+        {
+            /*
+             Transit time only adds delay, so the smallest offset is the truest. Let it rise
+             slowly so clock drift between hosts is followed.
+             */
+            offset_ = std::min(offset_ + (OffsetDrift * (arrival - time_)), offset);
+        }
+        return tag + offset_;
+    }
+    return arrival;
+}
+
+void FrameClock::resetFrame(long frame, uint64_t arrival_micros, uint64_t time_tag)
+{
+    double time = getSampleTime(arrival_micros, time_tag);
+    position_ = frame;
+    time_ = time;
+    residual_ = 0.0;
+    if (observations_ == 0)
+    {
+        observations_ = 1;
+    }
+}
+
+void FrameClock::addFrame(long frame, uint64_t arrival_micros, uint64_t time_tag)
+{
+    double time = getSampleTime(arrival_micros, time_tag);
+    if (observations_ == 0)
+    {
+        position_ = frame;
+        time_ = time;
+        observations_ = 1;
+        return;
+    }
+    double elapsed = time - time_;
+    if (elapsed <= 0.0)
+    {
+        /*
+         Messages in one bundle share a time, so can't inform the rate
+         */
+        return;
+    }
+    if (observations_ == 1 || rate_ <= 0.0)
+    {
+        rate_ = (frame - position_) / elapsed;
+        position_ = frame;
+        time_ = time;
+        observations_++;
+        return;
+    }
+
+    double predicted = position_ + (rate_ * elapsed);
+    residual_ = frame - predicted;
+    if (fabs(residual_) > SnapThreshold)
+    {
+        /*
+         Reacquire from here. A locked rate is kept, as a jump in frame numbers doesn't
+         change it, but if we snap again before relocking it is measured afresh from the
+         next frame.
+         */
+        observations_ = isLocked() ? 2 : 1;
+        stable_observations_ = 0;
+        unstable_observations_ = 0;
+        position_ = frame;
+        time_ = time;
+        return;
+    }
+    /*
+     Until the fixed gains are reached, use those of a least-squares fit to every observation
+     since acquiring, so the first estimates aren't dominated by the jitter of the first two
+     */
+    double n = observations_;
+    double alpha = std::max(Alpha, (2.0 * ((2.0 * n) - 1.0)) / (n * (n + 1.0)));
+    double beta = std::max(Beta, 6.0 / (n * (n + 1.0)));
+    double correction = residual_;
+    if (isLocked())
+    {
+        correction = std::max(-MaxCorrection, std::min(correction, MaxCorrection));
+    }
+    /*
+     A late frame followed closely by the next would divide the correction by almost nothing,
+     so correct the rate over at least a frame interval
+     */
+    position_ = predicted + (alpha * correction);
+    rate_ += (beta * correction) / std::max(elapsed, 1.0 / rate_);
+    time_ = time;
+    observations_++;
+    if (fabs(residual_) < 1.0)
+    {
+        stable_observations_++;
+        unstable_observations_ = 0;
+    }
+    else if (++unstable_observations_ >= UnlockObservations || !isLocked())
+    {
+        stable_observations_ = 0;
+    }
+}
+
+bool FrameClock::isLocked() const
+{
+    return stable_observations_ >= LockObservations && rate_ > 0.0;
+}
+
+bool FrameClock::getFrame(uint64_t time_micros, long& frame) const
+{
+    if (!isLocked())
+    {
+        return false;
+    }
+    double now = (double(int64_t(time_micros - origin_))) / 1000000.0;
+    if (now - last_arrival_ > gap_limit_)
+    {
+        return false;
+    }
+    frame = floor(position_ + (rate_ * (now - time_)) + 0.5);
+    return true;
+}
+
+double FrameClock::getFrameRate() const
+{
+    return rate_;
+}
+
+double FrameClock::getResidual() const
+{
+    return residual_;
+}
@@ -0,0 +1,60 @@
+//
+//  FrameClock.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FrameClock__
+#define __MediaPlayer_client__FrameClock__
+
+#include "ofMain.h"
+
+/*
+ Estimates the server's frame rate and phase from the times frame numbers arrive, so the
+ frame due at any moment can be predicted rather than waiting for its packet.
+
+ An alpha-beta filter tracks phase and rate. Once locked, an occasional late frame neither
+ unlocks the clock nor pulls the estimates by more than a frame. Where messages came in a
+ bundle with a time tag, the tag (mapped to the local clock by the smallest observed
+ transit offset) is used in place of the arrival time, removing network jitter.
+ */
+class FrameClock {
+public:
+    FrameClock();
+    void reset();
+    /*
+     Restart at frame without forgetting the estimated rate, for a discontinuous frame number.
+     */
+    void resetFrame(long frame, uint64_t arrival_micros, uint64_t time_tag);
+    void addFrame(long frame, uint64_t arrival_micros, uint64_t time_tag);
+    bool isLocked() const;
+    /*
+     Sets frame to the frame due at time_micros and returns true, or returns false if the
+     clock isn't locked or nothing has been received for longer than the gap limit.
+     */
+    bool getFrame(uint64_t time_micros, long& frame) const;
+    double getFrameRate() const;
+    // The difference between the last received and predicted frame numbers, in frames
+    double getResidual() const;
+    void setGapLimit(double seconds);
+private:
+    double getSampleTime(uint64_t arrival_micros, uint64_t time_tag);
+    int observations_;
+    int stable_observations_;
+    int unstable_observations_;
+    // Frame position and time of the last update, in seconds since origin_
+    double position_;
+    double time_;
+    // Frames per second
+    double rate_;
+    double residual_;
+    uint64_t origin_;
+    bool has_origin_;
+    // Offset from time tag to local clock, in seconds
+    double offset_;
+    bool has_offset_;
+    double last_arrival_;
+    double gap_limit_;
+};
+
+#endif /* defined(__MediaPlayer_client__FrameClock__) */
@@ -0,0 +1,263 @@
+//
+//  FrameClockTest.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FrameClockTest.h"
+#include "FrameClock.h"
+#include <random>
+
+// Predictions per frame, at even intervals
+static const int QueriesPerFrame = 4;
+// Predictions aren't judged for this long after the start, a gap or a jump
+static const double SettleTime = 1.0;
+static const double MaxReacquireTime = 0.5;
+static const double MinLockedFraction = 0.99;
+// The clock's gap limit, and the local time the simulation starts at
+static const double GapLimit = 0.5;
+static const uint64_t StartMicros = 10000000;
+// The server's clock, in seconds since 1900, when the simulation starts
+static const double StartTimeTag = 3900000000.0;
+
+FrameClockTest::Scenario::Scenario(const std::string& name, double rate)
+: name(name), rate(rate), drift_ppm(0), rate_ramp(0), latency(0.002), jitter(0.0005), tagged(false),
+gap_start(0), gap_length(0), jump_start(0), jump_frames(0), duration(60), rate_tolerance(0.002), exact_fraction(0.95)
+{
+
+}
+
+FrameClockTest::Result::Result()
+: passed(false), rate_error(0), locked_fraction(0), exact_fraction(0), off_by_more_than_one(0), reacquire_time(0), predicted_in_gap(0)
+{
+
+}
+
+bool FrameClockTest::parseArguments(int argc, char *argv[], unsigned int& seed)
+{
+    bool found = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--clock-test")
+        {
+            found = true;
+        }
+        else if (found && argument.compare(0, 5, "seed=") == 0)
+        {
+            seed = ofToInt(argument.substr(5));
+        }
+    }
+    return found;
+}
+
+FrameClockTest::FrameClockTest(unsigned int seed)
+: seed_(seed)
+{
+
+}
+
+bool FrameClockTest::run()
+{
+    std::vector<Scenario> scenarios;
+
+    scenarios.push_back(Scenario("steady", 60.0));
+
+    Scenario jittered("jittered", 59.94);
+    jittered.jitter = 0.004;
+    jittered.rate_tolerance = 0.01;
+    jittered.exact_fraction = 0.8;
+    scenarios.push_back(jittered);
+
+    Scenario drifting("drifting", 50.0);
+    drifting.drift_ppm = 200.0;
+    drifting.rate_ramp = 0.5;
+    drifting.jitter = 0.002;
+    drifting.rate_tolerance = 0.005;
+    drifting.exact_fraction = 0.85;
+    scenarios.push_back(drifting);
+
+    Scenario short_gap("short gap", 60.0);
+    short_gap.jitter = 0.002;
+    short_gap.gap_start = 20.0;
+    short_gap.gap_length = 0.3;
+    short_gap.rate_tolerance = 0.005;
+    short_gap.exact_fraction = 0.9;
+    scenarios.push_back(short_gap);
+
+    Scenario long_gap("long gap", 60.0);
+    long_gap.jitter = 0.002;
+    long_gap.gap_start = 20.0;
+    long_gap.gap_length = 2.0;
+    long_gap.rate_tolerance = 0.005;
+    long_gap.exact_fraction = 0.9;
+    scenarios.push_back(long_gap);
+
+    Scenario jump("jump", 60.0);
+    jump.jitter = 0.002;
+    jump.jump_start = 20.0;
+    jump.jump_frames = 1000;
+    jump.rate_tolerance = 0.005;
+    jump.exact_fraction = 0.9;
+    scenarios.push_back(jump);
+
+    Scenario tagged("tagged", 30.0);
+    tagged.latency = 0.02;
+    tagged.jitter = 0.015;
+    tagged.tagged = true;
+    tagged.drift_ppm = -100.0;
+    tagged.rate_tolerance = 0.002;
+    tagged.exact_fraction = 0.9;
+    scenarios.push_back(tagged);
+
+    bool passed = true;
+    for (std::vector<Scenario>::const_iterator it = scenarios.begin(); it != scenarios.end(); ++it) {
+        Result result = runScenario(*it);
+        ofLogNotice("FrameClockTest") << (result.passed ? "PASS " : "FAIL ") << it->name
+            << ": rate error " << result.rate_error * 100.0 << "%"
+            << ", locked " << result.locked_fraction * 100.0 << "%"
+            << ", exact " << result.exact_fraction * 100.0 << "%"
+            << ", off by more than one " << result.off_by_more_than_one
+            << ", reacquired in " << result.reacquire_time << "s"
+            << ", predicted in gap " << result.predicted_in_gap;
+        passed = passed && result.passed;
+    }
+    return passed;
+}
+
+FrameClockTest::Result FrameClockTest::runScenario(const Scenario& scenario)
+{
+    std::mt19937 random(seed_);
+    std::exponential_distribution<double> transit(1.0 / std::max(scenario.jitter, 1e-9));
+
+    /*
+     The server's rate in our time, and its frame position, at local time t since the start
+     */
+    const double initial_rate = scenario.rate * (1.0 + (scenario.drift_ppm / 1000000.0));
+    const double ramp = scenario.rate_ramp / scenario.duration;
+
+    struct Arrival {
+        double time;
+        long frame;
+        uint64_t time_tag;
+        bool operator<(const Arrival& other) const { return time < other.time; }
+    };
+    std::vector<Arrival> arrivals;
+    double send = 0.0;
+    for (long index = 0; send < scenario.duration; index++)
+    {
+        bool lost = send >= scenario.gap_start && send < scenario.gap_start + scenario.gap_length;
+        if (!lost)
+        {
+            Arrival arrival;
+            arrival.time = send + scenario.latency + transit(random);
+            arrival.frame = index + (scenario.jump_frames != 0 && send >= scenario.jump_start ? scenario.jump_frames : 0);
+            arrival.time_tag = 0;
+            if (scenario.tagged)
+            {
+                double tag = StartTimeTag + (send * (1.0 + (scenario.drift_ppm / 1000000.0)));
+                arrival.time_tag = (uint64_t(floor(tag)) << 32) | uint64_t((tag - floor(tag)) * 4294967296.0);
+            }
+            arrivals.push_back(arrival);
+        }
+        send += 1.0 / (initial_rate + (ramp * send));
+    }
+    /*
+     Datagrams may be reordered by jitter
+     */
+    std::stable_sort(arrivals.begin(), arrivals.end());
+
+    /*
+     A tagged frame is placed at its send time plus the least transit time, an untagged one
+     at its arrival, which on average is send time plus the mean transit time
+     */
+    const double delay = scenario.latency + (scenario.tagged ? 0.0 : scenario.jitter);
+    double event = -1.0;
+    double event_end = -1.0;
+    if (scenario.gap_length > 0.0)
+    {
+        event = scenario.gap_start;
+        event_end = scenario.gap_start + scenario.gap_length + delay;
+    }
+    else if (scenario.jump_frames != 0)
+    {
+        event = event_end = scenario.jump_start + delay;
+    }
+
+    FrameClock clock;
+    clock.setGapLimit(GapLimit);
+    Result result;
+    long judged = 0;
+    long locked = 0;
+    long exact = 0;
+    bool reacquired = event < 0.0;
+    double last_arrival = -1.0;
+    const double query_interval = 1.0 / (scenario.rate * QueriesPerFrame);
+    std::vector<Arrival>::const_iterator next = arrivals.begin();
+    for (double query = 0.0; query < scenario.duration; query += query_interval)
+    {
+        for (; next != arrivals.end() && next->time <= query; ++next) {
+            clock.addFrame(next->frame, StartMicros + uint64_t(next->time * 1000000.0), next->time_tag);
+            last_arrival = next->time;
+        }
+        long predicted;
+        bool predicting = clock.getFrame(StartMicros + uint64_t(query * 1000000.0), predicted);
+
+        /*
+         The frame due is the one sent delay ago
+         */
+        double due_time = query - delay;
+        double due_position = (initial_rate * due_time) + (0.5 * ramp * due_time * due_time);
+        long due = floor(due_position + 0.5) + (scenario.jump_frames != 0 && due_time >= scenario.jump_start ? scenario.jump_frames : 0);
+
+        if (last_arrival >= 0.0 && query - last_arrival > GapLimit + query_interval)
+        {
+            /*
+             Nothing received for longer than the limit, so nothing should be predicted
+             */
+            if (predicting)
+            {
+                result.predicted_in_gap++;
+            }
+            continue;
+        }
+        if (!reacquired && query >= event_end && predicting && predicted == due)
+        {
+            result.reacquire_time = query - event_end;
+            reacquired = true;
+        }
+        if (query < SettleTime || (event >= 0.0 && query >= event && query < event_end + SettleTime))
+        {
+            continue;
+        }
+        judged++;
+        if (predicting)
+        {
+            locked++;
+            if (predicted == due)
+            {
+                exact++;
+            }
+            else if (labs(predicted - due) > 1)
+            {
+                result.off_by_more_than_one++;
+            }
+        }
+    }
+
+    double final_rate = initial_rate + (ramp * scenario.duration);
+    result.rate_error = fabs(clock.getFrameRate() - final_rate) / final_rate;
+    result.locked_fraction = judged > 0 ? double(locked) / judged : 0.0;
+    result.exact_fraction = locked > 0 ? double(exact) / locked : 0.0;
+    if (!reacquired)
+    {
+        result.reacquire_time = scenario.duration - event_end;
+    }
+    result.passed = result.rate_error <= scenario.rate_tolerance
+        && result.locked_fraction >= MinLockedFraction
+        && result.exact_fraction >= scenario.exact_fraction
+        && result.off_by_more_than_one == 0
+        && result.predicted_in_gap == 0
+        && reacquired && result.reacquire_time <= MaxReacquireTime;
+    return result;
+}
@@ -0,0 +1,77 @@
+//
+//  FrameClockTest.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FrameClockTest__
+#define __MediaPlayer_client__FrameClockTest__
+
+#include "ofMain.h"
+
+/*
+ Feeds FrameClock simulated frame_number streams with jittered, drifting and gapped arrival
+ times, and checks that it locks, estimates the server's rate and predicts the frame due
+ at times between arrivals. Each scenario is reported with its measurements.
+
+ Run as
+
+    MediaPlayer_client --clock-test [seed=1]
+
+ The exit status is non-zero if any scenario fails.
+ */
+class FrameClockTest {
+public:
+    struct Scenario {
+        Scenario(const std::string& name, double rate);
+        std::string name;
+        // The server's nominal frame rate, and how far its clock runs fast, in parts per million
+        double rate;
+        double drift_ppm;
+        // The server's rate changes linearly by this many frames per second over the run
+        double rate_ramp;
+        // Transit time is latency plus an exponentially distributed delay with mean jitter, in seconds
+        double latency;
+        double jitter;
+        // Whether messages come in bundles time tagged by the server
+        bool tagged;
+        // Frames sent in gap_length seconds from gap_start are lost
+        double gap_start;
+        double gap_length;
+        // From jump_start, frame numbers are jump_frames ahead
+        double jump_start;
+        long jump_frames;
+        double duration;
+        // Pass criteria: the largest relative error in the estimated rate, and the smallest
+        // fraction of predictions which are exactly the frame due
+        double rate_tolerance;
+        double exact_fraction;
+    };
+    struct Result {
+        Result();
+        bool passed;
+        double rate_error;
+        // Of predictions made while the clock should be locked
+        double locked_fraction;
+        double exact_fraction;
+        long off_by_more_than_one;
+        // Seconds from the first frame after a gap or jump until predictions are exact again
+        double reacquire_time;
+        // Predictions made during a gap longer than the clock's limit
+        long predicted_in_gap;
+    };
+    /*
+     Returns true if the arguments request the test, filling seed from them
+     */
+    static bool parseArguments(int argc, char *argv[], unsigned int& seed);
+    FrameClockTest(unsigned int seed);
+    /*
+     Runs every scenario, returning true if they all pass
+     */
+    bool run();
+    Result runScenario(const Scenario& scenario);
+private:
+    unsigned int seed_;
+};
+
+#endif /* defined(__MediaPlayer_client__FrameClockTest__) */
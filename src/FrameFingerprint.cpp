@@ -0,0 +1,271 @@
+//
+//  FrameFingerprint.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FrameFingerprint.h"
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAME_FINGERPRINT_SSE2 1
+#endif
+
+/*
+ Data is consumed in stripes of eight 64-bit lanes, and the accumulators scrambled after
+ every block of stripes. The SSE2 path computes exactly what the scalar path does.
+ */
+static const size_t StripeSize = 64;
+static const size_t StripesPerBlock = 16;
+static const uint64_t Prime32_1 = 0x9E3779B1ULL;
+static const uint64_t Prime32_2 = 0x85EBCA77ULL;
+static const uint64_t Prime32_3 = 0xC2B2AE3DULL;
+static const uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+static const uint64_t StripeKeys[8] = {
+    0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+    0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL, 0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL
+};
+
+static const uint64_t ScrambleKeys[8] = {
+    0xCB00C391BB52283CULL, 0xA32E531B8B65D088ULL, 0x4EF90DA297486471ULL, 0xD8ACDEA946EF1938ULL,
+    0x3F349CE33F76FAA8ULL, 0x1D4F0BC7C7BBDCF9ULL, 0x3159B4CD4BE0518AULL, 0x647378D9C97E9FC8ULL
+};
+
+static const uint64_t MergeKeys[8] = {
+    0xC3EBD33483ACC5EAULL, 0xEB6313FAFFA081C5ULL, 0x49DAF0B751DD0D17ULL, 0x9E68D429265516D3ULL,
+    0xFCA1477D58BE162BULL, 0xCE31D07AD1B8F88FULL, 0x280416958F3ACB45ULL, 0x7E404BBBCAFBD7AFULL
+};
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    /*
+     Every supported platform is little-endian
+     */
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/*
+ The 128-bit product of a and b, its halves xored together
+ */
+static inline uint64_t multiplyFold(uint64_t a, uint64_t b)
+{
+    uint64_t a_low = a & 0xFFFFFFFFULL, a_high = a >> 32;
+    uint64_t b_low = b & 0xFFFFFFFFULL, b_high = b >> 32;
+    uint64_t low_low = a_low * b_low;
+    uint64_t high_low = a_high * b_low;
+    uint64_t low_high = a_low * b_high;
+    uint64_t high_high = a_high * b_high;
+    uint64_t cross = (low_low >> 32) + (high_low & 0xFFFFFFFFULL) + low_high;
+    uint64_t upper = (high_low >> 32) + (cross >> 32) + high_high;
+    uint64_t lower = (cross << 32) | (low_low & 0xFFFFFFFFULL);
+    return lower ^ upper;
+}
+
+#ifdef FRAME_FINGERPRINT_SSE2
+
+/*
+ Loads and stores are unaligned, as VS2012 can't align the tables or accumulators; on SSE2
+ hardware of any age that costs little for data already in cache
+ */
+static inline void accumulate(uint64_t *acc, const unsigned char *stripe)
+{
+    __m128i *lanes = reinterpret_cast<__m128i *>(acc);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(stripe) + i);
+        __m128i keyed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i *>(StripeKeys) + i));
+        __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i lane = _mm_loadu_si128(lanes + i);
+        _mm_storeu_si128(lanes + i, _mm_add_epi64(lane, _mm_add_epi64(product, swapped)));
+    }
+}
+
+static inline void scramble(uint64_t *acc)
+{
+    __m128i *lanes = reinterpret_cast<__m128i *>(acc);
+    const __m128i prime = _mm_set1_epi32(int(Prime32_1));
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        __m128i lane = _mm_loadu_si128(lanes + i);
+        lane = _mm_xor_si128(lane, _mm_srli_epi64(lane, 47));
+        lane = _mm_xor_si128(lane, _mm_loadu_si128(reinterpret_cast<const __m128i *>(ScrambleKeys) + i));
+        __m128i low = _mm_mul_epu32(lane, prime);
+        __m128i high = _mm_mul_epu32(_mm_srli_epi64(lane, 32), prime);
+        _mm_storeu_si128(lanes + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
+
+#else
+
+static inline void accumulate(uint64_t *acc, const unsigned char *stripe)
+{
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        uint64_t data = read64(stripe + i * 8);
+        uint64_t keyed = data ^ StripeKeys[i];
+        acc[i ^ 1] += data;
+        acc[i] += (keyed & 0xFFFFFFFFULL) * (keyed >> 32);
+    }
+}
+
+static inline void scramble(uint64_t *acc)
+{
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        uint64_t lane = acc[i] ^ (acc[i] >> 47);
+        lane ^= ScrambleKeys[i];
+        acc[i] = lane * Prime32_1;
+    }
+}
+
+#endif
+
+FrameFingerprint::Record::Record()
+: frame(0), hash(0), present_time(0)
+{ }
+
+std::atomic<bool> FrameFingerprint::enabled_(false);
+
+uint64_t FrameFingerprint::hash(const void *data, size_t size)
+{
+    uint64_t acc[8] = { Prime32_3, Prime64_1, Prime64_2, Prime64_3, Prime64_4, Prime32_2, Prime64_5, Prime32_1 };
+
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    size_t stripes = size / StripeSize;
+    for (size_t i = 0; i < stripes; i++)
+    {
+        accumulate(acc, bytes + i * StripeSize);
+        if ((i + 1) % StripesPerBlock == 0)
+        {
+            scramble(acc);
+        }
+    }
+    /*
+     The final partial stripe is padded with zeroes; the length is mixed in below, so
+     trailing zeroes still change the hash
+     */
+    size_t remaining = size % StripeSize;
+    if (remaining > 0)
+    {
+        unsigned char last[StripeSize] = { 0 };
+        memcpy(last, bytes + stripes * StripeSize, remaining);
+        accumulate(acc, last);
+    }
+
+    uint64_t result = uint64_t(size) * Prime64_1;
+    for (unsigned int i = 0; i < 8; i += 2)
+    {
+        result += multiplyFold(acc[i] ^ MergeKeys[i], acc[i + 1] ^ MergeKeys[i + 1]);
+    }
+    result ^= result >> 37;
+    result *= 0x165667919E3779F9ULL;
+    result ^= result >> 32;
+    return result;
+}
+
+void FrameFingerprint::setEnabled(bool enabled)
+{
+    enabled_ = enabled;
+}
+
+bool FrameFingerprint::isEnabled()
+{
+    return enabled_;
+}
+
+uint64_t FrameFingerprint::getPresentTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+FrameFingerprint::FrameFingerprint()
+: batch_size_(30), batch_started_(0), has_record_(false), records_(0)
+{
+
+}
+
+void FrameFingerprint::setup(const std::string& client_id, const std::string& destination, unsigned int batch_size)
+{
+    sender_.reset();
+    batch_.clear();
+    client_id_ = client_id;
+    batch_size_ = std::max(batch_size, 1U);
+    std::vector<std::string> parts = ofSplitString(destination, ":");
+    if (parts.size() == 2)
+    {
+        try {
+            std::shared_ptr<ofxOscSender> sender(new ofxOscSender());
+            sender->setup(parts[0], ofToInt(parts[1]));
+            sender_ = sender;
+        } catch (std::exception& e) {
+            ofLogError("FrameFingerprint") << "Unable to send to " << destination << ": " << e.what();
+        }
+    }
+    else if (!destination.empty())
+    {
+        ofLogError("FrameFingerprint") << "Fingerprint destination must be host:port, not " << destination;
+    }
+}
+
+void FrameFingerprint::add(long frame, uint64_t hash, uint64_t present_time)
+{
+    if (has_record_ && frame == last_.frame && hash == last_.hash)
+    {
+        return;
+    }
+    last_.frame = frame;
+    last_.hash = hash;
+    last_.present_time = present_time;
+    has_record_ = true;
+    records_++;
+    if (!sender_)
+    {
+        return;
+    }
+    if (batch_.empty())
+    {
+        batch_started_ = present_time;
+    }
+    batch_.push_back(last_);
+    if (batch_.size() >= batch_size_ || present_time - batch_started_ >= 1000000)
+    {
+        flush();
+    }
+}
+
+void FrameFingerprint::flush()
+{
+    if (!sender_ || batch_.empty())
+    {
+        return;
+    }
+    ofxOscMessage message;
+    message.setAddress("/client/fingerprints");
+    message.addStringArg(client_id_);
+    for (std::vector<Record>::const_iterator it = batch_.begin(); it != batch_.end(); ++it) {
+        message.addInt64Arg(it->frame);
+        message.addInt64Arg(int64_t(it->hash));
+        message.addInt64Arg(int64_t(it->present_time));
+    }
+    sender_->sendMessage(message);
+    batch_.clear();
+}
+
+FrameFingerprint::Record FrameFingerprint::getLastRecord() const
+{
+    return last_;
+}
+
+unsigned long FrameFingerprint::getRecordCount() const
+{
+    return records_;
+}
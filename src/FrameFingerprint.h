@@ -0,0 +1,67 @@
+//
+//  FrameFingerprint.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FrameFingerprint__
+#define __MediaPlayer_client__FrameFingerprint__
+
+#include "ofMain.h"
+#include <ofxOsc.h>
+#include <atomic>
+
+/*
+ Reports a hash of the compressed data of each frame shown and the time it was shown, so a
+ server can confirm every client showed the same frame at the same moment.
+
+ Frames are hashed by whatever loads them, off the render thread, while isEnabled(). Records
+ are sent to the destination in batches as /client/fingerprints: the client id followed by
+ a frame number, hash and presentation time for each frame, all int64, times in microseconds
+ since the Unix epoch.
+ */
+class FrameFingerprint {
+public:
+    struct Record {
+        Record();
+        long frame;
+        uint64_t hash;
+        uint64_t present_time;
+    };
+    /*
+     A 64-bit hash in the style of XXH3, giving the same result on every platform. It is not
+     XXH3 and its values do not match XXH3's.
+     */
+    static uint64_t hash(const void *data, size_t size);
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    /*
+     Microseconds since the Unix epoch
+     */
+    static uint64_t getPresentTime();
+    FrameFingerprint();
+    /*
+     destination is host:port, or empty to keep records for the stats display only.
+     Batches are sent when batch_size records are waiting, or once a second.
+     */
+    void setup(const std::string& client_id, const std::string& destination, unsigned int batch_size);
+    /*
+     Records frame as shown with hash, unless it is the frame last recorded
+     */
+    void add(long frame, uint64_t hash, uint64_t present_time);
+    void flush();
+    Record getLastRecord() const;
+    unsigned long getRecordCount() const;
+private:
+    static std::atomic<bool> enabled_;
+    std::shared_ptr<ofxOscSender> sender_;
+    std::string client_id_;
+    unsigned int batch_size_;
+    std::vector<Record> batch_;
+    uint64_t batch_started_;
+    bool has_record_;
+    Record last_;
+    unsigned long records_;
+};
+
+#endif /* defined(__MediaPlayer_client__FrameFingerprint__) */
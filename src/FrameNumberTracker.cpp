@@ -0,0 +1,173 @@
+//
+//  FrameNumberTracker.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FrameNumberTracker.h"
+
+FrameNumberTracker::FrameNumberTracker(unsigned int capacity)
+: entries_(std::max(capacity, 2U))
+{
+    clear();
+}
+
+void FrameNumberTracker::clear()
+{
+    head_ = 0;
+    count_ = 0;
+    gaps_ = 0;
+    reorders_ = 0;
+    skipped_ = 0;
+    interval_count_ = 0;
+    interval_sum_ = 0;
+    interval_square_sum_ = 0;
+    summary_.clear();
+    summary_changed_ = false;
+}
+
+void FrameNumberTracker::add(long frame_number, uint64_t arrival_micros)
+{
+    if (count_ == entries_.size())
+    {
+        /*
+         Drop the oldest, and with it the transition into its successor
+         */
+        const Entry& dropped = entries_[head_];
+        head_ = (head_ + 1) % entries_.size();
+        count_--;
+        removeTransition(dropped, entries_[head_]);
+    }
+
+    Entry& entry = entries_[(head_ + count_) % entries_.size()];
+    entry.frame_number = frame_number;
+    entry.arrival = arrival_micros;
+    entry.has_interval = false;
+    entry.discontinuous = false;
+    if (count_ > 0)
+    {
+        const Entry& previous = entries_[(head_ + count_ - 1) % entries_.size()];
+        entry.interval = int64_t(arrival_micros) - int64_t(previous.arrival);
+        entry.has_interval = true;
+        interval_count_++;
+        interval_sum_ += entry.interval;
+        interval_square_sum_ += entry.interval * entry.interval;
+        if (frame_number != previous.frame_number + 1)
+        {
+            entry.discontinuous = true;
+            if (frame_number > previous.frame_number)
+            {
+                gaps_++;
+                skipped_ += frame_number - previous.frame_number - 1;
+            }
+            else
+            {
+                reorders_++;
+            }
+            summary_changed_ = true;
+        }
+    }
+    count_++;
+}
+
+void FrameNumberTracker::removeTransition(const Entry& previous, Entry& entry)
+{
+    if (entry.has_interval)
+    {
+        interval_count_--;
+        interval_sum_ -= entry.interval;
+        interval_square_sum_ -= entry.interval * entry.interval;
+        entry.has_interval = false;
+    }
+    if (entry.discontinuous)
+    {
+        if (entry.frame_number > previous.frame_number)
+        {
+            gaps_--;
+            skipped_ -= entry.frame_number - previous.frame_number - 1;
+        }
+        else
+        {
+            reorders_--;
+        }
+        entry.discontinuous = false;
+        summary_changed_ = true;
+    }
+}
+
+unsigned int FrameNumberTracker::size() const
+{
+    return count_;
+}
+
+long FrameNumberTracker::getLastFrameNumber() const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    return entries_[(head_ + count_ - 1) % entries_.size()].frame_number;
+}
+
+unsigned int FrameNumberTracker::getDiscontinuityCount() const
+{
+    return gaps_ + reorders_;
+}
+
+unsigned int FrameNumberTracker::getGapCount() const
+{
+    return gaps_;
+}
+
+unsigned int FrameNumberTracker::getReorderCount() const
+{
+    return reorders_;
+}
+
+unsigned long FrameNumberTracker::getSkippedFrameCount() const
+{
+    return skipped_;
+}
+
+float FrameNumberTracker::getMeanInterval() const
+{
+    if (interval_count_ == 0)
+    {
+        return 0.0;
+    }
+    return (double(interval_sum_) / interval_count_) / 1000000.0;
+}
+
+float FrameNumberTracker::getJitter() const
+{
+    if (interval_count_ < 2)
+    {
+        return 0.0;
+    }
+    double mean = double(interval_sum_) / interval_count_;
+    double variance = (double(interval_square_sum_) / interval_count_) - (mean * mean);
+    return sqrt(std::max(variance, 0.0)) / 1000000.0;
+}
+
+const std::string& FrameNumberTracker::getSummary()
+{
+    if (summary_changed_)
+    {
+        summary_.clear();
+        for (unsigned int i = 1; i < count_; i++)
+        {
+            const Entry& entry = entries_[(head_ + i) % entries_.size()];
+            if (entry.discontinuous)
+            {
+                const Entry& previous = entries_[(head_ + i - 1) % entries_.size()];
+                if (!summary_.empty())
+                {
+                    summary_ += ",";
+                }
+                summary_ += ofToString(previous.frame_number) + "->" + ofToString(entry.frame_number);
+            }
+        }
+        summary_changed_ = false;
+    }
+    return summary_;
+}
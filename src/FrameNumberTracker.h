@@ -0,0 +1,61 @@
+//
+//  FrameNumberTracker.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FrameNumberTracker__
+#define __MediaPlayer_client__FrameNumberTracker__
+
+#include "ofMain.h"
+
+/*
+ Keeps the most recently received frame numbers in a ring buffer, updating counts of
+ discontinuities and the spread of arrival intervals as each one is added or falls out.
+ */
+class FrameNumberTracker {
+public:
+    FrameNumberTracker(unsigned int capacity = 300);
+    void clear();
+    void add(long frame_number, uint64_t arrival_micros);
+    unsigned int size() const;
+    long getLastFrameNumber() const;
+    /*
+     Discontinuities are gaps (frames skipped) or reorders (a frame no later than its predecessor)
+     */
+    unsigned int getDiscontinuityCount() const;
+    unsigned int getGapCount() const;
+    unsigned int getReorderCount() const;
+    unsigned long getSkippedFrameCount() const;
+    /*
+     Mean and standard deviation of the interval between arrivals, in seconds
+     */
+    float getMeanInterval() const;
+    float getJitter() const;
+    /*
+     Each discontinuity as "previous->next", comma separated. Only rebuilt after a change.
+     */
+    const std::string& getSummary();
+private:
+    struct Entry {
+        long frame_number;
+        uint64_t arrival;
+        int64_t interval;
+        bool has_interval;
+        bool discontinuous;
+    };
+    void removeTransition(const Entry& previous, Entry& entry);
+    std::vector<Entry> entries_;
+    unsigned int head_;
+    unsigned int count_;
+    unsigned int gaps_;
+    unsigned int reorders_;
+    unsigned long skipped_;
+    unsigned int interval_count_;
+    int64_t interval_sum_;
+    int64_t interval_square_sum_;
+    std::string summary_;
+    bool summary_changed_;
+};
+
+#endif /* defined(__MediaPlayer_client__FrameNumberTracker__) */
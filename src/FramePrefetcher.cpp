@@ -0,0 +1,471 @@
+//
+//  FramePrefetcher.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FramePrefetcher.h"
+#include "FrameReadahead.h"
+#include "FrameBufferPool.h"
+#include "Tracer.h"
+
+std::shared_ptr<LoadedFrame> FramePathSource::loadFrame(unsigned int index) const
+{
+    return FramePrefetcher::loadFrame(getPath(index));
+}
+
+FramePrefetcher::FramePrefetcher()
+: readahead_(new FrameReadahead()), running_(false), generation_(0), window_(0), window_limit_(UINT_MAX),
+load_time_(10000.0),
+has_previous_(false), previous_index_(0), stride_(1.0), hits_(0), misses_(0)
+{
+
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+    close();
+}
+
+void FramePrefetcher::setup(unsigned int thread_count, unsigned int window, unsigned int readahead)
+{
+    close();
+    readahead_->setup(readahead);
+    mutex_.lock();
+    running_ = true;
+    window_ = window;
+    window_limit_ = UINT_MAX;
+    mutex_.unlock();
+    for (unsigned int i = 0; i < thread_count; i++)
+    {
+        std::shared_ptr<Worker> worker(new Worker(*this));
+        worker->startThread();
+        workers_.push_back(worker);
+    }
+}
+
+void FramePrefetcher::close()
+{
+    mutex_.lock();
+    running_ = false;
+    condition_.broadcast();
+    mutex_.unlock();
+    for (std::vector<std::shared_ptr<Worker> >::iterator it = workers_.begin(); it != workers_.end(); ++it) {
+        (*it)->waitForThread(true);
+    }
+    workers_.clear();
+    readahead_->close();
+}
+
+void FramePrefetcher::setSource(std::shared_ptr<FramePathSource> source)
+{
+    mutex_.lock();
+    generation_++;
+    queue_.clear();
+    loading_.clear();
+    ready_.clear();
+    wanted_.clear();
+    has_previous_ = false;
+    stride_ = 1.0;
+    source_ = source;
+    condition_.broadcast();
+    mutex_.unlock();
+    readahead_->setSource(source);
+}
+
+void FramePrefetcher::reloadSource(std::shared_ptr<FramePathSource> source, unsigned int previous_size, unsigned int unchanged_start, unsigned int unchanged_end)
+{
+    mutex_.lock();
+    generation_++;
+    queue_.clear();
+    loading_.clear();
+    wanted_.clear();
+    /*
+     Frames after the change move by the difference in size
+     */
+    unsigned int size = source->size();
+    unsigned int moved_start = previous_size - unchanged_end;
+    std::map<unsigned int, Frame> ready;
+    for (std::map<unsigned int, Frame>::const_iterator it = ready_.begin(); it != ready_.end(); ++it) {
+        if (it->first < unchanged_start)
+        {
+            ready[it->first] = it->second;
+        }
+        else if (it->first >= moved_start && it->first < previous_size)
+        {
+            ready[it->first - moved_start + size - unchanged_end] = it->second;
+        }
+    }
+    ready_.swap(ready);
+    if (has_previous_ && previous_index_ >= moved_start && previous_index_ < previous_size)
+    {
+        previous_index_ = previous_index_ - moved_start + size - unchanged_end;
+    }
+    else if (has_previous_ && previous_index_ >= unchanged_start)
+    {
+        has_previous_ = false;
+    }
+    source_ = source;
+    condition_.broadcast();
+    mutex_.unlock();
+    readahead_->setSource(source);
+}
+
+FramePrefetcher::Frame FramePrefetcher::getFrame(unsigned int index)
+{
+    mutex_.lock();
+    if (!source_ || index >= source_->size())
+    {
+        mutex_.unlock();
+        return Frame();
+    }
+
+    /*
+     Track the direction and speed of playback, ignoring repeated requests for the same frame
+     */
+    if (has_previous_)
+    {
+        int step = distance(previous_index_, index);
+        if (step != 0)
+        {
+            stride_ = ofClamp((stride_ * 0.75) + (step * 0.25), -float(window_), float(window_));
+        }
+    }
+    has_previous_ = true;
+    previous_index_ = index;
+
+    schedule(index);
+
+    Frame frame;
+    std::map<unsigned int, Frame>::const_iterator found = ready_.find(index);
+    if (found != ready_.end())
+    {
+        hits_++;
+        frame = found->second;
+    }
+    else
+    {
+        misses_++;
+        /*
+         If a worker is already loading this frame it will finish sooner than we would
+         */
+        unsigned int generation = generation_;
+        while (loading_.count(index) && generation == generation_)
+        {
+            condition_.wait(mutex_);
+        }
+        found = ready_.find(index);
+        if (found != ready_.end())
+        {
+            frame = found->second;
+        }
+    }
+    std::shared_ptr<FramePathSource> source = source_;
+    unsigned int generation = generation_;
+    mutex_.unlock();
+
+    if (!frame)
+    {
+        uint64_t start = ofGetElapsedTimeMicros();
+        frame = source->loadFrame(index);
+        addLoadTime(ofGetElapsedTimeMicros() - start);
+
+        mutex_.lock();
+        if (generation == generation_ && wanted_.count(index))
+        {
+            ready_[index] = frame;
+        }
+        mutex_.unlock();
+    }
+    return frame;
+}
+
+FramePrefetcher::Frame FramePrefetcher::loadFrame(const std::string& path, SharedFrameCache *shared_cache, uint64_t shared_key, unsigned int index)
+{
+    Frame frame(new LoadedFrame());
+    frame->setSharing(shared_cache, shared_key, index);
+    FILE *file = fopen(ofToDataPath(path).c_str(), "rb");
+    if (file == NULL)
+    {
+        ofLogError("FramePrefetcher") << "Unable to open " << path;
+        return frame;
+    }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+    }
+    if (size > 0)
+    {
+        FrameBufferPool::Buffer buffer = FrameBufferPool::getShared().acquire(size);
+        if (fread(buffer->getBinaryBuffer(), 1, size, file) == size_t(size))
+        {
+            if (!frame->load(*buffer))
+            {
+                ofLogError("FramePrefetcher") << "Unable to decode " << path;
+            }
+        }
+        else
+        {
+            ofLogError("FramePrefetcher") << "Unable to read " << path;
+        }
+    }
+    fclose(file);
+    return frame;
+}
+
+FramePrefetcher::Frame FramePrefetcher::loadFrame(const char *data, size_t size, SharedFrameCache *shared_cache, uint64_t shared_key, unsigned int index)
+{
+    /*
+     Decoded in place, so a memory-mapped frame is read straight from the page cache
+     */
+    Frame frame(new LoadedFrame());
+    frame->setSharing(shared_cache, shared_key, index);
+    frame->load(data, size);
+    return frame;
+}
+
+void FramePrefetcher::addFrame(unsigned int index, Frame frame)
+{
+    ofScopedLock lock(mutex_);
+    if (source_ && index < source_->size() && frame)
+    {
+        ready_[index] = frame;
+    }
+}
+
+unsigned int FramePrefetcher::getWindow() const
+{
+    ofScopedLock lock(mutex_);
+    return window_;
+}
+
+unsigned long FramePrefetcher::getHitCount() const
+{
+    ofScopedLock lock(mutex_);
+    return hits_;
+}
+
+unsigned long FramePrefetcher::getMissCount() const
+{
+    ofScopedLock lock(mutex_);
+    return misses_;
+}
+
+/*
+ Called with mutex_ locked
+ */
+void FramePrefetcher::schedule(unsigned int index)
+{
+    unsigned int size = source_->size();
+    wanted_.clear();
+    wanted_.insert(index);
+    queue_.clear();
+    unsigned int window = std::min(window_, window_limit_);
+    for (unsigned int i = 1; i <= window && wanted_.size() < size; i++)
+    {
+        long offset = lroundf(stride_ * i);
+        if (offset == 0)
+        {
+            offset = stride_ < 0.0 ? -1 : 1;
+        }
+        long target = (long(index) + offset) % long(size);
+        if (target < 0)
+        {
+            target += size;
+        }
+        if (wanted_.insert(target).second && ready_.count(target) == 0 && loading_.count(target) == 0)
+        {
+            queue_.push_back(target);
+        }
+    }
+    /*
+     Release frames we have moved away from
+     */
+    std::map<unsigned int, Frame>::iterator it = ready_.begin();
+    while (it != ready_.end())
+    {
+        if (wanted_.count(it->first) == 0)
+        {
+            ready_.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (!queue_.empty())
+    {
+        condition_.broadcast();
+    }
+    long stride = lroundf(stride_);
+    if (stride == 0)
+    {
+        stride = stride_ < 0.0 ? -1 : 1;
+    }
+    readahead_->update(index, stride, window_ + 1);
+}
+
+uint64_t FramePrefetcher::getMemoryUsage() const
+{
+    ofScopedLock lock(mutex_);
+    uint64_t usage = 0;
+    for (std::map<unsigned int, Frame>::const_iterator it = ready_.begin(); it != ready_.end(); ++it) {
+        if (it->second)
+        {
+            usage += it->second->memory_size;
+        }
+    }
+    return usage;
+}
+
+bool FramePrefetcher::getEvictionCandidate(uint64_t& bytes, double& value) const
+{
+    ofScopedLock lock(mutex_);
+    std::map<unsigned int, Frame>::const_iterator candidate = findEvictionCandidate();
+    if (candidate == ready_.end())
+    {
+        return false;
+    }
+    bytes = candidate->second ? candidate->second->memory_size : 0;
+    value = load_time_ / (1 + std::abs(distance(previous_index_, candidate->first)));
+    return true;
+}
+
+void FramePrefetcher::evictCandidate()
+{
+    ofScopedLock lock(mutex_);
+    std::map<unsigned int, Frame>::const_iterator candidate = findEvictionCandidate();
+    if (candidate == ready_.end())
+    {
+        return;
+    }
+    /*
+     Stop the window short of the evicted frame if it lies ahead, but keep at least the next
+     frame; frames behind are only left over from a change of direction
+     */
+    int away = distance(previous_index_, candidate->first);
+    if ((away < 0) == (stride_ < 0.0))
+    {
+        long steps = lroundf(std::abs(away) / std::max(std::fabs(stride_), 1.0f));
+        window_limit_ = std::min(window_limit_, (unsigned int)std::max(steps - 1, 1L));
+    }
+    wanted_.erase(candidate->first);
+    ready_.erase(candidate->first);
+}
+
+void FramePrefetcher::relax()
+{
+    ofScopedLock lock(mutex_);
+    if (window_limit_ < window_)
+    {
+        window_limit_++;
+    }
+}
+
+/*
+ The loaded frame furthest from the current one, never the current one itself. Called with
+ mutex_ locked.
+ */
+std::map<unsigned int, FramePrefetcher::Frame>::const_iterator FramePrefetcher::findEvictionCandidate() const
+{
+    std::map<unsigned int, Frame>::const_iterator candidate = ready_.end();
+    if (!has_previous_)
+    {
+        return candidate;
+    }
+    int furthest = 0;
+    for (std::map<unsigned int, Frame>::const_iterator it = ready_.begin(); it != ready_.end(); ++it) {
+        int away = std::abs(distance(previous_index_, it->first));
+        if (away > furthest)
+        {
+            furthest = away;
+            candidate = it;
+        }
+    }
+    return candidate;
+}
+
+void FramePrefetcher::addLoadTime(uint64_t micros)
+{
+    ofScopedLock lock(mutex_);
+    load_time_ = (load_time_ * 0.9) + (micros * 0.1);
+}
+
+/*
+ The shortest signed distance between two frames, allowing for looping
+ */
+int FramePrefetcher::distance(unsigned int from, unsigned int to) const
+{
+    long size = source_->size();
+    long difference = long(to) - long(from);
+    if (difference > size / 2)
+    {
+        difference -= size;
+    }
+    else if (difference < -(size / 2))
+    {
+        difference += size;
+    }
+    return difference;
+}
+
+bool FramePrefetcher::performJob()
+{
+    mutex_.lock();
+    while (running_ && queue_.empty())
+    {
+        condition_.wait(mutex_);
+    }
+    if (!running_)
+    {
+        mutex_.unlock();
+        return false;
+    }
+    unsigned int index = queue_.front();
+    queue_.pop_front();
+    loading_.insert(index);
+    unsigned int generation = generation_;
+    /*
+     Our reference keeps the source alive if it is replaced while we load from it
+     */
+    std::shared_ptr<FramePathSource> source = source_;
+    mutex_.unlock();
+
+    Frame frame;
+    uint64_t start = ofGetElapsedTimeMicros();
+    {
+        Tracer::Span span("prefetch_frame");
+        frame = source->loadFrame(index);
+    }
+    addLoadTime(ofGetElapsedTimeMicros() - start);
+
+    mutex_.lock();
+    if (generation == generation_)
+    {
+        loading_.erase(index);
+        if (wanted_.count(index))
+        {
+            ready_[index] = frame;
+        }
+    }
+    condition_.broadcast();
+    mutex_.unlock();
+    return true;
+}
+
+FramePrefetcher::Worker::Worker(FramePrefetcher& owner)
+: owner_(owner)
+{
+
+}
+
+void FramePrefetcher::Worker::threadedFunction()
+{
+    Tracer::getShared().setThreadName("prefetch");
+    while (isThreadRunning() && owner_.performJob())
+    {
+
+    }
+}
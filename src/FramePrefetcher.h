@@ -0,0 +1,136 @@
+//
+//  FramePrefetcher.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FramePrefetcher__
+#define __MediaPlayer_client__FramePrefetcher__
+
+#include "ofMain.h"
+#include "MemoryGovernor.h"
+#include "LoadedFrame.h"
+
+/*
+ Supplies frames to a FramePrefetcher. Everything but size() is called from worker threads.
+ */
+class FramePathSource {
+public:
+    virtual ~FramePathSource() {}
+    virtual unsigned int size() const = 0;
+    virtual std::string getPath(unsigned int index) const = 0;
+    /*
+     By default the file at getPath(index) is read
+     */
+    virtual std::shared_ptr<LoadedFrame> loadFrame(unsigned int index) const;
+    /*
+     Sources whose frames aren't separate files advise the OS themselves and return true,
+     otherwise FrameReadahead advises for the file at getPath(index)
+     */
+    virtual bool advise(unsigned int index, bool will_need) const { return false; }
+};
+
+class FrameReadahead;
+
+/*
+ Loads frames ahead of playback on worker threads.
+
+ Each call to getFrame() updates the estimated direction and speed of playback and
+ schedules a window of upcoming frames. Frames are read and decompressed by LoadedFrame on
+ the workers, and uploaded only once shown, so no GL calls are made off the render thread.
+
+ Beyond the window, a FrameReadahead asks the OS to start reading the files which follow.
+
+ As a MemoryConsumer, the loaded frame furthest away is evicted first. If it was ahead the
+ window is shortened so it isn't loaded again, never below one frame, until relax() lets
+ the window grow back.
+ */
+class FramePrefetcher : public MemoryConsumer {
+public:
+    typedef std::shared_ptr<LoadedFrame> Frame;
+    FramePrefetcher();
+    ~FramePrefetcher();
+    void setup(unsigned int thread_count, unsigned int window, unsigned int readahead);
+    void close();
+    /*
+     Pending loads for any previous source are discarded. Loads in progress keep their
+     source alive until they finish, and their frames are dropped, so this doesn't wait.
+     */
+    void setSource(std::shared_ptr<FramePathSource> source);
+    /*
+     Replaces the source with an edited version of it, keeping loaded frames from the first
+     unchanged_start and last unchanged_end frames of the previous source. Doesn't wait,
+     like setSource().
+     */
+    void reloadSource(std::shared_ptr<FramePathSource> source, unsigned int previous_size, unsigned int unchanged_start, unsigned int unchanged_end);
+    /*
+     Reads the file into a pooled buffer and decompresses it. Safe to call from any thread.
+     With shared_cache, the frame is shared with other processes as frame index of the
+     source identified by shared_key.
+     */
+    static Frame loadFrame(const std::string& path, SharedFrameCache *shared_cache = NULL, uint64_t shared_key = 0, unsigned int index = 0);
+    /*
+     Decompresses the contents of a .hpz file already in memory, such as a mapped packed
+     sequence, without copying it
+     */
+    static Frame loadFrame(const char *data, size_t size, SharedFrameCache *shared_cache = NULL, uint64_t shared_key = 0, unsigned int index = 0);
+    /*
+     Returns the frame at index, loading it on the calling thread if it isn't ready.
+     */
+    Frame getFrame(unsigned int index);
+    /*
+     Adds a frame loaded elsewhere for the current source. It is kept if it falls in the
+     window of the next getFrame().
+     */
+    void addFrame(unsigned int index, Frame frame);
+    unsigned int getWindow() const;
+    unsigned long getHitCount() const;
+    unsigned long getMissCount() const;
+    uint64_t getMemoryUsage() const;
+    bool getEvictionCandidate(uint64_t& bytes, double& value) const;
+    void evictCandidate();
+    void relax();
+private:
+    class Worker : public ofThread {
+    public:
+        Worker(FramePrefetcher& owner);
+    protected:
+        void threadedFunction();
+    private:
+        FramePrefetcher& owner_;
+    };
+    bool performJob();
+    void schedule(unsigned int index);
+    int distance(unsigned int from, unsigned int to) const;
+    std::map<unsigned int, Frame>::const_iterator findEvictionCandidate() const;
+    void addLoadTime(uint64_t micros);
+
+    std::vector<std::shared_ptr<Worker> > workers_;
+    std::shared_ptr<FrameReadahead> readahead_;
+    mutable ofMutex mutex_;
+    Poco::Condition condition_;
+    bool running_;
+
+    std::shared_ptr<FramePathSource> source_;
+    // Changed with the source, so loads for a previous one are discarded
+    unsigned int generation_;
+    unsigned int window_;
+    // Lowered by evictions, never above window_ in effect
+    unsigned int window_limit_;
+    // Microseconds, a moving average
+    double load_time_;
+
+    std::deque<unsigned int> queue_;
+    std::set<unsigned int> loading_;
+    std::set<unsigned int> wanted_;
+    std::map<unsigned int, Frame> ready_;
+
+    bool has_previous_;
+    unsigned int previous_index_;
+    float stride_;
+
+    unsigned long hits_;
+    unsigned long misses_;
+};
+
+#endif /* defined(__MediaPlayer_client__FramePrefetcher__) */
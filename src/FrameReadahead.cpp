@@ -0,0 +1,204 @@
+//
+//  FrameReadahead.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "FrameReadahead.h"
+#if defined(TARGET_LINUX) || defined(TARGET_OSX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+FrameReadahead::FrameReadahead()
+: running_(false), pending_(false), generation_(0), frames_(0),
+has_index_(false), index_(0), stride_(1), offset_(0)
+{
+
+}
+
+FrameReadahead::~FrameReadahead()
+{
+    close();
+}
+
+void FrameReadahead::setup(unsigned int frames)
+{
+    close();
+    frames_ = frames;
+    if (frames_ > 0)
+    {
+        running_ = true;
+        startThread();
+    }
+}
+
+void FrameReadahead::close()
+{
+    mutex_.lock();
+    running_ = false;
+    condition_.broadcast();
+    mutex_.unlock();
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+}
+
+void FrameReadahead::setSource(std::shared_ptr<FramePathSource> source)
+{
+    mutex_.lock();
+    generation_++;
+    pending_ = false;
+    has_index_ = false;
+    shown_.clear();
+    advised_.clear();
+    source_ = source;
+    mutex_.unlock();
+}
+
+void FrameReadahead::update(unsigned int index, int stride, unsigned int offset)
+{
+    ofScopedLock lock(mutex_);
+    if (!running_ || !source_)
+    {
+        return;
+    }
+    if (has_index_ && index != index_)
+    {
+        shown_.push_back(index_);
+    }
+    has_index_ = true;
+    index_ = index;
+    stride_ = stride == 0 ? 1 : stride;
+    offset_ = offset;
+    pending_ = true;
+    condition_.signal();
+}
+
+void FrameReadahead::threadedFunction()
+{
+    mutex_.lock();
+    while (running_)
+    {
+        if (!pending_)
+        {
+            condition_.wait(mutex_);
+            continue;
+        }
+        pending_ = false;
+
+        unsigned int generation = generation_;
+        unsigned int size = source_->size();
+        if (size == 0)
+        {
+            continue;
+        }
+        std::vector<unsigned int> shown;
+        shown.swap(shown_);
+
+        std::set<unsigned int> targets;
+        std::vector<unsigned int> wanted;
+        for (unsigned int i = 0; i < frames_ && targets.size() < size; i++)
+        {
+            long target = (long(index_) + (long(stride_) * long(offset_ + i))) % long(size);
+            if (target < 0)
+            {
+                target += size;
+            }
+            if (targets.insert(target).second && advised_.count(target) == 0)
+            {
+                wanted.push_back(target);
+            }
+        }
+
+        /*
+         Forget frames which are now in the prefetch window or behind us
+         */
+        std::set<unsigned int> advised;
+        for (std::set<unsigned int>::const_iterator it = advised_.begin(); it != advised_.end(); ++it) {
+            if (targets.count(*it))
+            {
+                advised.insert(*it);
+            }
+        }
+        advised_.swap(advised);
+
+        std::shared_ptr<FramePathSource> source = source_;
+        /*
+         Nearest frames first, stopping early if playback moves on or the source changes
+         */
+        for (std::vector<unsigned int>::const_iterator it = wanted.begin(); it != wanted.end() && running_ && !pending_ && generation == generation_; ++it) {
+            mutex_.unlock();
+            if (!source->advise(*it, true))
+            {
+                advise(source->getPath(*it), true);
+            }
+            mutex_.lock();
+            if (generation == generation_)
+            {
+                advised_.insert(*it);
+            }
+        }
+        for (std::vector<unsigned int>::const_iterator it = shown.begin(); it != shown.end() && running_ && generation == generation_; ++it) {
+            if (*it < size && targets.count(*it) == 0)
+            {
+                mutex_.unlock();
+                if (!source->advise(*it, false))
+                {
+                    advise(source->getPath(*it), false);
+                }
+                mutex_.lock();
+            }
+        }
+    }
+    mutex_.unlock();
+}
+
+void FrameReadahead::advise(const std::string& path, bool will_need)
+{
+    std::string full_path = ofToDataPath(path);
+#if defined(TARGET_LINUX)
+    int fd = open(full_path.c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        posix_fadvise(fd, 0, 0, will_need ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#elif defined(TARGET_OSX)
+    if (will_need)
+    {
+        int fd = open(full_path.c_str(), O_RDONLY);
+        if (fd != -1)
+        {
+            struct stat info;
+            if (fstat(fd, &info) == 0)
+            {
+                struct radvisory advisory;
+                advisory.ra_offset = 0;
+                advisory.ra_count = std::min(info.st_size, off_t(INT_MAX));
+                fcntl(fd, F_RDADVISE, &advisory);
+            }
+            ::close(fd);
+        }
+    }
+#else
+    if (will_need)
+    {
+        if (scratch_.size() == 0)
+        {
+            scratch_.resize(1024 * 1024);
+        }
+        FILE *file = fopen(full_path.c_str(), "rb");
+        if (file)
+        {
+            while (fread(&scratch_[0], 1, scratch_.size(), file) == scratch_.size())
+            {
+
+            }
+            fclose(file);
+        }
+    }
+#endif
+}
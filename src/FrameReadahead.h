@@ -0,0 +1,62 @@
+//
+//  FrameReadahead.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__FrameReadahead__
+#define __MediaPlayer_client__FrameReadahead__
+
+#include "ofMain.h"
+#include "FramePrefetcher.h"
+
+/*
+ Asks the OS to start reading frame files beyond the prefetch window into the page cache,
+ and to drop files for frames which have been shown.
+
+ Linux uses posix_fadvise(), OS X uses F_RDADVISE (which has no equivalent to DONTNEED),
+ and other platforms read files into a scratch buffer on the readahead thread.
+ Opening the files is done on the readahead thread too, as on network volumes it can
+ account for most of the latency.
+ */
+class FrameReadahead : public ofThread {
+public:
+    FrameReadahead();
+    ~FrameReadahead();
+    void setup(unsigned int frames);
+    void close();
+    /*
+     Advice in progress for the previous source stops after its current file, which keeps
+     the source alive until then.
+     */
+    void setSource(std::shared_ptr<FramePathSource> source);
+    /*
+     Advise for frames starting offset steps of stride from index. A change of index
+     marks the previous index as shown.
+     */
+    void update(unsigned int index, int stride, unsigned int offset);
+protected:
+    void threadedFunction();
+private:
+    void advise(const std::string& path, bool will_need);
+
+    ofMutex mutex_;
+    Poco::Condition condition_;
+    bool running_;
+    bool pending_;
+
+    std::shared_ptr<FramePathSource> source_;
+    unsigned int generation_;
+    unsigned int frames_;
+
+    bool has_index_;
+    unsigned int index_;
+    int stride_;
+    unsigned int offset_;
+    std::vector<unsigned int> shown_;
+    std::set<unsigned int> advised_;
+
+    std::vector<char> scratch_;
+};
+
+#endif /* defined(__MediaPlayer_client__FrameReadahead__) */
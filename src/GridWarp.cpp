@@ -0,0 +1,231 @@
+//
+//  GridWarp.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "GridWarp.h"
+
+/*
+ Catmull-Rom interpolation between b and c
+ */
+static ofPoint interpolate(const ofPoint& a, const ofPoint& b, const ofPoint& c, const ofPoint& d, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return ((b * 2.0) + ((c - a) * t) + (((a * 2.0) - (b * 5.0) + (c * 4.0) - d) * t2) + (((b * 3.0) - a - (c * 3.0) + d) * t3)) * 0.5;
+}
+
+GridWarp::GridWarp()
+: columns_(0), rows_(0), subdivisions_(8), dirty_(false)
+{
+
+}
+
+void GridWarp::setup(unsigned int columns, unsigned int rows, unsigned int subdivisions)
+{
+    columns_ = columns;
+    rows_ = rows;
+    subdivisions_ = std::max(subdivisions, 1U);
+    offsets_.assign(columns_ * rows_, ofPoint(0, 0));
+    if (isActive())
+    {
+        vertices_.resize(getVertexColumns() * getVertexRows());
+        dirty_cells_.assign((columns_ - 1) * (rows_ - 1), true);
+    }
+    else
+    {
+        vertices_.clear();
+        dirty_cells_.clear();
+    }
+    dirty_ = true;
+}
+
+bool GridWarp::isActive() const
+{
+    return columns_ >= 2 && rows_ >= 2;
+}
+
+unsigned int GridWarp::getColumns() const
+{
+    return columns_;
+}
+
+unsigned int GridWarp::getRows() const
+{
+    return rows_;
+}
+
+void GridWarp::setBounds(const ofRectangle& bounds)
+{
+    if (bounds != bounds_)
+    {
+        bounds_ = bounds;
+        dirty_cells_.assign(dirty_cells_.size(), true);
+        dirty_ = true;
+    }
+}
+
+bool GridWarp::setOffset(unsigned int column, unsigned int row, const ofPoint& offset)
+{
+    if (column >= columns_ || row >= rows_)
+    {
+        return false;
+    }
+    unsigned int stored_row = rows_ - 1 - row;
+    offsets_[(stored_row * columns_) + column] = ofPoint(offset.x, 0.0 - offset.y);
+    if (isActive())
+    {
+        /*
+         Mark the cells whose splines use this point
+         */
+        int cell_columns = columns_ - 1;
+        int cell_rows = rows_ - 1;
+        for (int y = std::max(int(stored_row) - 2, 0); y <= std::min(int(stored_row) + 1, cell_rows - 1); y++)
+        {
+            for (int x = std::max(int(column) - 2, 0); x <= std::min(int(column) + 1, cell_columns - 1); x++)
+            {
+                dirty_cells_[(y * cell_columns) + x] = true;
+            }
+        }
+        dirty_ = true;
+    }
+    return true;
+}
+
+ofPoint GridWarp::getOffset(unsigned int column, unsigned int row) const
+{
+    if (column >= columns_ || row >= rows_)
+    {
+        return ofPoint(0, 0);
+    }
+    const ofPoint& offset = offsets_[((rows_ - 1 - row) * columns_) + column];
+    return ofPoint(offset.x, 0.0 - offset.y);
+}
+
+const ofPoint& GridWarp::getStoredOffset(int column, int row) const
+{
+    column = ofClamp(column, 0, columns_ - 1);
+    row = ofClamp(row, 0, rows_ - 1);
+    return offsets_[(row * columns_) + column];
+}
+
+ofPoint GridWarp::evaluate(unsigned int cell_column, unsigned int cell_row, float s, float t) const
+{
+    /*
+     The unwarped position plus the interpolated offset, so a grid without offsets maps
+     every point to itself
+     */
+    ofPoint rows[4];
+    for (int i = 0; i < 4; i++)
+    {
+        int row = int(cell_row) + i - 1;
+        rows[i] = interpolate(getStoredOffset(cell_column - 1, row),
+                              getStoredOffset(cell_column, row),
+                              getStoredOffset(cell_column + 1, row),
+                              getStoredOffset(cell_column + 2, row),
+                              s);
+    }
+    ofPoint offset = interpolate(rows[0], rows[1], rows[2], rows[3], t);
+    float u = (cell_column + s) / (columns_ - 1);
+    float v = (cell_row + t) / (rows_ - 1);
+    return ofPoint(bounds_.x + (u * bounds_.width), bounds_.y + (v * bounds_.height)) + offset;
+}
+
+void GridWarp::update()
+{
+    if (!dirty_ || !isActive())
+    {
+        return;
+    }
+    unsigned int cell_columns = columns_ - 1;
+    unsigned int vertex_columns = getVertexColumns();
+    for (unsigned int cell = 0; cell < dirty_cells_.size(); cell++)
+    {
+        if (!dirty_cells_[cell])
+        {
+            continue;
+        }
+        unsigned int cell_column = cell % cell_columns;
+        unsigned int cell_row = cell / cell_columns;
+        for (unsigned int j = 0; j <= subdivisions_; j++)
+        {
+            for (unsigned int i = 0; i <= subdivisions_; i++)
+            {
+                unsigned int x = (cell_column * subdivisions_) + i;
+                unsigned int y = (cell_row * subdivisions_) + j;
+                vertices_[(y * vertex_columns) + x] = evaluate(cell_column, cell_row, float(i) / subdivisions_, float(j) / subdivisions_);
+            }
+        }
+        dirty_cells_[cell] = false;
+    }
+    dirty_ = false;
+}
+
+const std::vector<ofPoint>& GridWarp::getVertices() const
+{
+    return vertices_;
+}
+
+unsigned int GridWarp::getVertexColumns() const
+{
+    return isActive() ? ((columns_ - 1) * subdivisions_) + 1 : 0;
+}
+
+unsigned int GridWarp::getVertexRows() const
+{
+    return isActive() ? ((rows_ - 1) * subdivisions_) + 1 : 0;
+}
+
+ofPoint GridWarp::map(const ofPoint& point) const
+{
+    if (!isActive() || bounds_.width <= 0 || bounds_.height <= 0)
+    {
+        return point;
+    }
+    float u = ofClamp((point.x - bounds_.x) / bounds_.width, 0.0, 1.0) * (columns_ - 1);
+    float v = ofClamp((point.y - bounds_.y) / bounds_.height, 0.0, 1.0) * (rows_ - 1);
+    unsigned int cell_column = std::min((unsigned int)u, columns_ - 2);
+    unsigned int cell_row = std::min((unsigned int)v, rows_ - 2);
+    return evaluate(cell_column, cell_row, u - cell_column, v - cell_row);
+}
+
+std::string GridWarp::serialize() const
+{
+    if (columns_ == 0 || rows_ == 0)
+    {
+        return "";
+    }
+    std::ostringstream stream;
+    stream << columns_ << "x" << rows_;
+    for (unsigned int row = 0; row < rows_; row++)
+    {
+        for (unsigned int column = 0; column < columns_; column++)
+        {
+            ofPoint offset = getOffset(column, row);
+            stream << ";" << offset.x << "," << offset.y;
+        }
+    }
+    return stream.str();
+}
+
+bool GridWarp::deserialize(const std::string& grid)
+{
+    std::vector<std::string> parts = ofSplitString(grid, ";", true, true);
+    std::vector<std::string> size = parts.empty() ? std::vector<std::string>() : ofSplitString(parts[0], "x");
+    if (size.size() != 2)
+    {
+        setup(0, 0);
+        return grid.empty();
+    }
+    setup(std::max(ofToInt(size[0]), 0), std::max(ofToInt(size[1]), 0), subdivisions_);
+    for (unsigned int i = 1; i < parts.size() && i <= columns_ * rows_; i++)
+    {
+        std::vector<std::string> values = ofSplitString(parts[i], ",");
+        if (values.size() == 2)
+        {
+            setOffset((i - 1) % columns_, (i - 1) / columns_, ofPoint(ofToFloat(values[0]), ofToFloat(values[1])));
+        }
+    }
+    return true;
+}
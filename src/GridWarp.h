@@ -0,0 +1,76 @@
+//
+//  GridWarp.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__GridWarp__
+#define __MediaPlayer_client__GridWarp__
+
+#include "ofMain.h"
+
+/*
+ A grid of control points spread evenly over an output, each of which can be offset to
+ bend the image onto a curved surface. The surface passes through every control point
+ and is interpolated between them with Catmull-Rom splines, tessellated into a number of
+ subdivisions per cell.
+
+ A control point only influences the cells within two of it, so moving one re-tessellates
+ at most sixteen cells.
+
+ Columns count from the left and rows from the bottom, and offsets are in output pixels
+ with y up, matching the rest of the OSC interface.
+ */
+class GridWarp {
+public:
+    GridWarp();
+    /*
+     Discards any offsets. Grids need at least two columns and rows to be active.
+     */
+    void setup(unsigned int columns, unsigned int rows, unsigned int subdivisions = 8);
+    bool isActive() const;
+    unsigned int getColumns() const;
+    unsigned int getRows() const;
+    /*
+     Re-tessellates everything if bounds differ from the current bounds
+     */
+    void setBounds(const ofRectangle& bounds);
+    /*
+     Returns false if the point is outside the grid
+     */
+    bool setOffset(unsigned int column, unsigned int row, const ofPoint& offset);
+    ofPoint getOffset(unsigned int column, unsigned int row) const;
+    /*
+     Re-tessellates any cells affected by changes since the last call
+     */
+    void update();
+    /*
+     Vertices in rows from the top of the output, after update()
+     */
+    const std::vector<ofPoint>& getVertices() const;
+    unsigned int getVertexColumns() const;
+    unsigned int getVertexRows() const;
+    /*
+     Returns the warped position of a point in the output's unwarped bounds
+     */
+    ofPoint map(const ofPoint& point) const;
+    /*
+     Compact representation for settings, eg "3x2;0,0;0,0;0,0;0,0;12.5,-3;0,0"
+     */
+    std::string serialize() const;
+    bool deserialize(const std::string& grid);
+private:
+    ofPoint evaluate(unsigned int cell_column, unsigned int cell_row, float s, float t) const;
+    const ofPoint& getStoredOffset(int column, int row) const;
+    unsigned int columns_;
+    unsigned int rows_;
+    unsigned int subdivisions_;
+    ofRectangle bounds_;
+    // Top to bottom, with y down
+    std::vector<ofPoint> offsets_;
+    std::vector<ofPoint> vertices_;
+    std::vector<bool> dirty_cells_;
+    bool dirty_;
+};
+
+#endif /* defined(__MediaPlayer_client__GridWarp__) */
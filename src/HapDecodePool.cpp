@@ -0,0 +1,210 @@
+//
+//  HapDecodePool.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "HapDecodePool.h"
+#include "Tracer.h"
+#include <thread>
+
+HapDecodePool& HapDecodePool::getShared()
+{
+    static HapDecodePool *pool = new HapDecodePool();
+    return *pool;
+}
+
+void HapDecodePool::decode(void (*function)(void *p, unsigned int index), void *p, unsigned int count, void *info)
+{
+    HapDecodePool *pool = static_cast<HapDecodePool *>(info);
+    if (pool == NULL || count < 2)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            function(p, i);
+        }
+        return;
+    }
+    Job job;
+    job.function = function;
+    job.p = p;
+    job.count = count;
+    job.next = 0;
+    job.finished = 0;
+    pool->run(job, true);
+}
+
+HapDecodePool::HapDecodePool()
+: running_(false), frames_(0), chunks_(0)
+{
+
+}
+
+HapDecodePool::~HapDecodePool()
+{
+    close();
+}
+
+void HapDecodePool::setup(unsigned int thread_count)
+{
+    close();
+    if (thread_count == 0)
+    {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        thread_count = hardware > 1 ? hardware - 1 : 0;
+    }
+    mutex_.lock();
+    running_ = true;
+    mutex_.unlock();
+    for (unsigned int i = 0; i < thread_count; i++)
+    {
+        std::shared_ptr<Worker> worker(new Worker(*this));
+        worker->startThread();
+        workers_.push_back(worker);
+    }
+}
+
+void HapDecodePool::close()
+{
+    mutex_.lock();
+    running_ = false;
+    work_condition_.broadcast();
+    mutex_.unlock();
+    for (std::vector<std::shared_ptr<Worker> >::iterator it = workers_.begin(); it != workers_.end(); ++it) {
+        (*it)->waitForThread(true);
+    }
+    workers_.clear();
+}
+
+void HapDecodePool::perform(void (*function)(void *p, unsigned int index), void *p, unsigned int count)
+{
+    Job job;
+    job.function = function;
+    job.p = p;
+    job.count = count;
+    job.next = 0;
+    job.finished = 0;
+    run(job, false);
+}
+
+unsigned int HapDecodePool::getThreadCount() const
+{
+    return workers_.size();
+}
+
+unsigned long HapDecodePool::getFrameCount() const
+{
+    ofScopedLock lock(mutex_);
+    return frames_;
+}
+
+unsigned long HapDecodePool::getChunkCount() const
+{
+    ofScopedLock lock(mutex_);
+    return chunks_;
+}
+
+void HapDecodePool::run(Job& job, bool counted)
+{
+    mutex_.lock();
+    if (!running_ || workers_.empty())
+    {
+        mutex_.unlock();
+        decode(job.function, job.p, job.count, NULL);
+        return;
+    }
+    if (counted)
+    {
+        frames_++;
+        chunks_ += job.count;
+    }
+    /*
+     Claim the first chunk before the pool can see the job
+     */
+    unsigned int index = job.next++;
+    jobs_.push_back(&job);
+    work_condition_.broadcast();
+    mutex_.unlock();
+    job.function(job.p, index);
+    finishChunk(job);
+    /*
+     Work through the chunks alongside the pool rather than sit idle
+     */
+    while ((index = job.next++) < job.count)
+    {
+        job.function(job.p, index);
+        finishChunk(job);
+    }
+    /*
+     Every chunk has been claimed, so the job can leave the queue; wait for those
+     still being decompressed by the pool
+     */
+    mutex_.lock();
+    std::deque<Job *>::iterator it = std::find(jobs_.begin(), jobs_.end(), &job);
+    if (it != jobs_.end())
+    {
+        jobs_.erase(it);
+    }
+    while (job.finished < job.count)
+    {
+        done_condition_.wait(mutex_);
+    }
+    mutex_.unlock();
+}
+
+bool HapDecodePool::performChunk()
+{
+    mutex_.lock();
+    while (running_ && jobs_.empty())
+    {
+        work_condition_.wait(mutex_);
+    }
+    if (!running_)
+    {
+        mutex_.unlock();
+        return false;
+    }
+    /*
+     A job is only touched while it is queued or one of its chunks is claimed but unfinished,
+     as its owner returns as soon as neither is true
+     */
+    Job *job = jobs_.front();
+    unsigned int index = job->next++;
+    bool claimed = index < job->count;
+    if (index + 1 >= job->count)
+    {
+        jobs_.pop_front();
+    }
+    mutex_.unlock();
+    if (claimed)
+    {
+        job->function(job->p, index);
+        finishChunk(*job);
+    }
+    return true;
+}
+
+void HapDecodePool::finishChunk(Job& job)
+{
+    ofScopedLock lock(mutex_);
+    job.finished++;
+    if (job.finished == job.count)
+    {
+        done_condition_.broadcast();
+    }
+}
+
+HapDecodePool::Worker::Worker(HapDecodePool& owner)
+: owner_(owner)
+{
+
+}
+
+void HapDecodePool::Worker::threadedFunction()
+{
+    Tracer::getShared().setThreadName("hap_decode");
+    while (isThreadRunning() && owner_.performChunk())
+    {
+
+    }
+}
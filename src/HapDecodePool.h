@@ -0,0 +1,78 @@
+//
+//  HapDecodePool.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__HapDecodePool__
+#define __MediaPlayer_client__HapDecodePool__
+
+#include "ofMain.h"
+#include <atomic>
+#include <deque>
+
+/*
+ Decompresses the chunks of a Hap frame in parallel on a persistent set of threads.
+
+ Pass decode() to HapDecode() as its callback, with the pool as its info. The calling
+ thread decompresses chunks alongside the pool and returns once every chunk is done, so
+ the frame is complete before it is uploaded. Several frames may decode at once, their
+ chunks shared between the threads in the order the frames arrived.
+ */
+class HapDecodePool {
+public:
+    /*
+     The pool shared by every source. It is never destroyed.
+     */
+    static HapDecodePool& getShared();
+    /*
+     HapDecode()'s callback. info is the HapDecodePool to use, or NULL to decode serially.
+     */
+    static void decode(void (*function)(void *p, unsigned int index), void *p, unsigned int count, void *info);
+    HapDecodePool();
+    ~HapDecodePool();
+    /*
+     Starts thread_count threads in addition to the decoding thread, replacing any running.
+     Zero runs one fewer than the number of hardware threads.
+     */
+    void setup(unsigned int thread_count);
+    void close();
+    /*
+     Calls function for each index below count, on the pool and the calling thread as decode()
+     does, but isn't counted as a frame. The calling thread takes the first index.
+     */
+    void perform(void (*function)(void *p, unsigned int index), void *p, unsigned int count);
+    unsigned int getThreadCount() const;
+    unsigned long getFrameCount() const;
+    unsigned long getChunkCount() const;
+private:
+    struct Job {
+        void (*function)(void *p, unsigned int index);
+        void *p;
+        unsigned int count;
+        std::atomic<unsigned int> next;
+        unsigned int finished;
+    };
+    class Worker : public ofThread {
+    public:
+        Worker(HapDecodePool& owner);
+    protected:
+        void threadedFunction();
+    private:
+        HapDecodePool& owner_;
+    };
+    void run(Job& job, bool counted);
+    bool performChunk();
+    void finishChunk(Job& job);
+
+    std::vector<std::shared_ptr<Worker> > workers_;
+    mutable ofMutex mutex_;
+    Poco::Condition work_condition_;
+    Poco::Condition done_condition_;
+    bool running_;
+    std::deque<Job *> jobs_;
+    unsigned long frames_;
+    unsigned long chunks_;
+};
+
+#endif /* defined(__MediaPlayer_client__HapDecodePool__) */
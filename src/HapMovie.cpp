@@ -0,0 +1,455 @@
+//
+//  HapMovie.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "HapMovie.h"
+#include "HapDecodePool.h"
+#include "FrameFingerprint.h"
+#include <hap.h>
+#if defined(TARGET_WIN32)
+#define fseeko _fseeki64
+#endif
+
+// Frames from the start kept through the loop, at most half the cache
+static const unsigned int LoopStartFrames = 8;
+
+HapMovie::HapMovie()
+: file_(NULL), position_(0), texture_format_(0), has_frame_(false), current_frame_(0), current_fingerprint_(0),
+cache_size_(30), cache_limit_(UINT_MAX), decode_time_(10000.0), cache_hits_(0), cache_misses_(0), seeks_(0),
+shared_cache_(NULL), shared_key_(0), shared_hits_(0)
+{
+
+}
+
+HapMovie::~HapMovie()
+{
+    close();
+}
+
+bool HapMovie::load(const std::string& path)
+{
+    MovieIndex index;
+    return index.load(path) && load(path, index);
+}
+
+bool HapMovie::load(const std::string& path, MovieIndex& index)
+{
+    close();
+    if (index.size() == 0)
+    {
+        return false;
+    }
+    index_.swap(index);
+    const std::string& codec = index_.getCodec();
+    if (codec == "Hap1")
+    {
+        texture_format_ = HapTextureFormat_RGB_DXT1;
+    }
+    else if (codec == "Hap5")
+    {
+        texture_format_ = HapTextureFormat_RGBA_DXT5;
+    }
+    else if (codec == "HapY")
+    {
+        texture_format_ = HapTextureFormat_YCoCg_DXT5;
+    }
+    else
+    {
+        index_.clear();
+        return false;
+    }
+    file_ = fopen(ofToDataPath(path, true).c_str(), "rb");
+    if (file_ == NULL)
+    {
+        index_.clear();
+        return false;
+    }
+    position_ = 0;
+    /*
+     Processes sharing frames agree on the movie by its path and shape
+     */
+    std::string description = ofToDataPath(path, true) + ":" + codec + ":" + ofToString(index_.size()) + ":" +
+        ofToString(index_.getWidth()) + "x" + ofToString(index_.getHeight());
+    shared_key_ = FrameFingerprint::hash(description.data(), description.size());
+
+    texture_.allocate(index_.getWidth(), index_.getHeight(), texture_format_);
+    return true;
+}
+
+void HapMovie::close()
+{
+    if (file_)
+    {
+        fclose(file_);
+        file_ = NULL;
+    }
+    index_.clear();
+    cache_.clear();
+    texture_.clear();
+    has_frame_ = false;
+    cache_hits_ = cache_misses_ = seeks_ = shared_hits_ = 0;
+}
+
+bool HapMovie::isLoaded() const
+{
+    return file_ != NULL;
+}
+
+unsigned int HapMovie::getTotalNumFrames() const
+{
+    return index_.size();
+}
+
+float HapMovie::getWidth() const
+{
+    return index_.getWidth();
+}
+
+float HapMovie::getHeight() const
+{
+    return index_.getHeight();
+}
+
+void HapMovie::setCacheSize(unsigned int frames)
+{
+    cache_size_ = std::max(frames, 1U);
+    while (cache_.size() > cache_size_)
+    {
+        cache_.erase(findReplacement());
+    }
+}
+
+void HapMovie::setSharedCache(SharedFrameCache *cache)
+{
+    shared_cache_ = cache;
+}
+
+bool HapMovie::setFrame(unsigned int frame)
+{
+    if (!isLoaded() || frame >= index_.size())
+    {
+        return false;
+    }
+    if (has_frame_ && frame == current_frame_)
+    {
+        return true;
+    }
+    std::shared_ptr<DecodedFrame> decoded;
+    for (std::list<std::shared_ptr<DecodedFrame> >::iterator it = cache_.begin(); it != cache_.end(); ++it) {
+        if ((*it)->frame == frame)
+        {
+            decoded = *it;
+            cache_.erase(it);
+            break;
+        }
+    }
+    if (decoded)
+    {
+        cache_hits_++;
+    }
+    else
+    {
+        SharedFrameCache::Reference shared;
+        SharedFrameCache::Result shared_result = SharedFrameCache::Miss;
+        if (shared_cache_ != NULL)
+        {
+            /*
+             Wait a little longer than decoding would take for another process decoding it
+             */
+            shared_result = shared_cache_->acquire(shared_key_, frame, getDecodedSize(), shared, uint64_t(decode_time_ * 2.0));
+        }
+        if (shared_result == SharedFrameCache::Reserved)
+        {
+            /*
+             Decode straight into the slot. Like a shared hit, the frame is released once
+             uploaded and not kept in our cache.
+             */
+            cache_misses_++;
+            uint64_t start = ofGetElapsedTimeMicros();
+            uint64_t fingerprint = 0;
+            if (!decode(frame, shared.data, fingerprint))
+            {
+                shared_cache_->release(shared);
+                return false;
+            }
+            decode_time_ = (decode_time_ * 0.9) + ((ofGetElapsedTimeMicros() - start) * 0.1);
+            shared.tag = fingerprint;
+            shared_cache_->publish(shared);
+            texture_.upload(shared.data, shared.size);
+            shared_cache_->release(shared);
+            current_frame_ = frame;
+            current_fingerprint_ = fingerprint;
+            has_frame_ = true;
+            return true;
+        }
+        if (shared_result == SharedFrameCache::Hit)
+        {
+            /*
+             The upload copies the frame before returning, so it is released at once and
+             not kept in our cache
+             */
+            shared_hits_++;
+            texture_.upload(shared.data, shared.size);
+            shared_cache_->release(shared);
+            current_frame_ = frame;
+            current_fingerprint_ = shared.tag;
+            has_frame_ = true;
+            return true;
+        }
+        cache_misses_++;
+        /*
+         Reuse the least recently used frame's buffer if the cache is full
+         */
+        if (cache_.size() >= std::min(cache_size_, cache_limit_))
+        {
+            std::list<std::shared_ptr<DecodedFrame> >::iterator replaced = findReplacement();
+            decoded = *replaced;
+            cache_.erase(replaced);
+        }
+        else
+        {
+            decoded = std::shared_ptr<DecodedFrame>(new DecodedFrame());
+        }
+        /*
+         A buffer evicted from the cache is already the right size
+         */
+        size_t size = getDecodedSize();
+        if (!decoded->data || decoded->data->size() != long(size))
+        {
+            decoded->data = FrameBufferPool::getShared().acquire(size);
+        }
+        decoded->frame = frame;
+        uint64_t start = ofGetElapsedTimeMicros();
+        if (!decode(frame, reinterpret_cast<unsigned char *>(decoded->data->getBinaryBuffer()), decoded->fingerprint))
+        {
+            return false;
+        }
+        decode_time_ = (decode_time_ * 0.9) + ((ofGetElapsedTimeMicros() - start) * 0.1);
+    }
+    cache_.push_front(decoded);
+    texture_.upload(decoded->data->getBinaryBuffer(), decoded->data->size());
+    current_frame_ = frame;
+    current_fingerprint_ = decoded->fingerprint;
+    has_frame_ = true;
+    return true;
+}
+
+/*
+ Index 0 decodes the frame, index 1 hashes its compressed data
+ */
+struct FrameWork {
+    const char *compressed;
+    unsigned long compressed_size;
+    unsigned char *decoded;
+    unsigned long decoded_size;
+    unsigned int result;
+    uint64_t fingerprint;
+};
+
+static void performFrameWork(void *p, unsigned int index)
+{
+    FrameWork *work = static_cast<FrameWork *>(p);
+    if (index == 0)
+    {
+        unsigned long used = 0;
+        unsigned int format = 0;
+        work->result = HapDecode(work->compressed, work->compressed_size,
+                                 HapDecodePool::decode, &HapDecodePool::getShared(),
+                                 work->decoded, work->decoded_size, &used, &format);
+    }
+    else
+    {
+        work->fingerprint = FrameFingerprint::hash(work->compressed, work->compressed_size);
+    }
+}
+
+bool HapMovie::decode(unsigned int frame, unsigned char *output, uint64_t& fingerprint)
+{
+    const MovieIndex::Sample& sample = index_.getSample(frame);
+    if (sample.offset != position_)
+    {
+        if (fseeko(file_, sample.offset, SEEK_SET) != 0)
+        {
+            return false;
+        }
+        seeks_++;
+    }
+    FrameBufferPool& pool = FrameBufferPool::getShared();
+    FrameBufferPool::Buffer compressed = pool.acquire(std::max(sample.size, 1U));
+    if (fread(compressed->getBinaryBuffer(), 1, sample.size, file_) != sample.size)
+    {
+        /*
+         Force a seek next time, as the position is unknown
+         */
+        position_ = UINT64_MAX;
+        ofLogError("HapMovie") << "Unable to read frame " << frame;
+        return false;
+    }
+    position_ = sample.offset + sample.size;
+
+    FrameWork work;
+    work.compressed = compressed->getBinaryBuffer();
+    work.compressed_size = sample.size;
+    work.decoded = output;
+    work.decoded_size = getDecodedSize();
+    work.result = HapResult_Internal_Error;
+    work.fingerprint = 0;
+    if (FrameFingerprint::isEnabled())
+    {
+        /*
+         Hash on a pool thread while this one decodes
+         */
+        HapDecodePool::getShared().perform(performFrameWork, &work, 2);
+    }
+    else
+    {
+        performFrameWork(&work, 0);
+    }
+    fingerprint = work.fingerprint;
+    if (work.result != HapResult_No_Error)
+    {
+        ofLogError("HapMovie") << "Unable to decode frame " << frame << " (" << work.result << ")";
+        return false;
+    }
+    return true;
+}
+
+size_t HapMovie::getDecodedSize() const
+{
+    return HapTexture::getDecodedSize(index_.getWidth(), index_.getHeight(), texture_format_);
+}
+
+ofTexture *HapMovie::getTexture()
+{
+    return has_frame_ ? &texture_.getTexture() : NULL;
+}
+
+ofShader *HapMovie::getShader()
+{
+    return texture_.getShader();
+}
+
+uint64_t HapMovie::getMemoryUsage() const
+{
+    uint64_t usage = 0;
+    for (std::list<std::shared_ptr<DecodedFrame> >::const_iterator it = cache_.begin(); it != cache_.end(); ++it) {
+        if ((*it)->data)
+        {
+            usage += (*it)->data->size();
+        }
+    }
+    return usage;
+}
+
+bool HapMovie::getEvictionCandidate(uint64_t& bytes, double& value) const
+{
+    std::list<std::shared_ptr<DecodedFrame> >::const_iterator candidate = findEvictionCandidate();
+    if (candidate == cache_.end())
+    {
+        return false;
+    }
+    bytes = (*candidate)->data ? (*candidate)->data->size() : 0;
+    value = decode_time_ / (1 + distance(current_frame_, (*candidate)->frame));
+    return true;
+}
+
+void HapMovie::evictCandidate()
+{
+    std::list<std::shared_ptr<DecodedFrame> >::const_iterator candidate = findEvictionCandidate();
+    if (candidate == cache_.end())
+    {
+        return;
+    }
+    cache_.erase(candidate);
+    cache_limit_ = std::max((unsigned int)cache_.size(), 1U);
+}
+
+void HapMovie::relax()
+{
+    if (cache_limit_ < cache_size_)
+    {
+        cache_limit_++;
+    }
+}
+
+/*
+ Frames at the start of the movie, which a loop returns to after the rest have been read
+ */
+bool HapMovie::isPinned(unsigned int frame) const
+{
+    return frame < std::min(LoopStartFrames, cache_size_ / 2);
+}
+
+/*
+ The least recently used frame which isn't pinned, or the least recently used if all are.
+ The cache must not be empty.
+ */
+std::list<std::shared_ptr<HapMovie::DecodedFrame> >::iterator HapMovie::findReplacement()
+{
+    for (std::list<std::shared_ptr<DecodedFrame> >::iterator it = cache_.end(); it != cache_.begin();) {
+        --it;
+        if (!isPinned((*it)->frame))
+        {
+            return it;
+        }
+    }
+    return --cache_.end();
+}
+
+/*
+ The cached frame furthest from the shown one, preferring frames which aren't pinned, and
+ never the shown one itself
+ */
+std::list<std::shared_ptr<HapMovie::DecodedFrame> >::const_iterator HapMovie::findEvictionCandidate() const
+{
+    std::list<std::shared_ptr<DecodedFrame> >::const_iterator candidate = cache_.end();
+    unsigned int furthest = 0;
+    bool candidate_pinned = true;
+    for (std::list<std::shared_ptr<DecodedFrame> >::const_iterator it = cache_.begin(); it != cache_.end(); ++it) {
+        unsigned int away = distance(current_frame_, (*it)->frame);
+        bool pinned = isPinned((*it)->frame);
+        if (away > 0 && ((candidate_pinned && !pinned) || (pinned == candidate_pinned && away > furthest)))
+        {
+            furthest = away;
+            candidate = it;
+            candidate_pinned = pinned;
+        }
+    }
+    return candidate;
+}
+
+/*
+ The distance between two frames, allowing for looping
+ */
+unsigned int HapMovie::distance(unsigned int from, unsigned int to) const
+{
+    unsigned int difference = from > to ? from - to : to - from;
+    return std::min(difference, (unsigned int)index_.size() - difference);
+}
+
+uint64_t HapMovie::getFingerprint() const
+{
+    return has_frame_ ? current_fingerprint_ : 0;
+}
+
+unsigned long HapMovie::getSharedHitCount() const
+{
+    return shared_hits_;
+}
+
+unsigned long HapMovie::getCacheHitCount() const
+{
+    return cache_hits_;
+}
+
+unsigned long HapMovie::getCacheMissCount() const
+{
+    return cache_misses_;
+}
+
+unsigned long HapMovie::getSeekCount() const
+{
+    return seeks_;
+}
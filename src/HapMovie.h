@@ -0,0 +1,121 @@
+//
+//  HapMovie.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__HapMovie__
+#define __MediaPlayer_client__HapMovie__
+
+#include "ofMain.h"
+#include "MovieIndex.h"
+#include "FrameBufferPool.h"
+#include "MemoryGovernor.h"
+#include "SharedFrameCache.h"
+#include "HapTexture.h"
+
+/*
+ Plays Hap movies by reading frames directly from their sample offsets, rather than
+ seeking a demuxer, and keeps the most recently decoded frames so loop points and short
+ scrubs don't need to be read or decompressed again.
+
+ Reading the frame after the last one read continues from the file's current position,
+ so sequential playback never seeks. The first few frames are kept in preference to others
+ once shown, so they are still cached when playback loops back to them.
+
+ With a SharedFrameCache, frames missing from the cache are looked for in shared memory
+ before being decoded, and frames this process has to decode are decoded straight into
+ shared memory for the others. Frames found or decoded there aren't kept in our own cache.
+
+ As a MemoryConsumer, the cached frame furthest from the shown one is evicted first and the
+ cache held at its reduced size until relax() lets it grow back.
+ */
+class HapMovie : public MemoryConsumer {
+public:
+    HapMovie();
+    ~HapMovie();
+    /*
+     Returns false if the movie isn't in a Hap format we can decode
+     */
+    bool load(const std::string& path);
+    /*
+     Uses an index already loaded from path, taking its contents
+     */
+    bool load(const std::string& path, MovieIndex& index);
+    void close();
+    bool isLoaded() const;
+    unsigned int getTotalNumFrames() const;
+    float getWidth() const;
+    float getHeight() const;
+    /*
+     Number of decoded frames to keep
+     */
+    void setCacheSize(unsigned int frames);
+    /*
+     cache must outlive the movie, or be replaced with NULL
+     */
+    void setSharedCache(SharedFrameCache *cache);
+    /*
+     Reads, decodes and uploads the frame if it isn't already shown. Returns false on error.
+     */
+    bool setFrame(unsigned int frame);
+    ofTexture *getTexture();
+    /*
+     The shader to draw the texture with, or NULL if none is needed
+     */
+    ofShader *getShader();
+    /*
+     FrameFingerprint's hash of the shown frame's compressed data, or 0 if fingerprints
+     weren't enabled when it was read
+     */
+    uint64_t getFingerprint() const;
+    unsigned long getCacheHitCount() const;
+    unsigned long getCacheMissCount() const;
+    unsigned long getSeekCount() const;
+    unsigned long getSharedHitCount() const;
+    uint64_t getMemoryUsage() const;
+    bool getEvictionCandidate(uint64_t& bytes, double& value) const;
+    void evictCandidate();
+    void relax();
+private:
+    struct DecodedFrame {
+        FrameBufferPool::Buffer data;
+        unsigned int frame;
+        uint64_t fingerprint;
+    };
+    /*
+     Reads and decodes frame into output, which holds getDecodedSize() bytes
+     */
+    bool decode(unsigned int frame, unsigned char *output, uint64_t& fingerprint);
+    size_t getDecodedSize() const;
+    bool isPinned(unsigned int frame) const;
+    std::list<std::shared_ptr<DecodedFrame> >::iterator findReplacement();
+    std::list<std::shared_ptr<DecodedFrame> >::const_iterator findEvictionCandidate() const;
+    unsigned int distance(unsigned int from, unsigned int to) const;
+    MovieIndex index_;
+    FILE *file_;
+    uint64_t position_;
+    // The HapTextureFormat of the movie's frames
+    unsigned int texture_format_;
+    HapTexture texture_;
+    bool has_frame_;
+    unsigned int current_frame_;
+    uint64_t current_fingerprint_;
+
+    // Most recently used first
+    std::list<std::shared_ptr<DecodedFrame> > cache_;
+    unsigned int cache_size_;
+    // Lowered by evictions, never above cache_size_ in effect
+    unsigned int cache_limit_;
+    // Microseconds to read and decode a frame, a moving average
+    double decode_time_;
+    unsigned long cache_hits_;
+    unsigned long cache_misses_;
+    unsigned long seeks_;
+    SharedFrameCache *shared_cache_;
+    // Identifies the movie to other processes
+    uint64_t shared_key_;
+    unsigned long shared_hits_;
+};
+
+#endif /* defined(__MediaPlayer_client__HapMovie__) */
@@ -0,0 +1,122 @@
+//
+//  HapTexture.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "HapTexture.h"
+#include <hap.h>
+
+/*
+ Converts scaled YCoCg to RGB, for Hap Q
+ */
+static const char *ycocg_vertex_shader =
+    "void main(void)\n"
+    "{\n"
+    "    gl_Position = ftransform();\n"
+    "    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+    "}\n";
+
+static const char *ycocg_fragment_shader =
+    "uniform sampler2D cocgsy_src;\n"
+    "const vec4 offsets = vec4(-0.50196078431373, -0.50196078431373, 0.0, 0.0);\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 CoCgSY = texture2D(cocgsy_src, gl_TexCoord[0].xy);\n"
+    "    CoCgSY += offsets;\n"
+    "    float scale = (CoCgSY.z * (255.0 / 8.0)) + 1.0;\n"
+    "    float Co = CoCgSY.x / scale;\n"
+    "    float Cg = CoCgSY.y / scale;\n"
+    "    float Y = CoCgSY.w;\n"
+    "    gl_FragColor = vec4(Y + Co - Cg, Y + Cg, Y - Co - Cg, 1.0);\n"
+    "}\n";
+
+/*
+ Hap Q is DXT5 data holding YCoCg
+ */
+static GLenum getInternalFormat(unsigned int texture_format)
+{
+    return texture_format == HapTextureFormat_RGB_DXT1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+HapTexture::HapTexture()
+: width_(0), height_(0), texture_format_(0)
+{
+
+}
+
+bool HapTexture::isSupported(unsigned int texture_format)
+{
+    return texture_format == HapTextureFormat_RGB_DXT1 || texture_format == HapTextureFormat_RGBA_DXT5 || texture_format == HapTextureFormat_YCoCg_DXT5;
+}
+
+/*
+ DXT blocks are 4x4 pixels, 8 bytes each for DXT1 and 16 for DXT5
+ */
+size_t HapTexture::getDecodedSize(unsigned int width, unsigned int height, unsigned int texture_format)
+{
+    size_t bytes_per_block = texture_format == HapTextureFormat_RGB_DXT1 ? 8 : 16;
+    return size_t((width + 3) / 4) * size_t((height + 3) / 4) * bytes_per_block;
+}
+
+void HapTexture::allocate(unsigned int width, unsigned int height, unsigned int texture_format)
+{
+    if (isAllocated() && width == width_ && height == height_ && texture_format == texture_format_)
+    {
+        return;
+    }
+    width_ = width;
+    height_ = height;
+    texture_format_ = texture_format;
+    /*
+     DXT textures are made of 4x4 blocks
+     */
+    ofTextureData texture_data;
+    texture_data.width = (width + 3) & ~3U;
+    texture_data.height = (height + 3) & ~3U;
+    texture_data.textureTarget = GL_TEXTURE_2D;
+    texture_data.glTypeInternal = getInternalFormat(texture_format);
+    texture_.allocate(texture_data, GL_RGBA, GL_UNSIGNED_BYTE);
+    ofTextureData& allocated = texture_.getTextureData();
+    allocated.width = width;
+    allocated.height = height;
+    allocated.tex_t = float(width) / allocated.tex_w;
+    allocated.tex_u = float(height) / allocated.tex_h;
+
+    if (texture_format == HapTextureFormat_YCoCg_DXT5 && !shader_.isLoaded())
+    {
+        shader_.setupShaderFromSource(GL_VERTEX_SHADER, ycocg_vertex_shader);
+        shader_.setupShaderFromSource(GL_FRAGMENT_SHADER, ycocg_fragment_shader);
+        shader_.linkProgram();
+    }
+}
+
+void HapTexture::clear()
+{
+    texture_.clear();
+    width_ = height_ = texture_format_ = 0;
+}
+
+bool HapTexture::isAllocated() const
+{
+    return texture_.isAllocated();
+}
+
+void HapTexture::upload(const void *data, size_t size)
+{
+    const ofTextureData& texture_data = texture_.getTextureData();
+    glBindTexture(GL_TEXTURE_2D, texture_data.textureID);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (width_ + 3) & ~3U, (height_ + 3) & ~3U,
+                              getInternalFormat(texture_format_), size, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+ofTexture& HapTexture::getTexture()
+{
+    return texture_;
+}
+
+ofShader *HapTexture::getShader()
+{
+    return texture_format_ == HapTextureFormat_YCoCg_DXT5 ? &shader_ : NULL;
+}
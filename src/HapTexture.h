@@ -0,0 +1,44 @@
+//
+//  HapTexture.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__HapTexture__
+#define __MediaPlayer_client__HapTexture__
+
+#include "ofMain.h"
+
+/*
+ A texture frames decoded by HapDecode() are uploaded to, reallocated only when the frame
+ size or format changes, with the shader Hap Q frames are drawn with.
+ */
+class HapTexture {
+public:
+    HapTexture();
+    /*
+     texture_format is the HapTextureFormat HapDecode() reports for the frames
+     */
+    void allocate(unsigned int width, unsigned int height, unsigned int texture_format);
+    void clear();
+    bool isAllocated() const;
+    /*
+     Uploads a decoded frame of getDecodedSize() bytes
+     */
+    void upload(const void *data, size_t size);
+    ofTexture& getTexture();
+    /*
+     The shader to draw the texture with, or NULL if none is needed
+     */
+    ofShader *getShader();
+    static bool isSupported(unsigned int texture_format);
+    static size_t getDecodedSize(unsigned int width, unsigned int height, unsigned int texture_format);
+private:
+    ofTexture texture_;
+    ofShader shader_;
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int texture_format_;
+};
+
+#endif /* defined(__MediaPlayer_client__HapTexture__) */
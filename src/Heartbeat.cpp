@@ -0,0 +1,73 @@
+//
+//  Heartbeat.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "Heartbeat.h"
+
+Heartbeat::Heartbeat()
+: interval_(1000000), last_sent_(0), last_hits_(0), last_misses_(0)
+{
+
+}
+
+void Heartbeat::setup(const std::string& destination, float interval)
+{
+    sender_.reset();
+    interval_ = uint64_t(std::max(interval, 0.01f) * 1000000.0);
+    std::vector<std::string> parts = ofSplitString(destination, ":");
+    if (parts.size() == 2)
+    {
+        try {
+            std::shared_ptr<ofxOscSender> sender(new ofxOscSender());
+            sender->setup(parts[0], ofToInt(parts[1]));
+            sender_ = sender;
+        } catch (std::exception& e) {
+            ofLogError("Heartbeat") << "Unable to send to " << destination << ": " << e.what();
+        }
+    }
+    else if (!destination.empty())
+    {
+        ofLogError("Heartbeat") << "Heartbeat destination must be host:port, not " << destination;
+    }
+}
+
+bool Heartbeat::isActive() const
+{
+    return sender_ != NULL;
+}
+
+bool Heartbeat::isDue(uint64_t now_micros) const
+{
+    return sender_ && now_micros - last_sent_ >= interval_;
+}
+
+void Heartbeat::send(const std::string& client_id, const Status& status, uint64_t now_micros)
+{
+    /*
+     Report the hit rate since the last heartbeat, starting again if the source changed
+     */
+    if (status.cache_hits < last_hits_ || status.cache_misses < last_misses_)
+    {
+        last_hits_ = last_misses_ = 0;
+    }
+    unsigned long hits = status.cache_hits - last_hits_;
+    unsigned long lookups = hits + status.cache_misses - last_misses_;
+    last_hits_ = status.cache_hits;
+    last_misses_ = status.cache_misses;
+
+    ofxOscMessage message;
+    message.setAddress("/client/heartbeat");
+    message.addStringArg(client_id);
+    message.addInt64Arg(status.displayed_frame);
+    message.addInt64Arg(status.received_frame);
+    message.addIntArg(status.received_frame - status.displayed_frame);
+    message.addFloatArg(status.decode_time);
+    message.addFloatArg(status.draw_time);
+    message.addFloatArg(status.frame_rate);
+    message.addIntArg(status.discontinuities);
+    message.addFloatArg(lookups > 0 ? float(hits) / lookups : 1.0);
+    sender_->sendMessage(message);
+    last_sent_ = now_micros;
+}
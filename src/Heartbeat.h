@@ -0,0 +1,47 @@
+//
+//  Heartbeat.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__Heartbeat__
+#define __MediaPlayer_client__Heartbeat__
+
+#include "ofMain.h"
+#include <ofxOsc.h>
+
+/*
+ Sends the client's playback status to a server at a fixed interval, so lagging clients
+ can be found without polling each one.
+ */
+class Heartbeat {
+public:
+    struct Status {
+        long displayed_frame;
+        long received_frame;
+        // Milliseconds
+        float decode_time;
+        float draw_time;
+        float frame_rate;
+        unsigned int discontinuities;
+        // Totals for the current source, which may restart from zero
+        unsigned long cache_hits;
+        unsigned long cache_misses;
+    };
+    Heartbeat();
+    /*
+     destination is host:port, or empty to stop sending
+     */
+    void setup(const std::string& destination, float interval);
+    bool isActive() const;
+    bool isDue(uint64_t now_micros) const;
+    void send(const std::string& client_id, const Status& status, uint64_t now_micros);
+private:
+    std::shared_ptr<ofxOscSender> sender_;
+    uint64_t interval_;
+    uint64_t last_sent_;
+    unsigned long last_hits_;
+    unsigned long last_misses_;
+};
+
+#endif /* defined(__MediaPlayer_client__Heartbeat__) */
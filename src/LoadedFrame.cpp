@@ -0,0 +1,348 @@
+//
+//  LoadedFrame.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "LoadedFrame.h"
+#include "HapDecodePool.h"
+#include "FrameFingerprint.h"
+#include <hap.h>
+#include <atomic>
+
+// The largest header searched for the Hap frame, and the largest dimension believed
+static const size_t MaxHeaderSize = 256;
+static const uint32_t MaxDimension = 16384;
+// Microseconds to wait for another process decoding a shared frame, a little longer than a
+// large frame takes to decode
+static const uint64_t SharedWaitMicros = 50000;
+
+/*
+ Where the width and height are in the header, as the index of the width's word times two,
+ plus one if they are big-endian. -1 until learned from a file ofxHapImage has loaded, by
+ finding its width and height in the header, so it is never guessed from frame sizes.
+ */
+static std::atomic<int> dimensions_layout(-1);
+
+static uint32_t readWord(const unsigned char *bytes, bool big_endian)
+{
+    if (big_endian)
+    {
+        return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+    }
+    return (uint32_t(bytes[3]) << 24) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[1]) << 8) | uint32_t(bytes[0]);
+}
+
+/*
+ Hap section headers are a three byte little-endian size and a type byte, or a zero size
+ followed by a four byte size. Returns the offset of the section which fills the rest of
+ the file, or 0 if there is none.
+ */
+static size_t findFrame(const unsigned char *data, size_t size)
+{
+    for (size_t offset = 8; offset + 8 <= size && offset <= MaxHeaderSize; offset += 4)
+    {
+        const unsigned char *section = data + offset;
+        uint64_t section_size = section[0] | (section[1] << 8) | (section[2] << 16);
+        size_t header_size = 4;
+        if (section_size == 0)
+        {
+            section_size = readWord(section + 4, false);
+            header_size = 8;
+        }
+        unsigned int texture_format;
+        if (section_size + header_size == size - offset &&
+            HapGetFrameTextureFormat(section, size - offset, &texture_format) == HapResult_No_Error)
+        {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+static uint64_t getFingerprint(const void *data, size_t size)
+{
+    return FrameFingerprint::isEnabled() ? FrameFingerprint::hash(data, size) : 0;
+}
+
+/*
+ Reads the width and height at layout from a header of header_size bytes. Returns false if
+ they don't fit in the header or aren't believable.
+ */
+static bool readDimensions(const unsigned char *bytes, size_t header_size, int layout, uint32_t& width, uint32_t& height)
+{
+    if (layout < 0 || (size_t(layout / 2) + 2) * 4 > header_size)
+    {
+        return false;
+    }
+    bool big_endian = layout % 2;
+    width = readWord(bytes + ((layout / 2) * 4), big_endian);
+    height = readWord(bytes + ((layout / 2) * 4) + 4, big_endian);
+    return width > 0 && height > 0 && width <= MaxDimension && height <= MaxDimension;
+}
+
+LoadedFrame::LoadedFrame()
+: fingerprint(0), memory_size(0), shared_cache_(NULL), shared_key_(0), shared_index_(0),
+width_(0), height_(0), texture_format_(0), header_size_(0)
+{
+
+}
+
+LoadedFrame::~LoadedFrame()
+{
+    if (shared_.slot >= 0)
+    {
+        shared_cache_->release(shared_);
+    }
+}
+
+void LoadedFrame::setSharing(SharedFrameCache *cache, uint64_t key, unsigned int index)
+{
+    shared_cache_ = cache != NULL && cache->isOpen() ? cache : NULL;
+    shared_key_ = key;
+    shared_index_ = index;
+}
+
+bool LoadedFrame::load(const char *data, size_t size)
+{
+    if (decode(data, size))
+    {
+        return true;
+    }
+    fingerprint = getFingerprint(data, size);
+    /*
+     ofxHapImage only loads from an ofBuffer, so copy into a pooled one rather than a new one
+     */
+    FrameBufferPool::Buffer file = FrameBufferPool::getShared().acquire(size);
+    memcpy(file->getBinaryBuffer(), data, size);
+    return loadImage(*file);
+}
+
+bool LoadedFrame::load(const ofBuffer& file)
+{
+    if (decode(file.getBinaryBuffer(), file.size()))
+    {
+        return true;
+    }
+    fingerprint = getFingerprint(file.getBinaryBuffer(), file.size());
+    return loadImage(file);
+}
+
+bool LoadedFrame::decode(const char *data, size_t size)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    size_t offset = findFrame(bytes, size);
+    unsigned int texture_format;
+    if (offset == 0 ||
+        HapGetFrameTextureFormat(bytes + offset, size - offset, &texture_format) != HapResult_No_Error ||
+        !HapTexture::isSupported(texture_format))
+    {
+        return false;
+    }
+    if (shared_cache_ != NULL && decodeShared(bytes, size, offset, texture_format))
+    {
+        return true;
+    }
+    uint32_t width;
+    uint32_t height;
+    if (!readDimensions(bytes, offset, dimensions_layout.load(), width, height))
+    {
+        return false;
+    }
+    fingerprint = getFingerprint(data, size);
+    /*
+     The frame must decode to exactly the size its dimensions imply, else it is loaded
+     through ofxHapImage, which learns the layout again
+     */
+    size_t decoded_size = HapTexture::getDecodedSize(width, height, texture_format);
+    if (!data_ || data_->size() != long(decoded_size))
+    {
+        data_ = FrameBufferPool::getShared().acquire(decoded_size);
+    }
+    unsigned long used = 0;
+    unsigned int format = 0;
+    unsigned int result = HapDecode(bytes + offset, size - offset,
+                                    HapDecodePool::decode, &HapDecodePool::getShared(),
+                                    data_->getBinaryBuffer(), decoded_size, &used, &format);
+    if (result != HapResult_No_Error || used != decoded_size)
+    {
+        data_.reset();
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    texture_format_ = texture_format;
+    header_size_ = offset;
+    memory_size = decoded_size;
+    return true;
+}
+
+/*
+ Uses the frame from shared memory, or decodes it there, with the layout found before.
+ Returns false if the frame should be decoded privately.
+ */
+bool LoadedFrame::decodeShared(const unsigned char *bytes, size_t size, size_t offset, unsigned int texture_format)
+{
+    uint32_t width;
+    uint32_t height;
+    if (!readDimensions(bytes, offset, dimensions_layout.load(), width, height))
+    {
+        return false;
+    }
+    size_t decoded_size = HapTexture::getDecodedSize(width, height, texture_format);
+    SharedFrameCache::Result result = shared_cache_->acquire(shared_key_, shared_index_, decoded_size, shared_, SharedWaitMicros);
+    bool ok = false;
+    if (result == SharedFrameCache::Hit)
+    {
+        ok = shared_.size == decoded_size;
+        fingerprint = shared_.tag;
+    }
+    else if (result == SharedFrameCache::Reserved)
+    {
+        fingerprint = getFingerprint(bytes, size);
+        unsigned long used = 0;
+        unsigned int format = 0;
+        ok = HapDecode(bytes + offset, size - offset,
+                       HapDecodePool::decode, &HapDecodePool::getShared(),
+                       shared_.data, decoded_size, &used, &format) == HapResult_No_Error && used == decoded_size;
+        if (ok)
+        {
+            shared_.tag = fingerprint;
+            shared_cache_->publish(shared_);
+        }
+    }
+    if (!ok)
+    {
+        if (result != SharedFrameCache::Miss)
+        {
+            shared_cache_->release(shared_);
+        }
+        shared_ = SharedFrameCache::Reference();
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    texture_format_ = texture_format;
+    header_size_ = offset;
+    memory_size = 0;
+    return true;
+}
+
+bool LoadedFrame::loadImage(const ofBuffer& file)
+{
+    image_ = std::shared_ptr<ofxHapImage>(new ofxHapImage());
+    if (!image_->loadImage(file))
+    {
+        image_.reset();
+        return false;
+    }
+    /*
+     ofxHapImage keeps frames decompressed, at half a byte a pixel for Hap and a byte for
+     Hap Alpha and Hap Q
+     */
+    size_t pixels = size_t(image_->getWidth()) * size_t(image_->getHeight());
+    memory_size = image_->getImageType() == ofxHapImage::IMAGE_TYPE_HAP ? pixels / 2 : pixels;
+    learnLayout(file);
+    return true;
+}
+
+/*
+ Finds the width and height ofxHapImage read from file in the file's header, so later files
+ can be decoded here. Nothing is learned if they aren't there.
+ */
+void LoadedFrame::learnLayout(const ofBuffer& file) const
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(file.getBinaryBuffer());
+    size_t offset = findFrame(bytes, file.size());
+    uint32_t image_width = image_->getWidth();
+    uint32_t image_height = image_->getHeight();
+    int candidate_count = int(offset / 4) * 2;
+    for (int layout = 0; layout < candidate_count; layout++)
+    {
+        uint32_t width;
+        uint32_t height;
+        if (readDimensions(bytes, offset, layout, width, height) && width == image_width && height == image_height)
+        {
+            if (dimensions_layout.exchange(layout) != layout)
+            {
+                ofLogNotice("LoadedFrame") << "Found .hpz frame dimensions at header word " << layout / 2 << (layout % 2 ? ", big-endian" : "");
+            }
+            return;
+        }
+    }
+}
+
+bool LoadedFrame::isLoaded() const
+{
+    return isDecoded() || image_;
+}
+
+float LoadedFrame::getWidth() const
+{
+    return image_ ? image_->getWidth() : width_;
+}
+
+float LoadedFrame::getHeight() const
+{
+    return image_ ? image_->getHeight() : height_;
+}
+
+void LoadedFrame::upload(HapTexture& texture) const
+{
+    if (isDecoded())
+    {
+        texture.allocate(width_, height_, texture_format_);
+        texture.upload(getDecodedData(), getDecodedSize());
+    }
+}
+
+ofTexture *LoadedFrame::getTexture(HapTexture& texture)
+{
+    if (image_)
+    {
+        return &image_->getTextureReference();
+    }
+    return isDecoded() ? &texture.getTexture() : NULL;
+}
+
+ofShader *LoadedFrame::getShader(HapTexture& texture)
+{
+    if (image_)
+    {
+        return image_->getImageType() == ofxHapImage::IMAGE_TYPE_HAP_Q ? &image_->getShaderReference() : NULL;
+    }
+    return isDecoded() ? texture.getShader() : NULL;
+}
+
+bool LoadedFrame::isDecoded() const
+{
+    return data_ || shared_.slot >= 0;
+}
+
+const unsigned char *LoadedFrame::getDecodedData() const
+{
+    if (shared_.slot >= 0)
+    {
+        return shared_.data;
+    }
+    return data_ ? reinterpret_cast<const unsigned char *>(data_->getBinaryBuffer()) : NULL;
+}
+
+size_t LoadedFrame::getDecodedSize() const
+{
+    if (shared_.slot >= 0)
+    {
+        return shared_.size;
+    }
+    return data_ ? data_->size() : 0;
+}
+
+unsigned int LoadedFrame::getTextureFormat() const
+{
+    return texture_format_;
+}
+
+size_t LoadedFrame::getHeaderSize() const
+{
+    return header_size_;
+}
@@ -0,0 +1,97 @@
+//
+//  LoadedFrame.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__LoadedFrame__
+#define __MediaPlayer_client__LoadedFrame__
+
+#include "ofMain.h"
+#include <ofxHapImage.h>
+#include "FrameBufferPool.h"
+#include "HapTexture.h"
+#include "SharedFrameCache.h"
+
+/*
+ A frame of an image sequence or playlist, loaded for display.
+
+ The Hap frame in the .hpz file is decoded with HapDecode() into a pooled buffer, its
+ chunks spread over the HapDecodePool, and uploaded to a HapTexture on the render thread.
+ ofxHapImage doesn't expose its file layout. The Hap frame is the section filling the rest
+ of the file, and its width and height are a pair of 32-bit words in the header before it,
+ learned by finding the dimensions ofxHapImage reports for the first file, which it loads.
+ Each frame must then decode to exactly the size its dimensions imply. Files which can't be
+ read so are loaded through ofxHapImage, which checks the layout again.
+
+ With a SharedFrameCache, once the layout is known frames are looked for in shared memory
+ before being decoded, and decoded straight into it otherwise. The frame holds its slot
+ until it is destroyed, so it is uploaded from shared memory without a copy.
+
+ fingerprint is FrameFingerprint's hash of the file, or 0 if fingerprints weren't enabled
+ when it was loaded. memory_size estimates the private memory the frame holds.
+ */
+class LoadedFrame {
+public:
+    LoadedFrame();
+    ~LoadedFrame();
+    /*
+     Shares the decoded frame with other processes through cache, which must outlive the
+     frame, as frame index of the source identified by key. Call before load().
+     */
+    void setSharing(SharedFrameCache *cache, uint64_t key, unsigned int index);
+    /*
+     Loads from the contents of a .hpz file, which needn't outlast the call
+     */
+    bool load(const char *data, size_t size);
+    /*
+     As load(), avoiding a copy if the file has to be loaded through ofxHapImage
+     */
+    bool load(const ofBuffer& file);
+    bool isLoaded() const;
+    float getWidth() const;
+    float getHeight() const;
+    /*
+     Copies the frame to texture. Call on the render thread each time a different frame is
+     to be shown.
+     */
+    void upload(HapTexture& texture) const;
+    /*
+     The texture and shader to draw the frame with, once uploaded to texture
+     */
+    ofTexture *getTexture(HapTexture& texture);
+    ofShader *getShader(HapTexture& texture);
+    /*
+     For frames decoded here rather than by ofxHapImage, the decoded frame, its
+     HapTextureFormat and the length of the .hpz header before the Hap frame
+     */
+    bool isDecoded() const;
+    const unsigned char *getDecodedData() const;
+    size_t getDecodedSize() const;
+    unsigned int getTextureFormat() const;
+    size_t getHeaderSize() const;
+    uint64_t fingerprint;
+    size_t memory_size;
+private:
+    // Not copyable, as a shared frame is released on destruction
+    LoadedFrame(const LoadedFrame& other);
+    LoadedFrame& operator=(const LoadedFrame& other);
+    bool decode(const char *data, size_t size);
+    bool decodeShared(const unsigned char *bytes, size_t size, size_t offset, unsigned int texture_format);
+    bool loadImage(const ofBuffer& file);
+    void learnLayout(const ofBuffer& file) const;
+    FrameBufferPool::Buffer data_;
+    SharedFrameCache *shared_cache_;
+    uint64_t shared_key_;
+    unsigned int shared_index_;
+    // A slot of shared_cache_ held by the frame, if its slot is set
+    SharedFrameCache::Reference shared_;
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int texture_format_;
+    size_t header_size_;
+    // Set only for files loaded through ofxHapImage
+    std::shared_ptr<ofxHapImage> image_;
+};
+
+#endif /* defined(__MediaPlayer_client__LoadedFrame__) */
@@ -0,0 +1,291 @@
+//
+//  MemoryGovernor.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "MemoryGovernor.h"
+#if defined(TARGET_LINUX)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#elif defined(TARGET_WIN32)
+#include <windows.h>
+#endif
+
+/*
+ How often the budget follows available memory, how long a pressure event lowers it, and
+ the most evictions made in one update so a large overshoot is spread over several frames
+ */
+static const uint64_t RefreshInterval = 1000000;
+static const uint64_t PressureDuration = 5000000;
+static const unsigned int MaximumEvictions = 64;
+/*
+ A pressure event is a total of 150ms spent stalled on memory in a two second window; two
+ seconds is the shortest window unprivileged processes may watch. Where triggers aren't
+ available the ten second average is polled instead.
+ */
+static const char *PressureTrigger = "some 150000 2000000";
+static const float PressureAverageThreshold = 10.0;
+
+MemoryGovernor::MemoryGovernor()
+: fixed_budget_(0), available_fraction_(0.0), budget_(0), last_refresh_(0), watch_pressure_(false),
+pressure_fd_(-1), pressure_until_(0), pressure_budget_(0), evictions_(0), pressure_events_(0)
+{
+
+}
+
+MemoryGovernor::~MemoryGovernor()
+{
+    close();
+}
+
+void MemoryGovernor::setup(uint64_t budget, float available_fraction, bool watch_pressure)
+{
+    close();
+    fixed_budget_ = budget;
+    available_fraction_ = ofClamp(available_fraction, 0.0, 1.0);
+    watch_pressure_ = watch_pressure;
+    last_refresh_ = 0;
+#if defined(TARGET_LINUX)
+    if (watch_pressure_)
+    {
+        pressure_fd_ = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK);
+        if (pressure_fd_ >= 0 && write(pressure_fd_, PressureTrigger, strlen(PressureTrigger) + 1) < 0)
+        {
+            ::close(pressure_fd_);
+            pressure_fd_ = -1;
+        }
+    }
+#endif
+    refreshBudget(getTotalUsage());
+}
+
+void MemoryGovernor::close()
+{
+#if defined(TARGET_LINUX)
+    if (pressure_fd_ >= 0)
+    {
+        ::close(pressure_fd_);
+        pressure_fd_ = -1;
+    }
+#endif
+}
+
+void MemoryGovernor::add(const std::string& name, MemoryConsumer *consumer)
+{
+    Registration registration;
+    registration.name = name;
+    registration.consumer = consumer;
+    consumers_.push_back(registration);
+}
+
+void MemoryGovernor::remove(MemoryConsumer *consumer)
+{
+    for (std::vector<Registration>::iterator it = consumers_.begin(); it != consumers_.end(); ++it) {
+        if (it->consumer == consumer)
+        {
+            consumers_.erase(it);
+            return;
+        }
+    }
+}
+
+void MemoryGovernor::update(uint64_t now_micros)
+{
+    uint64_t usage = getTotalUsage();
+    bool refresh = now_micros - last_refresh_ >= RefreshInterval;
+    if (refresh)
+    {
+        refreshBudget(usage);
+        last_refresh_ = now_micros;
+    }
+    if ((pressure_fd_ >= 0 || refresh) && checkPressure())
+    {
+        /*
+         Pressure which persists extends the lowered budget rather than lowering it again
+         */
+        if (now_micros >= pressure_until_)
+        {
+            pressure_events_++;
+            pressure_budget_ = usage - usage / 4;
+        }
+        pressure_until_ = now_micros + PressureDuration;
+    }
+    uint64_t budget = budget_;
+    bool pressure = now_micros < pressure_until_;
+    if (pressure && (budget == 0 || pressure_budget_ < budget))
+    {
+        budget = pressure_budget_;
+    }
+    if (budget == 0 && !pressure)
+    {
+        return;
+    }
+
+    unsigned int evictions = 0;
+    while (usage > budget && evictions < MaximumEvictions)
+    {
+        MemoryConsumer *lowest = NULL;
+        uint64_t lowest_bytes = 0;
+        double lowest_value = 0.0;
+        for (std::vector<Registration>::const_iterator it = consumers_.begin(); it != consumers_.end(); ++it) {
+            uint64_t bytes;
+            double value;
+            if (it->consumer->getEvictionCandidate(bytes, value) && (lowest == NULL || value < lowest_value))
+            {
+                lowest = it->consumer;
+                lowest_bytes = bytes;
+                lowest_value = value;
+            }
+        }
+        if (lowest == NULL)
+        {
+            break;
+        }
+        lowest->evictCandidate();
+        usage -= std::min(usage, lowest_bytes);
+        evictions++;
+    }
+    evictions_ += evictions;
+
+    /*
+     Let consumers grow back a step a second while comfortably within budget
+     */
+    if (refresh && !pressure && evictions == 0 && usage < budget - budget / 10)
+    {
+        for (std::vector<Registration>::const_iterator it = consumers_.begin(); it != consumers_.end(); ++it) {
+            it->consumer->relax();
+        }
+    }
+}
+
+uint64_t MemoryGovernor::getBudget() const
+{
+    return budget_;
+}
+
+std::vector<MemoryGovernor::Usage> MemoryGovernor::getUsage() const
+{
+    std::vector<Usage> usage;
+    for (std::vector<Registration>::const_iterator it = consumers_.begin(); it != consumers_.end(); ++it) {
+        Usage consumer_usage;
+        consumer_usage.name = it->name;
+        consumer_usage.bytes = it->consumer->getMemoryUsage();
+        usage.push_back(consumer_usage);
+    }
+    return usage;
+}
+
+unsigned long MemoryGovernor::getEvictionCount() const
+{
+    return evictions_;
+}
+
+unsigned long MemoryGovernor::getPressureCount() const
+{
+    return pressure_events_;
+}
+
+uint64_t MemoryGovernor::getTotalUsage() const
+{
+    uint64_t usage = 0;
+    for (std::vector<Registration>::const_iterator it = consumers_.begin(); it != consumers_.end(); ++it) {
+        usage += it->consumer->getMemoryUsage();
+    }
+    return usage;
+}
+
+void MemoryGovernor::refreshBudget(uint64_t usage)
+{
+    uint64_t available;
+    if (fixed_budget_ > 0)
+    {
+        budget_ = fixed_budget_;
+    }
+    else if (available_fraction_ > 0.0 && readAvailableMemory(available))
+    {
+        /*
+         Memory we already hold isn't counted as available, but is ours to keep
+         */
+        budget_ = std::max(uint64_t((available + usage) * double(available_fraction_)), uint64_t(1));
+    }
+    else
+    {
+        budget_ = 0;
+    }
+}
+
+bool MemoryGovernor::checkPressure()
+{
+    if (!watch_pressure_)
+    {
+        return false;
+    }
+#if defined(TARGET_LINUX)
+    if (pressure_fd_ >= 0)
+    {
+        struct pollfd descriptor;
+        descriptor.fd = pressure_fd_;
+        descriptor.events = POLLPRI;
+        descriptor.revents = 0;
+        if (poll(&descriptor, 1, 0) <= 0)
+        {
+            return false;
+        }
+        if (descriptor.revents & POLLERR)
+        {
+            ::close(pressure_fd_);
+            pressure_fd_ = -1;
+            return false;
+        }
+        return (descriptor.revents & POLLPRI) != 0;
+    }
+    FILE *file = fopen("/proc/pressure/memory", "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+    float average = 0.0;
+    bool found = fscanf(file, "some avg10=%f", &average) == 1;
+    fclose(file);
+    return found && average >= PressureAverageThreshold;
+#else
+    return false;
+#endif
+}
+
+bool MemoryGovernor::readAvailableMemory(uint64_t& bytes)
+{
+#if defined(TARGET_LINUX)
+    FILE *file = fopen("/proc/meminfo", "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+    char line[256];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned long long kilobytes;
+        if (sscanf(line, "MemAvailable: %llu kB", &kilobytes) == 1)
+        {
+            bytes = kilobytes * 1024;
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+#elif defined(TARGET_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status))
+    {
+        return false;
+    }
+    bytes = status.ullAvailPhys;
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,100 @@
+//
+//  MemoryGovernor.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__MemoryGovernor__
+#define __MediaPlayer_client__MemoryGovernor__
+
+#include "ofMain.h"
+
+/*
+ Something holding memory a MemoryGovernor may reclaim, such as a cache of frames.
+ Every method is called on the thread calling MemoryGovernor::update().
+ */
+class MemoryConsumer {
+public:
+    virtual ~MemoryConsumer() {}
+    virtual uint64_t getMemoryUsage() const = 0;
+    /*
+     Describes the item which is least worth keeping: the bytes evicting it would free, and
+     its value, the microseconds it would take to recreate divided by one more than its
+     distance in frames from the current frame. Returns false if nothing can be evicted.
+     */
+    virtual bool getEvictionCandidate(uint64_t& bytes, double& value) const = 0;
+    /*
+     Evicts the item getEvictionCandidate() last described, and holds back from replacing it
+     until relax() is called
+     */
+    virtual void evictCandidate() = 0;
+    /*
+     Called when there is memory to spare, so a consumer which was made to shrink may grow
+     a step towards its configured size
+     */
+    virtual void relax() {}
+};
+
+/*
+ Keeps the memory held by every registered consumer within one budget.
+
+ The budget is either fixed, or a fraction of the memory the system reports available plus
+ what the consumers already hold. While over budget, the item of lowest value across all
+ consumers is evicted, so free buffers go first, then frames which are cheap to reload or
+ far from the current frame. On Linux, memory pressure reported by the kernel (PSI) lowers
+ the budget to three quarters of the usage at the time, until it has eased for a few seconds.
+ */
+class MemoryGovernor {
+public:
+    struct Usage {
+        std::string name;
+        uint64_t bytes;
+    };
+    MemoryGovernor();
+    ~MemoryGovernor();
+    /*
+     budget in bytes, or 0 to use available_fraction of available memory. With neither, or
+     where available memory can't be read, there is no limit.
+     */
+    void setup(uint64_t budget, float available_fraction, bool watch_pressure);
+    void close();
+    /*
+     consumer must outlive the governor or be removed
+     */
+    void add(const std::string& name, MemoryConsumer *consumer);
+    void remove(MemoryConsumer *consumer);
+    /*
+     Evicts as needed. Call once a frame.
+     */
+    void update(uint64_t now_micros);
+    /*
+     0 if there is no limit
+     */
+    uint64_t getBudget() const;
+    std::vector<Usage> getUsage() const;
+    unsigned long getEvictionCount() const;
+    unsigned long getPressureCount() const;
+private:
+    struct Registration {
+        std::string name;
+        MemoryConsumer *consumer;
+    };
+    uint64_t getTotalUsage() const;
+    void refreshBudget(uint64_t usage);
+    bool checkPressure();
+    static bool readAvailableMemory(uint64_t& bytes);
+
+    std::vector<Registration> consumers_;
+    uint64_t fixed_budget_;
+    float available_fraction_;
+    uint64_t budget_;
+    uint64_t last_refresh_;
+    bool watch_pressure_;
+    int pressure_fd_;
+    uint64_t pressure_until_;
+    uint64_t pressure_budget_;
+    unsigned long evictions_;
+    unsigned long pressure_events_;
+};
+
+#endif /* defined(__MediaPlayer_client__MemoryGovernor__) */
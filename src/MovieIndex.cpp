@@ -0,0 +1,416 @@
+//
+//  MovieIndex.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "MovieIndex.h"
+#if defined(TARGET_WIN32)
+#define fseeko _fseeki64
+#endif
+
+static uint32_t readBig32(const unsigned char *bytes)
+{
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+static uint64_t readBig64(const unsigned char *bytes)
+{
+    return (uint64_t(readBig32(bytes)) << 32) | readBig32(bytes + 4);
+}
+
+/*
+ Finds the first atom of the given type between start and end, setting its payload
+ */
+static bool findAtom(const unsigned char *start, const unsigned char *end, const char *type, const unsigned char *&payload, const unsigned char *&payload_end)
+{
+    while (end - start >= 8)
+    {
+        uint64_t size = readBig32(start);
+        size_t header = 8;
+        if (size == 1 && end - start >= 16)
+        {
+            size = readBig64(start + 8);
+            header = 16;
+        }
+        else if (size == 0)
+        {
+            size = end - start;
+        }
+        if (size < header || size > uint64_t(end - start))
+        {
+            return false;
+        }
+        if (memcmp(start + 4, type, 4) == 0)
+        {
+            payload = start + header;
+            payload_end = start + size;
+            return true;
+        }
+        start += size;
+    }
+    return false;
+}
+
+static bool findPath(const unsigned char *start, const unsigned char *end, const char *path, const unsigned char *&payload, const unsigned char *&payload_end)
+{
+    /*
+     path is a sequence of four character types, eg "mdiaminfstbl"
+     */
+    for (; *path; path += 4)
+    {
+        if (!findAtom(start, end, path, payload, payload_end))
+        {
+            return false;
+        }
+        start = payload;
+        end = payload_end;
+    }
+    return true;
+}
+
+MovieIndex::MovieIndex()
+: width_(0), height_(0)
+{
+
+}
+
+void MovieIndex::clear()
+{
+    codec_.clear();
+    width_ = height_ = 0;
+    samples_.clear();
+}
+
+void MovieIndex::swap(MovieIndex& other)
+{
+    codec_.swap(other.codec_);
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    samples_.swap(other.samples_);
+}
+
+bool MovieIndex::load(const std::string& path)
+{
+    clear();
+    FILE *file = fopen(ofToDataPath(path, true).c_str(), "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    /*
+     Walk the top-level atoms to find moov, which may follow the media data
+     */
+    std::vector<unsigned char> moov;
+    unsigned char header[16];
+    while (fread(header, 1, 8, file) == 8)
+    {
+        uint64_t size = readBig32(header);
+        uint64_t header_size = 8;
+        if (size == 1)
+        {
+            if (fread(header + 8, 1, 8, file) != 8)
+            {
+                break;
+            }
+            size = readBig64(header + 8);
+            header_size = 16;
+        }
+        if (size != 0 && size < header_size)
+        {
+            break;
+        }
+        if (memcmp(header + 4, "moov", 4) == 0)
+        {
+            if (size == 0 || size - header_size > 256 * 1024 * 1024)
+            {
+                break;
+            }
+            moov.resize(size - header_size);
+            if (moov.empty() || fread(&moov[0], 1, moov.size(), file) != moov.size())
+            {
+                moov.clear();
+            }
+            break;
+        }
+        if (size == 0 || fseeko(file, size - header_size, SEEK_CUR) != 0)
+        {
+            break;
+        }
+    }
+    fclose(file);
+    if (moov.empty())
+    {
+        return false;
+    }
+
+    const unsigned char *start = &moov[0];
+    const unsigned char *end = start + moov.size();
+    /*
+     mvhd: version/flags, creation and modification times (64 bit for version 1), timescale
+     */
+    const unsigned char *mvhd;
+    const unsigned char *mvhd_end;
+    if (!findAtom(start, end, "mvhd", mvhd, mvhd_end) || mvhd_end - mvhd < 24)
+    {
+        return false;
+    }
+    uint32_t movie_timescale = readBig32(mvhd + (mvhd[0] == 1 ? 20 : 12));
+    const unsigned char *trak;
+    const unsigned char *trak_end;
+    while (findAtom(start, end, "trak", trak, trak_end))
+    {
+        if (parseTrack(trak, trak_end, movie_timescale))
+        {
+            return true;
+        }
+        start = trak_end;
+    }
+    clear();
+    return false;
+}
+
+bool MovieIndex::parseTrack(const unsigned char *start, const unsigned char *end, uint32_t movie_timescale)
+{
+    const unsigned char *atom;
+    const unsigned char *atom_end;
+    /*
+     hdlr: version/flags, component type, component subtype
+     */
+    if (!findPath(start, end, "mdiahdlr", atom, atom_end) || atom_end - atom < 12 || memcmp(atom + 8, "vide", 4) != 0)
+    {
+        return false;
+    }
+    const unsigned char *stbl;
+    const unsigned char *stbl_end;
+    if (!findPath(start, end, "mdiaminfstbl", stbl, stbl_end))
+    {
+        return false;
+    }
+
+    /*
+     stsd: version/flags, entry count, then the first entry's size, format, six reserved
+     bytes, data reference index, and for video version, revision, vendor, temporal and
+     spatial quality, width and height
+     */
+    if (!findAtom(stbl, stbl_end, "stsd", atom, atom_end) || atom_end - atom < 8 + 36)
+    {
+        return false;
+    }
+    codec_.assign(reinterpret_cast<const char *>(atom + 12), 4);
+    width_ = (atom[8 + 32] << 8) | atom[8 + 33];
+    height_ = (atom[8 + 34] << 8) | atom[8 + 35];
+
+    /*
+     stsz: version/flags, uniform sample size (or 0), sample count, then sizes if not uniform
+     */
+    if (!findAtom(stbl, stbl_end, "stsz", atom, atom_end) || atom_end - atom < 12)
+    {
+        return false;
+    }
+    uint32_t uniform_size = readBig32(atom + 4);
+    uint32_t sample_count = readBig32(atom + 8);
+    if (uniform_size == 0 && uint64_t(atom_end - atom - 12) < uint64_t(sample_count) * 4)
+    {
+        return false;
+    }
+    samples_.resize(sample_count);
+    for (uint32_t i = 0; i < sample_count; i++)
+    {
+        samples_[i].size = uniform_size ? uniform_size : readBig32(atom + 12 + (i * 4));
+    }
+
+    /*
+     stco or co64: version/flags, chunk count, then offsets
+     */
+    std::vector<uint64_t> chunk_offsets;
+    if (findAtom(stbl, stbl_end, "stco", atom, atom_end) && atom_end - atom >= 8)
+    {
+        uint32_t count = readBig32(atom + 4);
+        for (uint32_t i = 0; i < count && atom + 8 + (i * 4) + 4 <= atom_end; i++)
+        {
+            chunk_offsets.push_back(readBig32(atom + 8 + (i * 4)));
+        }
+    }
+    else if (findAtom(stbl, stbl_end, "co64", atom, atom_end) && atom_end - atom >= 8)
+    {
+        uint32_t count = readBig32(atom + 4);
+        for (uint32_t i = 0; i < count && atom + 8 + (i * 8) + 8 <= atom_end; i++)
+        {
+            chunk_offsets.push_back(readBig64(atom + 8 + (i * 8)));
+        }
+    }
+
+    /*
+     stsc: version/flags, entry count, then runs of first chunk (from 1), samples per chunk
+     and sample description index
+     */
+    if (!findAtom(stbl, stbl_end, "stsc", atom, atom_end) || atom_end - atom < 8)
+    {
+        return false;
+    }
+    uint32_t run_count = readBig32(atom + 4);
+    if (uint64_t(atom_end - atom - 8) < uint64_t(run_count) * 12)
+    {
+        return false;
+    }
+    uint32_t sample = 0;
+    for (uint32_t run = 0; run < run_count && sample < sample_count; run++)
+    {
+        const unsigned char *entry = atom + 8 + (run * 12);
+        uint32_t first_chunk = readBig32(entry);
+        uint32_t samples_per_chunk = readBig32(entry + 4);
+        uint32_t last_chunk = run + 1 < run_count ? readBig32(entry + 12) : chunk_offsets.size() + 1;
+        if (first_chunk == 0)
+        {
+            return false;
+        }
+        for (uint32_t chunk = first_chunk; chunk < last_chunk && chunk <= chunk_offsets.size(); chunk++)
+        {
+            uint64_t offset = chunk_offsets[chunk - 1];
+            for (uint32_t i = 0; i < samples_per_chunk && sample < sample_count; i++, sample++)
+            {
+                samples_[sample].offset = offset;
+                offset += samples_[sample].size;
+            }
+        }
+    }
+    if (sample != sample_count)
+    {
+        ofLogWarning("MovieIndex") << "Sample tables locate " << sample << " of " << sample_count << " samples";
+        samples_.resize(sample);
+    }
+
+    /*
+     stts: version/flags, entry count, then runs of sample count and sample duration. Frame
+     numbers are sample numbers only if every sample lasts as long.
+     */
+    if (!findAtom(stbl, stbl_end, "stts", atom, atom_end) || atom_end - atom < 8)
+    {
+        return false;
+    }
+    uint32_t duration_count = readBig32(atom + 4);
+    if (uint64_t(atom_end - atom - 8) < uint64_t(duration_count) * 8)
+    {
+        return false;
+    }
+    uint32_t sample_duration = 0;
+    for (uint32_t i = 0; i < duration_count; i++)
+    {
+        uint32_t count = readBig32(atom + 8 + (i * 8));
+        uint32_t duration = readBig32(atom + 12 + (i * 8));
+        if (count == 0)
+        {
+            continue;
+        }
+        if (sample_duration != 0 && duration != sample_duration)
+        {
+            ofLogNotice("MovieIndex") << "Samples have different durations, so can't be indexed by frame";
+            samples_.clear();
+            return false;
+        }
+        sample_duration = duration;
+    }
+    if (sample_duration == 0)
+    {
+        return false;
+    }
+
+    /*
+     mdhd: version/flags, creation and modification times (64 bit for version 1), timescale
+     */
+    if (!findPath(start, end, "mdiamdhd", atom, atom_end) || atom_end - atom < 24)
+    {
+        return false;
+    }
+    uint32_t media_timescale = readBig32(atom + (atom[0] == 1 ? 20 : 12));
+
+    const unsigned char *elst;
+    const unsigned char *elst_end;
+    if (findPath(start, end, "edtselst", elst, elst_end) && !applyEdits(elst, elst_end, movie_timescale, media_timescale, sample_duration))
+    {
+        samples_.clear();
+        return false;
+    }
+    return !samples_.empty();
+}
+
+bool MovieIndex::applyEdits(const unsigned char *start, const unsigned char *end, uint32_t movie_timescale, uint32_t media_timescale, uint32_t sample_duration)
+{
+    /*
+     elst: version/flags, entry count, then entries of segment duration (in the movie's
+     timescale), media time (in the media's, -1 for an empty edit) and a 16.16 rate. Times
+     are 64 bit for version 1.
+     */
+    if (end - start < 8)
+    {
+        return false;
+    }
+    bool wide = start[0] == 1;
+    uint32_t entry_count = readBig32(start + 4);
+    size_t entry_size = wide ? 20 : 12;
+    if (uint64_t(end - start - 8) < uint64_t(entry_count) * entry_size)
+    {
+        return false;
+    }
+    if (entry_count == 0)
+    {
+        return true;
+    }
+    if (entry_count > 1)
+    {
+        ofLogNotice("MovieIndex") << "The edit list has " << entry_count << " edits, so can't be indexed by frame";
+        return false;
+    }
+    const unsigned char *entry = start + 8;
+    uint64_t segment_duration = wide ? readBig64(entry) : readBig32(entry);
+    int64_t media_time = wide ? int64_t(readBig64(entry + 8)) : int64_t(int32_t(readBig32(entry + 4)));
+    uint32_t rate = readBig32(entry + (wide ? 16 : 8));
+    if (media_time < 0 || rate != 0x00010000 || media_time % sample_duration != 0 || movie_timescale == 0)
+    {
+        ofLogNotice("MovieIndex") << "The edit list doesn't present whole samples at normal rate, so can't be indexed by frame";
+        return false;
+    }
+    /*
+     The edit presents from media_time for segment_duration, or to the end if that is 0
+     */
+    uint64_t first = media_time / sample_duration;
+    if (first >= samples_.size())
+    {
+        return false;
+    }
+    uint64_t count = samples_.size() - first;
+    if (segment_duration != 0)
+    {
+        double media_duration = double(segment_duration) * media_timescale / movie_timescale;
+        count = std::min(count, uint64_t(floor((media_duration / sample_duration) + 0.5)));
+    }
+    samples_.erase(samples_.begin() + (first + count), samples_.end());
+    samples_.erase(samples_.begin(), samples_.begin() + first);
+    return true;
+}
+
+const std::string& MovieIndex::getCodec() const
+{
+    return codec_;
+}
+
+unsigned int MovieIndex::getWidth() const
+{
+    return width_;
+}
+
+unsigned int MovieIndex::getHeight() const
+{
+    return height_;
+}
+
+unsigned int MovieIndex::size() const
+{
+    return samples_.size();
+}
+
+const MovieIndex::Sample& MovieIndex::getSample(unsigned int index) const
+{
+    return samples_[index];
+}
@@ -0,0 +1,48 @@
+//
+//  MovieIndex.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__MovieIndex__
+#define __MediaPlayer_client__MovieIndex__
+
+#include "ofMain.h"
+
+/*
+ The location of every sample of the first video track of a QuickTime or MP4 file, read
+ from its sample tables so any frame can be read without going through a demuxer.
+
+ Frames are the samples an edit list presents, so a single edit starting part way into
+ the media is honoured. Tracks whose samples have different durations, or whose edit list
+ does more than present one span of the media at normal rate, can't be indexed by frame
+ number, so fail to load and are left to a demuxer.
+ */
+class MovieIndex {
+public:
+    struct Sample {
+        uint64_t offset;
+        uint32_t size;
+    };
+    MovieIndex();
+    bool load(const std::string& path);
+    void clear();
+    void swap(MovieIndex& other);
+    /*
+     The sample description's four character code, eg "Hap1"
+     */
+    const std::string& getCodec() const;
+    unsigned int getWidth() const;
+    unsigned int getHeight() const;
+    unsigned int size() const;
+    const Sample& getSample(unsigned int index) const;
+private:
+    bool parseTrack(const unsigned char *start, const unsigned char *end, uint32_t movie_timescale);
+    bool applyEdits(const unsigned char *start, const unsigned char *end, uint32_t movie_timescale, uint32_t media_timescale, uint32_t sample_duration);
+    std::string codec_;
+    unsigned int width_;
+    unsigned int height_;
+    std::vector<Sample> samples_;
+};
+
+#endif /* defined(__MediaPlayer_client__MovieIndex__) */
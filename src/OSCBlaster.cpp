@@ -0,0 +1,131 @@
+//
+//  OSCBlaster.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "OSCBlaster.h"
+#include "OSCRouter.h"
+
+OSCBlaster::Settings::Settings()
+: outputs(12), message_rate(100000), burst(1000), duration(10)
+{
+
+}
+
+bool OSCBlaster::parseArguments(int argc, char *argv[], Settings& settings)
+{
+    bool found = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--blast" && i + 1 < argc)
+        {
+            settings.destination = argv[++i];
+            found = true;
+            continue;
+        }
+        std::string::size_type equals = argument.find('=');
+        if (!found || equals == std::string::npos)
+        {
+            continue;
+        }
+        std::string key = argument.substr(0, equals);
+        std::string value = argument.substr(equals + 1);
+        if (key == "client")
+        {
+            settings.client_id = value;
+        }
+        else if (key == "outputs")
+        {
+            settings.outputs = std::max(ofToInt(value), 1);
+        }
+        else if (key == "rate")
+        {
+            settings.message_rate = std::max(ofToFloat(value), 1.0f);
+        }
+        else if (key == "burst")
+        {
+            settings.burst = std::max(ofToInt(value), 1);
+        }
+        else if (key == "duration")
+        {
+            settings.duration = std::max(ofToFloat(value), 0.0f);
+        }
+        else
+        {
+            ofLogWarning("OSCBlaster") << "Ignoring unknown argument " << argument;
+        }
+    }
+    return found;
+}
+
+OSCBlaster::OSCBlaster(const Settings& settings)
+: settings_(settings)
+{
+
+}
+
+bool OSCBlaster::run()
+{
+    std::vector<std::string> parts = ofSplitString(settings_.destination, ":");
+    if (parts.size() != 2)
+    {
+        ofLogError("OSCBlaster") << "Destination must be host:port, not " << settings_.destination;
+        return false;
+    }
+    ofxOscSender sender;
+    try {
+        sender.setup(parts[0], ofToInt(parts[1]));
+    } catch (std::exception& e) {
+        ofLogError("OSCBlaster") << "Unable to send to " << settings_.destination << ": " << e.what();
+        return false;
+    }
+
+    /*
+     Prepare one burst of messages, cycling through every output and every crop, warp and
+     blend address as Benchmark does
+     */
+    std::string prefix = settings_.client_id.empty() ? std::string() : "/client/" + settings_.client_id;
+    const int first_leaf = OSCRouter::LeafCropX;
+    const int leaf_count = OSCRouter::LeafBlendBottom - first_leaf + 1;
+    std::vector<ofxOscMessage> messages(settings_.burst);
+    for (unsigned int i = 0; i < settings_.burst; i++)
+    {
+        OSCRouter::Leaf leaf = OSCRouter::Leaf(first_leaf + ((i / settings_.outputs) % leaf_count));
+        std::string output = settings_.client_id.empty() ? std::string() : "/output/" + ofToString(i % settings_.outputs + 1);
+        messages[i].setAddress(prefix + output + OSCRouter::getLeafAddress(leaf));
+        messages[i].addFloatArg(10.0 + (10.0 * sin(i * 0.01)));
+    }
+
+    uint64_t start = ofGetElapsedTimeMicros();
+    uint64_t end = start + uint64_t(settings_.duration * 1000000.0);
+    uint64_t burst_interval = uint64_t(settings_.burst * 1000000.0 / settings_.message_rate);
+    uint64_t next_burst = start;
+    unsigned long sent = 0;
+    unsigned long bursts = 0;
+    unsigned long late = 0;
+    while (next_burst < end)
+    {
+        uint64_t now = ofGetElapsedTimeMicros();
+        if (now < next_burst)
+        {
+            ofSleepMillis(std::max(int((next_burst - now) / 1000), 1));
+            continue;
+        }
+        for (std::vector<ofxOscMessage>::iterator it = messages.begin(); it != messages.end(); ++it) {
+            sender.sendMessage(*it);
+        }
+        sent += messages.size();
+        bursts++;
+        next_burst += burst_interval;
+        if (ofGetElapsedTimeMicros() > next_burst)
+        {
+            late++;
+        }
+    }
+    double elapsed = (ofGetElapsedTimeMicros() - start) / 1000000.0;
+    ofLogNotice("OSCBlaster") << "Sent " << sent << " messages in " << bursts << " bursts over " << elapsed << " seconds (" <<
+        (elapsed > 0.0 ? sent / elapsed : 0.0) << " per second)" << (late > 0 ? ", " + ofToString(late) + " bursts couldn't be sent in time" : "");
+    return true;
+}
@@ -0,0 +1,50 @@
+//
+//  OSCBlaster.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__OSCBlaster__
+#define __MediaPlayer_client__OSCBlaster__
+
+#include "ofMain.h"
+#include <ofxOsc.h>
+
+/*
+ Sends bursts of crop, warp and blend messages to a client as fast as a controller sending
+ its full state would, to test that the client keeps up. Compare the number sent with the
+ packets and drops shown in the client's stats display.
+
+ Run as
+
+    MediaPlayer_client --blast <host:port> [client=<id>] [outputs=12] [rate=100000]
+        [burst=1000] [duration=10]
+
+ rate messages per second are sent in bursts of burst messages. Messages are addressed to
+ every client unless client is given.
+ */
+class OSCBlaster {
+public:
+    struct Settings {
+        Settings();
+        std::string destination;
+        std::string client_id;
+        unsigned int outputs;
+        float message_rate;
+        unsigned int burst;
+        float duration;
+    };
+    /*
+     Returns true if the arguments request blasting, filling settings from them
+     */
+    static bool parseArguments(int argc, char *argv[], Settings& settings);
+    OSCBlaster(const Settings& settings);
+    /*
+     Blocks until duration has passed. Returns false if the destination is invalid.
+     */
+    bool run();
+private:
+    Settings settings_;
+};
+
+#endif /* defined(__MediaPlayer_client__OSCBlaster__) */
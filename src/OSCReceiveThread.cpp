@@ -0,0 +1,742 @@
+//
+//  OSCReceiveThread.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "OSCReceiveThread.h"
+#include "Tracer.h"
+#if defined(TARGET_LINUX)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/*
+ Datagrams read per recvmmsg() call, and the largest we accept, which is larger than
+ oscpack's receive buffer
+ */
+static const int BatchSize = 64;
+static const int DatagramSize = 8192;
+#endif
+
+OSCReceiveThread::OSCReceiveThread(unsigned int capacity)
+:
+#if defined(TARGET_LINUX)
+socket_fd_(-1),
+#endif
+receive_buffer_size_(0), reuse_port_(false), kernel_dropped_(0), datagrams_(0), receive_calls_(0),
+recorder_(NULL), arrival_(0), time_tag_(0), write_index_(0), read_index_(0), dropped_(0),
+address_slots_(AddressSlotCount), address_keys_(AddressSlotCount), address_slots_used_(0), barriers_(0), coalesced_(0)
+{
+#if defined(TARGET_LINUX)
+    wake_fds_[0] = wake_fds_[1] = -1;
+#endif
+    /*
+     Round up to a power of two so indices can wrap with a mask
+     */
+    unsigned int size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    ring_.resize(size);
+    mask_ = size - 1;
+}
+
+OSCReceiveThread::~OSCReceiveThread()
+{
+    close();
+}
+
+void OSCReceiveThread::setRecorder(OSCRecorder *recorder)
+{
+    recorder_ = recorder;
+}
+
+void OSCReceiveThread::setSocketOptions(int receive_buffer_size, bool reuse_port, const std::string& multicast_group)
+{
+    receive_buffer_size_ = receive_buffer_size;
+    reuse_port_ = reuse_port;
+    multicast_group_ = multicast_group;
+}
+
+void OSCReceiveThread::setClientID(const std::string& client_id)
+{
+    router_.setClientID(client_id);
+}
+
+void OSCReceiveThread::setup(int port)
+{
+    close();
+#if defined(TARGET_LINUX)
+    if (openSocket(port))
+    {
+        startThread();
+    }
+#else
+    try {
+        socket_ = std::shared_ptr<UdpListeningReceiveSocket>(new UdpListeningReceiveSocket(IpEndpointName(IpEndpointName::ANY_ADDRESS, port), this));
+    } catch (std::exception& e) {
+        ofLogError("OSCReceiveThread") << "Unable to listen on port " << port << ": " << e.what();
+        return;
+    }
+    startThread();
+#endif
+}
+
+void OSCReceiveThread::close()
+{
+#if defined(TARGET_LINUX)
+    if (socket_fd_ != -1)
+    {
+        char wake = 0;
+        if (write(wake_fds_[1], &wake, 1) != 1)
+        {
+            ofLogError("OSCReceiveThread") << "Unable to stop receiving";
+        }
+        waitForThread(true);
+        ::close(socket_fd_);
+        ::close(wake_fds_[0]);
+        ::close(wake_fds_[1]);
+        socket_fd_ = wake_fds_[0] = wake_fds_[1] = -1;
+    }
+#endif
+    if (socket_)
+    {
+        socket_->AsynchronousBreak();
+        waitForThread(true);
+        socket_.reset();
+    }
+}
+
+void OSCReceiveThread::threadedFunction()
+{
+    Tracer::getShared().setThreadName("osc_receive");
+#if defined(TARGET_LINUX)
+    receiveBatches();
+#else
+    socket_->Run();
+#endif
+}
+
+#if defined(TARGET_LINUX)
+bool OSCReceiveThread::openSocket(int port)
+{
+    socket_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (socket_fd_ == -1 || pipe2(wake_fds_, O_CLOEXEC) != 0)
+    {
+        ofLogError("OSCReceiveThread") << "Unable to create socket: " << strerror(errno);
+        close();
+        return false;
+    }
+    int on = 1;
+    /*
+     Only share the address when asked to, or when joining a group other processes on this
+     host may also join; otherwise a second client on the port fails rather than silently
+     taking some of the first one's packets
+     */
+    if (reuse_port_ || !multicast_group_.empty())
+    {
+        setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (reuse_port_ && setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0)
+    {
+        ofLogWarning("OSCReceiveThread") << "Unable to share port " << port << ": " << strerror(errno);
+    }
+    /*
+     Have each datagram carry the kernel's count of datagrams dropped for this socket
+     */
+    setsockopt(socket_fd_, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+    if (receive_buffer_size_ > 0)
+    {
+        /*
+         SO_RCVBUF is capped by net.core.rmem_max, which SO_RCVBUFFORCE ignores if we're privileged
+         */
+        if (setsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUFFORCE, &receive_buffer_size_, sizeof(receive_buffer_size_)) != 0)
+        {
+            setsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size_, sizeof(receive_buffer_size_));
+        }
+        int actual = 0;
+        socklen_t length = sizeof(actual);
+        getsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUF, &actual, &length);
+        // The kernel reports double the size it was given, to allow for its bookkeeping
+        if (actual / 2 < receive_buffer_size_)
+        {
+            ofLogWarning("OSCReceiveThread") << "Receive buffer limited to " << actual / 2 << " bytes, raise net.core.rmem_max to allow " << receive_buffer_size_;
+        }
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket_fd_, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        ofLogError("OSCReceiveThread") << "Unable to listen on port " << port << ": " << strerror(errno);
+        close();
+        return false;
+    }
+    if (!multicast_group_.empty())
+    {
+        struct ip_mreq request;
+        request.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (inet_pton(AF_INET, multicast_group_.c_str(), &request.imr_multiaddr) != 1 ||
+            setsockopt(socket_fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) != 0)
+        {
+            ofLogError("OSCReceiveThread") << "Unable to join multicast group " << multicast_group_;
+        }
+    }
+    return true;
+}
+
+void OSCReceiveThread::receiveBatches()
+{
+    std::vector<char> buffers(BatchSize * DatagramSize);
+    std::vector<char> controls(BatchSize * CMSG_SPACE(sizeof(uint32_t)));
+    struct mmsghdr headers[BatchSize];
+    struct iovec vectors[BatchSize];
+    struct sockaddr_in addresses[BatchSize];
+    struct pollfd descriptors[2];
+    descriptors[0].fd = socket_fd_;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = wake_fds_[0];
+    descriptors[1].events = POLLIN;
+    for (;;)
+    {
+        if (poll(descriptors, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ofLogError("OSCReceiveThread") << "Unable to wait for packets: " << strerror(errno);
+            break;
+        }
+        if (descriptors[1].revents != 0)
+        {
+            break;
+        }
+        /*
+         Read until the socket is empty, rather than waking for each datagram
+         */
+        int count = BatchSize;
+        while (count == BatchSize)
+        {
+            memset(headers, 0, sizeof(headers));
+            for (int i = 0; i < BatchSize; i++)
+            {
+                vectors[i].iov_base = &buffers[i * DatagramSize];
+                vectors[i].iov_len = DatagramSize;
+                headers[i].msg_hdr.msg_iov = &vectors[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+                headers[i].msg_hdr.msg_name = &addresses[i];
+                headers[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+                headers[i].msg_hdr.msg_control = &controls[i * CMSG_SPACE(sizeof(uint32_t))];
+                headers[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+            }
+            count = recvmmsg(socket_fd_, headers, BatchSize, MSG_DONTWAIT, NULL);
+            if (count <= 0)
+            {
+                break;
+            }
+            receive_calls_++;
+            for (int i = 0; i < count; i++)
+            {
+                struct msghdr& header = headers[i].msg_hdr;
+                for (struct cmsghdr *control = CMSG_FIRSTHDR(&header); control != NULL; control = CMSG_NXTHDR(&header, control)) {
+                    if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SO_RXQ_OVFL)
+                    {
+                        uint32_t dropped;
+                        memcpy(&dropped, CMSG_DATA(control), sizeof(dropped));
+                        kernel_dropped_ = dropped;
+                    }
+                }
+                if (header.msg_flags & MSG_TRUNC)
+                {
+                    ofLogWarning("OSCReceiveThread") << "Ignoring packet larger than " << DatagramSize << " bytes";
+                    continue;
+                }
+                IpEndpointName endpoint(ntohl(addresses[i].sin_addr.s_addr), ntohs(addresses[i].sin_port));
+                ProcessPacket(&buffers[i * DatagramSize], headers[i].msg_len, endpoint);
+            }
+        }
+    }
+}
+#endif
+
+void OSCReceiveThread::ProcessPacket(const char *data, int size, const IpEndpointName& remote_endpoint)
+{
+    arrival_ = ofGetElapsedTimeMicros();
+    datagrams_++;
+    if (recorder_)
+    {
+        recorder_->record(data, size, arrival_, remote_endpoint);
+    }
+    dispatchPacket(data, size, remote_endpoint);
+}
+
+void OSCReceiveThread::replay(const char *data, int size, uint64_t arrival, const IpEndpointName& remote_endpoint)
+{
+    arrival_ = arrival;
+    dispatchPacket(data, size, remote_endpoint);
+}
+
+void OSCReceiveThread::dispatchPacket(const char *data, int size, const IpEndpointName& remote_endpoint)
+{
+    Tracer::Span span("osc_packet");
+    try {
+        osc::OscPacketListener::ProcessPacket(data, size, remote_endpoint);
+    } catch (std::exception& e) {
+        ofLogWarning("OSCReceiveThread") << "Ignoring malformed packet: " << e.what();
+    }
+}
+
+void OSCReceiveThread::ProcessBundle(const osc::ReceivedBundle& bundle, const IpEndpointName& remote_endpoint)
+{
+    uint64_t previous = time_tag_;
+    time_tag_ = bundle.TimeTag();
+    for (osc::ReceivedBundle::const_iterator it = bundle.ElementsBegin(); it != bundle.ElementsEnd(); ++it) {
+        if (it->IsBundle())
+        {
+            ProcessBundle(osc::ReceivedBundle(*it), remote_endpoint);
+        }
+        else
+        {
+            ProcessMessage(osc::ReceivedMessage(*it), remote_endpoint);
+        }
+    }
+    time_tag_ = previous;
+}
+
+void OSCReceiveThread::ProcessMessage(const osc::ReceivedMessage& received, const IpEndpointName& remote_endpoint)
+{
+    OSCRouter::Route route;
+    const char *address = received.AddressPattern();
+    if (!router_.route(address, strlen(address), route))
+    {
+        return;
+    }
+    if (!message_.message.set(received))
+    {
+        ofLogWarning("OSCReceiveThread") << "Ignoring message too large to queue for " << address;
+        return;
+    }
+    push(route, arrival_, time_tag_);
+}
+
+void OSCReceiveThread::push(const OSCRouter::Route& route, uint64_t arrival, uint64_t time_tag)
+{
+    message_.arrival = arrival;
+    message_.time_tag = time_tag;
+    message_.route = route;
+    int address_slot = -1;
+    if (OSCRouter::isIdempotent(route.leaf))
+    {
+        address_slot = findAddressSlot(message_.message.getAddress(), message_.message.getAddressLength());
+    }
+    else if (OSCRouter::isBarrier(route.leaf))
+    {
+        barriers_++;
+    }
+    if (address_slot == -1)
+    {
+        if (!pushEntry(-1, &message_))
+        {
+            dropped_++;
+        }
+        return;
+    }
+    /*
+     Replace any value still waiting in the slot, and only queue the slot if it isn't already.
+     A value waiting from before a message which can't be coalesced is left to be applied
+     before it, and this one queued after it.
+     */
+    AddressSlot& slot = address_slots_[address_slot];
+    lockSlot(slot);
+    bool queued = slot.queued;
+    if (queued && slot.barrier != barriers_)
+    {
+        unlockSlot(slot);
+        if (!pushEntry(-1, &message_))
+        {
+            dropped_++;
+        }
+        return;
+    }
+    slot.message = message_;
+    slot.queued = true;
+    slot.barrier = barriers_;
+    unlockSlot(slot);
+    if (queued)
+    {
+        coalesced_++;
+    }
+    else if (!pushEntry(address_slot, NULL))
+    {
+        lockSlot(slot);
+        slot.queued = false;
+        unlockSlot(slot);
+        dropped_++;
+    }
+}
+
+bool OSCReceiveThread::pushEntry(int address_slot, const TimedMessage *message)
+{
+    unsigned int write_index = write_index_.load(std::memory_order_relaxed);
+    if (write_index - read_index_.load(std::memory_order_acquire) > mask_)
+    {
+        return false;
+    }
+    Entry& entry = ring_[write_index & mask_];
+    entry.address_slot = address_slot;
+    if (message)
+    {
+        entry.message = *message;
+    }
+    write_index_.store(write_index + 1, std::memory_order_release);
+    return true;
+}
+
+int OSCReceiveThread::findAddressSlot(const char *address, size_t length)
+{
+    unsigned int index = OSCRouter::hash(address, length) % AddressSlotCount;
+    while (!address_keys_[index].empty())
+    {
+        if (address_keys_[index].length() == length && memcmp(address_keys_[index].c_str(), address, length) == 0)
+        {
+            return index;
+        }
+        index = (index + 1) % AddressSlotCount;
+    }
+    /*
+     Keep the table at most three-quarters full so misses stay short
+     */
+    if (address_slots_used_ >= AddressSlotCount * 3 / 4)
+    {
+        return -1;
+    }
+    address_keys_[index].assign(address, length);
+    address_slots_used_++;
+    return index;
+}
+
+void OSCReceiveThread::lockSlot(AddressSlot& slot)
+{
+    while (slot.locked.exchange(true, std::memory_order_acquire))
+    {
+        // Only held for a copy
+    }
+}
+
+void OSCReceiveThread::unlockSlot(AddressSlot& slot)
+{
+    slot.locked.store(false, std::memory_order_release);
+}
+
+bool OSCReceiveThread::inject(const ofxOscMessage& message, uint64_t arrival, uint64_t time_tag)
+{
+    OSCRouter::Route route;
+    std::string address = message.getAddress();
+    if (!router_.route(address.c_str(), address.length(), route))
+    {
+        return true;
+    }
+    if (!message_.message.set(message))
+    {
+        return false;
+    }
+    unsigned long dropped = dropped_;
+    push(route, arrival, time_tag);
+    return dropped_ == dropped;
+}
+
+void OSCReceiveThread::drain(const OSCRouter& router, std::vector<TimedMessage>& messages)
+{
+    unsigned int read_index = read_index_.load(std::memory_order_relaxed);
+    unsigned int write_index = write_index_.load(std::memory_order_acquire);
+    messages.resize(write_index - read_index);
+    size_t count = 0;
+    for (; read_index != write_index; ++read_index)
+    {
+        Entry& entry = ring_[read_index & mask_];
+        TimedMessage& message = messages[count];
+        if (entry.address_slot == -1)
+        {
+            message = entry.message;
+        }
+        else
+        {
+            AddressSlot& slot = address_slots_[entry.address_slot];
+            lockSlot(slot);
+            message = slot.message;
+            slot.queued = false;
+            unlockSlot(slot);
+        }
+        if (router.route(message.message.getAddress(), message.message.getAddressLength(), message.route))
+        {
+            count++;
+        }
+    }
+    read_index_.store(read_index, std::memory_order_release);
+    messages.resize(count);
+}
+
+unsigned int OSCReceiveThread::getQueuedCount() const
+{
+    return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire);
+}
+
+unsigned int OSCReceiveThread::getCapacity() const
+{
+    return mask_ + 1;
+}
+
+unsigned long OSCReceiveThread::getDroppedCount() const
+{
+    return dropped_;
+}
+
+unsigned long OSCReceiveThread::getCoalescedCount() const
+{
+    return coalesced_;
+}
+
+unsigned long OSCReceiveThread::getKernelDroppedCount() const
+{
+    return kernel_dropped_;
+}
+
+unsigned long OSCReceiveThread::getDatagramCount() const
+{
+    return datagrams_;
+}
+
+unsigned long OSCReceiveThread::getReceiveCallCount() const
+{
+    return receive_calls_;
+}
+
+OSCReceiveThread::AddressSlot::AddressSlot()
+: locked(false), queued(false), barrier(0)
+{
+
+}
+
+OSCReceiveThread::Message::Message()
+: address_length_(0), text_length_(1), argument_count_(0)
+{
+    text_[0] = '\0';
+}
+
+bool OSCReceiveThread::Message::set(const osc::ReceivedMessage& received)
+{
+    if (!setAddress(received.AddressPattern()))
+    {
+        return false;
+    }
+    for (osc::ReceivedMessage::const_iterator arg = received.ArgumentsBegin(); arg != received.ArgumentsEnd(); ++arg) {
+        Argument *argument = NULL;
+        if (arg->IsInt32())
+        {
+            if ((argument = addArgument(OFXOSC_TYPE_INT32)))
+            {
+                argument->int32 = arg->AsInt32Unchecked();
+            }
+        }
+        else if (arg->IsInt64())
+        {
+            if ((argument = addArgument(OFXOSC_TYPE_INT64)))
+            {
+                argument->int64 = arg->AsInt64Unchecked();
+            }
+        }
+        else if (arg->IsFloat())
+        {
+            if ((argument = addArgument(OFXOSC_TYPE_FLOAT)))
+            {
+                argument->float32 = arg->AsFloatUnchecked();
+            }
+        }
+        else if (arg->IsString())
+        {
+            argument = addString(arg->AsStringUnchecked());
+        }
+        else
+        {
+            ofLogWarning("OSCReceiveThread") << "Ignoring argument of unsupported type '" << arg->TypeTag() << "' for " << received.AddressPattern();
+            continue;
+        }
+        if (argument == NULL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OSCReceiveThread::Message::set(const ofxOscMessage& message)
+{
+    if (!setAddress(message.getAddress().c_str()))
+    {
+        return false;
+    }
+    for (int i = 0; i < message.getNumArgs(); i++)
+    {
+        Argument *argument = NULL;
+        switch (message.getArgType(i))
+        {
+        case OFXOSC_TYPE_INT32:
+            if ((argument = addArgument(OFXOSC_TYPE_INT32)))
+            {
+                argument->int32 = message.getArgAsInt32(i);
+            }
+            break;
+        case OFXOSC_TYPE_INT64:
+            if ((argument = addArgument(OFXOSC_TYPE_INT64)))
+            {
+                argument->int64 = message.getArgAsInt64(i);
+            }
+            break;
+        case OFXOSC_TYPE_FLOAT:
+            if ((argument = addArgument(OFXOSC_TYPE_FLOAT)))
+            {
+                argument->float32 = message.getArgAsFloat(i);
+            }
+            break;
+        case OFXOSC_TYPE_STRING:
+            argument = addString(message.getArgAsString(i).c_str());
+            break;
+        default:
+            continue;
+        }
+        if (argument == NULL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OSCReceiveThread::Message::setAddress(const char *address)
+{
+    argument_count_ = 0;
+    address_length_ = strlen(address);
+    if (address_length_ + 1 > MaxText)
+    {
+        address_length_ = text_length_ = 0;
+        return false;
+    }
+    memcpy(text_, address, address_length_ + 1);
+    text_length_ = address_length_ + 1;
+    return true;
+}
+
+OSCReceiveThread::Message::Argument *OSCReceiveThread::Message::addArgument(ofxOscArgType type)
+{
+    if (argument_count_ == MaxArguments)
+    {
+        return NULL;
+    }
+    Argument *argument = &arguments_[argument_count_++];
+    argument->type = type;
+    return argument;
+}
+
+OSCReceiveThread::Message::Argument *OSCReceiveThread::Message::addString(const char *string)
+{
+    size_t length = strlen(string) + 1;
+    if (text_length_ + length > MaxText)
+    {
+        return NULL;
+    }
+    Argument *argument = addArgument(OFXOSC_TYPE_STRING);
+    if (argument)
+    {
+        argument->string_start = text_length_;
+        memcpy(text_ + text_length_, string, length);
+        text_length_ += length;
+    }
+    return argument;
+}
+
+const char *OSCReceiveThread::Message::getAddress() const
+{
+    return text_;
+}
+
+size_t OSCReceiveThread::Message::getAddressLength() const
+{
+    return address_length_;
+}
+
+int OSCReceiveThread::Message::getNumArgs() const
+{
+    return argument_count_;
+}
+
+ofxOscArgType OSCReceiveThread::Message::getArgType(int index) const
+{
+    if (index < 0 || index >= argument_count_)
+    {
+        return OFXOSC_TYPE_NONE;
+    }
+    return arguments_[index].type;
+}
+
+int32_t OSCReceiveThread::Message::getArgAsInt32(int index) const
+{
+    switch (getArgType(index))
+    {
+    case OFXOSC_TYPE_INT32:
+        return arguments_[index].int32;
+    case OFXOSC_TYPE_INT64:
+        return int32_t(arguments_[index].int64);
+    case OFXOSC_TYPE_FLOAT:
+        return int32_t(arguments_[index].float32);
+    default:
+        return 0;
+    }
+}
+
+int64_t OSCReceiveThread::Message::getArgAsInt64(int index) const
+{
+    switch (getArgType(index))
+    {
+    case OFXOSC_TYPE_INT32:
+        return arguments_[index].int32;
+    case OFXOSC_TYPE_INT64:
+        return arguments_[index].int64;
+    case OFXOSC_TYPE_FLOAT:
+        return int64_t(arguments_[index].float32);
+    default:
+        return 0;
+    }
+}
+
+float OSCReceiveThread::Message::getArgAsFloat(int index) const
+{
+    switch (getArgType(index))
+    {
+    case OFXOSC_TYPE_INT32:
+        return arguments_[index].int32;
+    case OFXOSC_TYPE_INT64:
+        return arguments_[index].int64;
+    case OFXOSC_TYPE_FLOAT:
+        return arguments_[index].float32;
+    default:
+        return 0;
+    }
+}
+
+std::string OSCReceiveThread::Message::getArgAsString(int index) const
+{
+    if (getArgType(index) != OFXOSC_TYPE_STRING)
+    {
+        return std::string();
+    }
+    return std::string(text_ + arguments_[index].string_start);
+}
@@ -0,0 +1,213 @@
+//
+//  OSCReceiveThread.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__OSCReceiveThread__
+#define __MediaPlayer_client__OSCReceiveThread__
+
+#include "ofMain.h"
+#include <ofxOsc.h>
+#include <atomic>
+#include "OSCRouter.h"
+#include "OSCRecorder.h"
+
+/*
+ Receives OSC on its own thread, stamping each message with its arrival time and passing
+ it to the render thread through a single-producer single-consumer ring.
+
+ On Linux the socket is read directly, taking up to a batch of datagrams per recvmmsg()
+ call, with a configurable receive buffer and the kernel's count of datagrams dropped
+ because that buffer was full. Elsewhere oscpack's socket is used.
+
+ Messages are copied into the ring in a fixed-size form, without allocating. A message
+ which sets a value replaces any earlier message for the same address the render thread
+ has yet to take, in a slot kept for that address, so a stalled frame is followed by one
+ update per value rather than a replay of every intermediate one. The value keeps the
+ place in order of the first message it replaced, so values are never coalesced across a
+ message they may depend on, such as adding or deleting an output. Frame numbers aren't
+ such a message.
+ */
+class OSCReceiveThread : public ofThread, private osc::OscPacketListener {
+public:
+    /*
+     A received message, stored without allocating. Provides the parts of ofxOscMessage's
+     interface the client uses, converting between numeric types as it does.
+     */
+    class Message {
+    public:
+        Message();
+        /*
+         Return false if the message has too many arguments or too much text to store
+         */
+        bool set(const osc::ReceivedMessage& received);
+        bool set(const ofxOscMessage& message);
+        const char *getAddress() const;
+        size_t getAddressLength() const;
+        int getNumArgs() const;
+        ofxOscArgType getArgType(int index) const;
+        int32_t getArgAsInt32(int index) const;
+        int64_t getArgAsInt64(int index) const;
+        float getArgAsFloat(int index) const;
+        std::string getArgAsString(int index) const;
+    private:
+        static const int MaxArguments = 8;
+        // Room for the address and any string arguments, each nul-terminated
+        static const size_t MaxText = 256;
+        struct Argument {
+            ofxOscArgType type;
+            union {
+                int32_t int32;
+                int64_t int64;
+                float float32;
+                // The position of a string in text_
+                size_t string_start;
+            };
+        };
+        bool setAddress(const char *address);
+        // Return NULL if there is no room for the argument
+        Argument *addArgument(ofxOscArgType type);
+        Argument *addString(const char *string);
+        char text_[MaxText];
+        size_t address_length_;
+        size_t text_length_;
+        int argument_count_;
+        Argument arguments_[MaxArguments];
+    };
+    struct TimedMessage {
+        Message message;
+        // ofGetElapsedTimeMicros() when the packet was received
+        uint64_t arrival;
+        // The time tag of the enclosing bundle, or 0 if the message wasn't in a bundle
+        uint64_t time_tag;
+        OSCRouter::Route route;
+    };
+    OSCReceiveThread(unsigned int capacity = 4096);
+    ~OSCReceiveThread();
+    /*
+     Packets are passed to recorder as they are received, if it is set. Must be called
+     before setup().
+     */
+    void setRecorder(OSCRecorder *recorder);
+    /*
+     receive_buffer_size is in bytes, 0 for the system default. reuse_port lets other
+     processes on this host bind the same port, which is only useful with multicast_group,
+     as unicast datagrams go to just one of them. Linux only, and must be called before setup().
+     */
+    void setSocketOptions(int receive_buffer_size, bool reuse_port, const std::string& multicast_group);
+    /*
+     Messages for other clients are discarded as they are received. Must be called before
+     setup(), inject() or replay().
+     */
+    void setClientID(const std::string& client_id);
+    void setup(int port);
+    void close();
+    /*
+     Replaces the contents of messages with every message received since the last call
+     which is addressed to us, in order of arrival, less any superseded ones. Routes are
+     resolved by router.
+     */
+    void drain(const OSCRouter& router, std::vector<TimedMessage>& messages);
+    /*
+     Queues a message as if it had been received. Only valid when the socket isn't set up,
+     as the ring has a single producer.
+     */
+    bool inject(const ofxOscMessage& message, uint64_t arrival, uint64_t time_tag);
+    /*
+     Processes a recorded packet as if it had been received. The same restriction as
+     inject() applies.
+     */
+    void replay(const char *data, int size, uint64_t arrival, const IpEndpointName& remote_endpoint);
+    unsigned int getQueuedCount() const;
+    unsigned int getCapacity() const;
+    unsigned long getDroppedCount() const;
+    unsigned long getCoalescedCount() const;
+    /*
+     Datagrams dropped by the kernel before we could read them, where known
+     */
+    unsigned long getKernelDroppedCount() const;
+    unsigned long getDatagramCount() const;
+    /*
+     recvmmsg() calls which returned datagrams, Linux only
+     */
+    unsigned long getReceiveCallCount() const;
+protected:
+    void threadedFunction();
+    virtual void ProcessPacket(const char *data, int size, const IpEndpointName& remote_endpoint);
+    virtual void ProcessBundle(const osc::ReceivedBundle& bundle, const IpEndpointName& remote_endpoint);
+    virtual void ProcessMessage(const osc::ReceivedMessage& message, const IpEndpointName& remote_endpoint);
+private:
+    /*
+     An entry in the ring is either a message or the index of the address slot holding it
+     */
+    struct Entry {
+        int address_slot;
+        TimedMessage message;
+    };
+    struct AddressSlot {
+        AddressSlot();
+        // Guards queued and message, held only to copy a message in or out
+        std::atomic<bool> locked;
+        // An Entry referring to the slot is in the ring
+        bool queued;
+        // barriers_ when the slot was queued, only used by the receiving thread
+        unsigned int barrier;
+        TimedMessage message;
+    };
+    static const unsigned int AddressSlotCount = 1024;
+    void dispatchPacket(const char *data, int size, const IpEndpointName& remote_endpoint);
+    /*
+     Queues message_ with the given route, coalescing it if it sets a value
+     */
+    void push(const OSCRouter::Route& route, uint64_t arrival, uint64_t time_tag);
+    bool pushEntry(int address_slot, const TimedMessage *message);
+    int findAddressSlot(const char *address, size_t length);
+    void lockSlot(AddressSlot& slot);
+    void unlockSlot(AddressSlot& slot);
+#if defined(TARGET_LINUX)
+    bool openSocket(int port);
+    void receiveBatches();
+    int socket_fd_;
+    // Written to by close() to wake the thread
+    int wake_fds_[2];
+#endif
+
+    std::shared_ptr<UdpListeningReceiveSocket> socket_;
+    int receive_buffer_size_;
+    bool reuse_port_;
+    std::string multicast_group_;
+    std::atomic<unsigned long> kernel_dropped_;
+    std::atomic<unsigned long> datagrams_;
+    std::atomic<unsigned long> receive_calls_;
+    OSCRecorder *recorder_;
+    // When the packet being processed was received
+    uint64_t arrival_;
+    uint64_t time_tag_;
+
+    // Used only by the receiving thread to find the route and leaf of each message
+    OSCRouter router_;
+    // The message being queued, kept to avoid reinitialising it for each message
+    TimedMessage message_;
+
+    std::vector<Entry> ring_;
+    unsigned int mask_;
+    std::atomic<unsigned int> write_index_;
+    std::atomic<unsigned int> read_index_;
+    std::atomic<unsigned long> dropped_;
+
+    /*
+     Messages which set a value are kept in a slot for their address until taken. The keys
+     are only used by the receiving thread, in an open-addressed table which fills as new
+     addresses arrive. Once it is full, messages for further addresses aren't coalesced.
+     */
+    std::vector<AddressSlot> address_slots_;
+    std::vector<std::string> address_keys_;
+    unsigned int address_slots_used_;
+    // Barrier messages queued, only used by the receiving thread. A value only replaces
+    // one queued since the last of them.
+    unsigned int barriers_;
+    std::atomic<unsigned long> coalesced_;
+};
+
+#endif /* defined(__MediaPlayer_client__OSCReceiveThread__) */
@@ -0,0 +1,157 @@
+//
+//  OSCRecorder.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "OSCRecorder.h"
+
+const char OSCRecorder::Magic[8] = {'M', 'P', 'O', 'S', 'C', 'L', 'O', 'G'};
+
+OSCRecorder::OSCRecorder(size_t buffer_size)
+: filling_(0), file_(NULL), start_(0), running_(false), recorded_(0), dropped_(0)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        buffers_[i].resize(buffer_size);
+        used_[i] = 0;
+    }
+}
+
+OSCRecorder::~OSCRecorder()
+{
+    close();
+}
+
+bool OSCRecorder::setup(const std::string& path)
+{
+    close();
+    path_ = ofToDataPath(path, true);
+    file_ = fopen(path_.c_str(), "wb");
+    if (file_ == NULL)
+    {
+        ofLogError("OSCRecorder") << "Unable to create " << path_;
+        return false;
+    }
+    Header header;
+    memcpy(header.magic, Magic, sizeof(header.magic));
+    header.version = Version;
+    header.reserved = 0;
+    header.start_time = ofGetUnixTime();
+    fwrite(&header, sizeof(header), 1, file_);
+
+    start_ = ofGetElapsedTimeMicros();
+    recorded_ = dropped_ = 0;
+    running_ = true;
+    startThread();
+    ofLogNotice("OSCRecorder") << "Recording OSC to " << path_;
+    return true;
+}
+
+void OSCRecorder::close()
+{
+    mutex_.lock();
+    running_ = false;
+    condition_.signal();
+    mutex_.unlock();
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+    if (file_)
+    {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+void OSCRecorder::record(const char *data, int size, uint64_t arrival, const IpEndpointName& remote_endpoint)
+{
+    RecordHeader header;
+    header.offset = arrival - start_;
+    header.address = remote_endpoint.address;
+    header.port = remote_endpoint.port;
+    header.size = size;
+    header.reserved = 0;
+    size_t length = sizeof(header) + size;
+
+    ofScopedLock lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    std::vector<char>& buffer = buffers_[filling_];
+    if (used_[filling_] + length > buffer.size())
+    {
+        /*
+         Swap buffers if the thread has finished writing the other one
+         */
+        if (used_[1 - filling_] == 0 && used_[filling_] > 0 && length <= buffer.size())
+        {
+            filling_ = 1 - filling_;
+            condition_.signal();
+        }
+        else
+        {
+            dropped_++;
+            return;
+        }
+    }
+    char *destination = &buffers_[filling_][used_[filling_]];
+    memcpy(destination, &header, sizeof(header));
+    memcpy(destination + sizeof(header), data, size);
+    used_[filling_] += length;
+    recorded_++;
+}
+
+unsigned long OSCRecorder::getRecordedCount() const
+{
+    ofScopedLock lock(mutex_);
+    return recorded_;
+}
+
+unsigned long OSCRecorder::getDroppedCount() const
+{
+    ofScopedLock lock(mutex_);
+    return dropped_;
+}
+
+void OSCRecorder::threadedFunction()
+{
+    mutex_.lock();
+    for (;;)
+    {
+        int writing = 1 - filling_;
+        if (used_[writing] > 0)
+        {
+            mutex_.unlock();
+            if (fwrite(&buffers_[writing][0], 1, used_[writing], file_) != used_[writing] || fflush(file_) != 0)
+            {
+                ofLogError("OSCRecorder") << "Unable to write to " << path_;
+            }
+            mutex_.lock();
+            used_[writing] = 0;
+        }
+        else if (used_[filling_] > 0 && !running_)
+        {
+            filling_ = writing;
+        }
+        else if (running_)
+        {
+            /*
+             Write whatever has been recorded at least every FlushInterval, so a log is
+             mostly complete if we crash
+             */
+            condition_.tryWait(mutex_, FlushInterval);
+            if (used_[filling_] > 0 && used_[1 - filling_] == 0)
+            {
+                filling_ = 1 - filling_;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    mutex_.unlock();
+}
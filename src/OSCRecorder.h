@@ -0,0 +1,74 @@
+//
+//  OSCRecorder.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__OSCRecorder__
+#define __MediaPlayer_client__OSCRecorder__
+
+#include "ofMain.h"
+#include <UdpSocket.h>
+
+/*
+ Appends received OSC packets to a log for OSCReplayer.
+
+ Packets are copied into a preallocated buffer and written by a background thread, so
+ recording costs the receive thread a copy. If the disk falls so far behind that both
+ buffers are full, packets are dropped from the log rather than blocking.
+
+ A log is a Header followed by a RecordHeader and the packet bytes for each packet, in
+ the byte order of the machine which recorded it.
+ */
+class OSCRecorder : public ofThread {
+public:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        // Wall clock time the recording started, in seconds since the epoch
+        uint64_t start_time;
+    };
+    struct RecordHeader {
+        // Microseconds since the recording started
+        uint64_t offset;
+        uint32_t address;
+        uint32_t port;
+        uint32_t size;
+        uint32_t reserved;
+    };
+    static const char Magic[8];
+    static const uint32_t Version = 1;
+
+    OSCRecorder(size_t buffer_size = 1024 * 1024);
+    ~OSCRecorder();
+    bool setup(const std::string& path);
+    /*
+     Writes anything buffered and closes the log
+     */
+    void close();
+    /*
+     Called from the receive thread with each packet
+     */
+    void record(const char *data, int size, uint64_t arrival, const IpEndpointName& remote_endpoint);
+    unsigned long getRecordedCount() const;
+    unsigned long getDroppedCount() const;
+protected:
+    void threadedFunction();
+private:
+    static const long FlushInterval = 250;
+    mutable ofMutex mutex_;
+    Poco::Condition condition_;
+    std::vector<char> buffers_[2];
+    size_t used_[2];
+    // The buffer record() appends to, the other is written by the thread
+    int filling_;
+    FILE *file_;
+    std::string path_;
+    uint64_t start_;
+    bool running_;
+    unsigned long recorded_;
+    unsigned long dropped_;
+};
+
+#endif /* defined(__MediaPlayer_client__OSCRecorder__) */
@@ -0,0 +1,135 @@
+//
+//  OSCReplayer.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "OSCReplayer.h"
+#include "OSCRecorder.h"
+
+bool OSCReplayer::parseArguments(int argc, char *argv[], std::string& path, float& speed)
+{
+    bool found = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--replay" && i + 1 < argc)
+        {
+            path = argv[++i];
+            found = true;
+        }
+        else if (found && argument.compare(0, 6, "speed=") == 0)
+        {
+            std::string value = argument.substr(6);
+            speed = value == "asap" ? 0.0 : std::max(ofToFloat(value), 0.0f);
+        }
+    }
+    return found;
+}
+
+OSCReplayer::OSCReplayer(const std::string& path, float speed)
+: path_(path), speed_(speed), file_(NULL), receiver_(NULL), finished_(false), replayed_(0)
+{
+
+}
+
+OSCReplayer::~OSCReplayer()
+{
+    close();
+}
+
+bool OSCReplayer::setup(OSCReceiveThread& receiver)
+{
+    close();
+    file_ = fopen(ofToDataPath(path_, true).c_str(), "rb");
+    OSCRecorder::Header header;
+    if (file_ == NULL || fread(&header, sizeof(header), 1, file_) != 1
+        || memcmp(header.magic, OSCRecorder::Magic, sizeof(header.magic)) != 0
+        || header.version != OSCRecorder::Version)
+    {
+        ofLogError("OSCReplayer") << "Unable to read an OSC log from " << path_;
+        close();
+        return false;
+    }
+    ofLogNotice("OSCReplayer") << "Replaying OSC recorded at " << header.start_time << " from " << path_;
+    receiver_ = &receiver;
+    finished_ = false;
+    replayed_ = 0;
+    startThread();
+    return true;
+}
+
+void OSCReplayer::close()
+{
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+    if (file_)
+    {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+bool OSCReplayer::isFinished() const
+{
+    return finished_;
+}
+
+unsigned long OSCReplayer::getReplayedCount() const
+{
+    return replayed_;
+}
+
+void OSCReplayer::threadedFunction()
+{
+    std::vector<char> packet;
+    OSCRecorder::RecordHeader header;
+    uint64_t start = ofGetElapsedTimeMicros();
+    uint64_t first_offset = 0;
+    bool first = true;
+    while (isThreadRunning() && fread(&header, sizeof(header), 1, file_) == 1)
+    {
+        packet.resize(std::max(header.size, 1U));
+        if (fread(&packet[0], 1, header.size, file_) != header.size)
+        {
+            ofLogWarning("OSCReplayer") << "Log ends part way through a packet";
+            break;
+        }
+        if (first)
+        {
+            first_offset = header.offset;
+            first = false;
+        }
+        if (speed_ > 0.0)
+        {
+            /*
+             Sleep most of the way to when the packet is due, then yield for the rest
+             */
+            uint64_t due = start + uint64_t((header.offset - first_offset) / speed_);
+            for (uint64_t now = ofGetElapsedTimeMicros(); now < due && isThreadRunning(); now = ofGetElapsedTimeMicros())
+            {
+                if (due - now > 2000)
+                {
+                    ofSleepMillis((due - now) / 1000 - 1);
+                }
+                else
+                {
+                    yield();
+                }
+            }
+        }
+        /*
+         Don't overrun the receive queue, which would drop messages a live client wouldn't
+         */
+        while (receiver_->getQueuedCount() > receiver_->getCapacity() / 2 && isThreadRunning())
+        {
+            yield();
+        }
+        receiver_->replay(&packet[0], header.size, ofGetElapsedTimeMicros(), IpEndpointName(header.address, header.port));
+        replayed_++;
+    }
+    ofLogNotice("OSCReplayer") << "Replayed " << replayed_ << " packets";
+    finished_ = true;
+}
@@ -0,0 +1,41 @@
+//
+//  OSCReplayer.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__OSCReplayer__
+#define __MediaPlayer_client__OSCReplayer__
+
+#include "ofMain.h"
+#include "OSCReceiveThread.h"
+
+/*
+ Feeds a log written by OSCRecorder into an OSCReceiveThread on a background thread, in
+ place of its socket, preserving the intervals between packets divided by speed. A speed
+ of 0 replays as fast as messages are consumed.
+ */
+class OSCReplayer : public ofThread {
+public:
+    /*
+     Returns true if the arguments request a replay, filling path and speed from them
+     */
+    static bool parseArguments(int argc, char *argv[], std::string& path, float& speed);
+    OSCReplayer(const std::string& path, float speed);
+    ~OSCReplayer();
+    bool setup(OSCReceiveThread& receiver);
+    void close();
+    bool isFinished() const;
+    unsigned long getReplayedCount() const;
+protected:
+    void threadedFunction();
+private:
+    std::string path_;
+    float speed_;
+    FILE *file_;
+    OSCReceiveThread *receiver_;
+    std::atomic<bool> finished_;
+    std::atomic<unsigned long> replayed_;
+};
+
+#endif /* defined(__MediaPlayer_client__OSCReplayer__) */
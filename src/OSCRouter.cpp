@@ -0,0 +1,212 @@
+//
+//  OSCRouter.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "OSCRouter.h"
+
+static const char *leaf_addresses[OSCRouter::LeafCount] = {
+    "",
+    "/frame_number_reset",
+    "/frame_number",
+    "/display_stats",
+    "/full_screen",
+    "/source",
+    "/add_output",
+    "/delete_output",
+    "/send_config",
+    "/frame_stats",
+    "/crop/active",
+    "/crop/x",
+    "/crop/y",
+    "/crop/width",
+    "/crop/height",
+    "/warp/top_left/x",
+    "/warp/top_left/y",
+    "/warp/top_right/x",
+    "/warp/top_right/y",
+    "/warp/bottom_right/x",
+    "/warp/bottom_right/y",
+    "/warp/bottom_left/x",
+    "/warp/bottom_left/y",
+    "/blend/left",
+    "/blend/top",
+    "/blend/right",
+    "/blend/bottom",
+    "/grid/size",
+    "/grid/point",
+    "/dump_trace",
+    "/heartbeat"
+};
+
+static bool segmentEquals(const char *start, const char *end, const char *string, size_t length)
+{
+    return size_t(end - start) == length && memcmp(start, string, length) == 0;
+}
+
+OSCRouter::OSCRouter()
+{
+    for (unsigned int i = 0; i < TableSize; i++)
+    {
+        table_[i] = LeafUnknown;
+    }
+    for (int leaf = LeafUnknown + 1; leaf < LeafCount; leaf++)
+    {
+        unsigned int slot = hash(leaf_addresses[leaf], strlen(leaf_addresses[leaf])) % TableSize;
+        while (table_[slot] != LeafUnknown)
+        {
+            slot = (slot + 1) % TableSize;
+        }
+        table_[slot] = Leaf(leaf);
+    }
+}
+
+void OSCRouter::setClientID(const std::string& client_id)
+{
+    client_id_ = client_id;
+}
+
+void OSCRouter::setOutputs(const std::vector<std::string>& names)
+{
+    outputs_ = names;
+    output_hashes_.clear();
+    for (std::vector<std::string>::const_iterator it = outputs_.begin(); it != outputs_.end(); ++it) {
+        output_hashes_.push_back(hash(it->c_str(), it->length()));
+    }
+}
+
+bool OSCRouter::route(const char *address, size_t length, Route& route) const
+{
+    const char *start = address;
+    const char *end = address + length;
+    while (start < end && (*start == ' ' || *start == '\t'))
+    {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t'))
+    {
+        end--;
+    }
+
+    route.scope = ScopeClient;
+    route.output = -1;
+    route.output_name_start = 0;
+    route.output_name_length = 0;
+
+    const char *slash = std::find(start, end, '/');
+    if (slash == end)
+    {
+        return false;
+    }
+    const char *local = start;
+    const char *segment = slash + 1;
+    const char *segment_end = std::find(segment, end, '/');
+    if (segmentEquals(segment, segment_end, "client", 6))
+    {
+        if (segment_end == end)
+        {
+            return false;
+        }
+        segment = segment_end + 1;
+        segment_end = std::find(segment, end, '/');
+        if (!segmentEquals(segment, segment_end, client_id_.c_str(), client_id_.length()))
+        {
+            return false;
+        }
+        local = segment_end;
+        if (segment_end != end)
+        {
+            segment = segment_end + 1;
+            segment_end = std::find(segment, end, '/');
+            if (segmentEquals(segment, segment_end, "output", 6))
+            {
+                if (segment_end == end)
+                {
+                    return false;
+                }
+                segment = segment_end + 1;
+                segment_end = std::find(segment, end, '/');
+                route.scope = ScopeOutput;
+                route.output = findOutput(segment, segment_end - segment);
+                route.output_name_start = segment - address;
+                route.output_name_length = segment_end - segment;
+                local = segment_end;
+            }
+        }
+    }
+    route.leaf = findLeaf(local, end - local);
+    return true;
+}
+
+const char *OSCRouter::getLeafAddress(Leaf leaf)
+{
+    return leaf_addresses[leaf];
+}
+
+bool OSCRouter::isIdempotent(Leaf leaf)
+{
+    switch (leaf)
+    {
+    case LeafFrameNumberReset:
+    case LeafFrameNumber:
+    case LeafAddOutput:
+    case LeafDeleteOutput:
+    case LeafSendConfig:
+    case LeafFrameStats:
+    case LeafGridSize:
+    case LeafGridPoint:
+    case LeafDumpTrace:
+    case LeafUnknown:
+        return false;
+    default:
+        return true;
+    }
+}
+
+bool OSCRouter::isBarrier(Leaf leaf)
+{
+    return !isIdempotent(leaf) && leaf != LeafFrameNumber && leaf != LeafFrameNumberReset;
+}
+
+/*
+ FNV-1a
+ */
+unsigned int OSCRouter::hash(const char *start, size_t length)
+{
+    uint32_t result = 2166136261U;
+    for (size_t i = 0; i < length; i++)
+    {
+        result ^= (unsigned char)start[i];
+        result *= 16777619U;
+    }
+    return result;
+}
+
+OSCRouter::Leaf OSCRouter::findLeaf(const char *start, size_t length) const
+{
+    unsigned int slot = hash(start, length) % TableSize;
+    while (table_[slot] != LeafUnknown)
+    {
+        const char *candidate = leaf_addresses[table_[slot]];
+        if (strlen(candidate) == length && memcmp(candidate, start, length) == 0)
+        {
+            return table_[slot];
+        }
+        slot = (slot + 1) % TableSize;
+    }
+    return LeafUnknown;
+}
+
+int OSCRouter::findOutput(const char *start, size_t length) const
+{
+    unsigned int value = hash(start, length);
+    for (size_t i = 0; i < outputs_.size(); i++)
+    {
+        if (output_hashes_[i] == value && outputs_[i].length() == length && memcmp(outputs_[i].c_str(), start, length) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
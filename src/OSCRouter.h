@@ -0,0 +1,100 @@
+//
+//  OSCRouter.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__OSCRouter__
+#define __MediaPlayer_client__OSCRouter__
+
+#include "ofMain.h"
+
+/*
+ Matches OSC addresses of the forms
+
+    /<leaf>
+    /client/<id>/<leaf>
+    /client/<id>/output/<name>/<leaf>
+
+ in place, resolving the leaf and output name to indices without allocating.
+ */
+class OSCRouter {
+public:
+    enum Leaf {
+        LeafUnknown,
+        LeafFrameNumberReset,
+        LeafFrameNumber,
+        LeafDisplayStats,
+        LeafFullScreen,
+        LeafSource,
+        LeafAddOutput,
+        LeafDeleteOutput,
+        LeafSendConfig,
+        LeafFrameStats,
+        LeafCropActive,
+        LeafCropX,
+        LeafCropY,
+        LeafCropWidth,
+        LeafCropHeight,
+        LeafWarpTopLeftX,
+        LeafWarpTopLeftY,
+        LeafWarpTopRightX,
+        LeafWarpTopRightY,
+        LeafWarpBottomRightX,
+        LeafWarpBottomRightY,
+        LeafWarpBottomLeftX,
+        LeafWarpBottomLeftY,
+        LeafBlendLeft,
+        LeafBlendTop,
+        LeafBlendRight,
+        LeafBlendBottom,
+        LeafGridSize,
+        LeafGridPoint,
+        LeafDumpTrace,
+        LeafHeartbeat,
+        LeafCount
+    };
+    enum Scope {
+        ScopeClient,
+        ScopeOutput
+    };
+    struct Route {
+        Scope scope;
+        Leaf leaf;
+        // For ScopeOutput, the index of the output passed to setOutputs(), or -1 if it is unknown
+        int output;
+        // The position and length of the output name in the address
+        size_t output_name_start;
+        size_t output_name_length;
+    };
+    OSCRouter();
+    void setClientID(const std::string& client_id);
+    void setOutputs(const std::vector<std::string>& names);
+    /*
+     Returns false if the address is for another client
+     */
+    bool route(const char *address, size_t length, Route& route) const;
+    static const char *getLeafAddress(Leaf leaf);
+    /*
+     Whether a message for the leaf sets a value, so any earlier message for the same address
+     may be discarded
+     */
+    static bool isIdempotent(Leaf leaf);
+    /*
+     Whether values set before and after a message for the leaf must stay on their side of
+     it. True of every message which doesn't set a value except frame numbers, which no value
+     depends on.
+     */
+    static bool isBarrier(Leaf leaf);
+    static unsigned int hash(const char *start, size_t length);
+private:
+    Leaf findLeaf(const char *start, size_t length) const;
+    int findOutput(const char *start, size_t length) const;
+    static const unsigned int TableSize = 128;
+    Leaf table_[TableSize];
+    std::string client_id_;
+    std::vector<std::string> outputs_;
+    std::vector<unsigned int> output_hashes_;
+};
+
+#endif /* defined(__MediaPlayer_client__OSCRouter__) */
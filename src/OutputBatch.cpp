@@ -0,0 +1,267 @@
+//
+//  OutputBatch.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "OutputBatch.h"
+
+OutputBatch::Geometry::Geometry()
+: has_texture_(false)
+{
+
+}
+
+void OutputBatch::Geometry::clear()
+{
+    images_.clear();
+    strips_.clear();
+    has_texture_ = false;
+}
+
+void OutputBatch::transform(const ofMatrix4x4& warp, const ofPoint& point, Vertex& vertex)
+{
+    /*
+     The same transformation glMultMatrixf() would apply, keeping w rather than dividing by it
+     */
+    const float *m = warp.getPtr();
+    vertex.position[0] = (m[0] * point.x) + (m[4] * point.y) + m[12];
+    vertex.position[1] = (m[1] * point.x) + (m[5] * point.y) + m[13];
+    vertex.position[2] = (m[2] * point.x) + (m[6] * point.y) + m[14];
+    vertex.position[3] = (m[3] * point.x) + (m[7] * point.y) + m[15];
+}
+
+void OutputBatch::Geometry::addImage(const ofMatrix4x4& warp, const ofRectangle& bounds, const ofRectangle& crop, ofTexture& texture)
+{
+    std::vector<ofPoint> vertices;
+    vertices.push_back(bounds.getTopLeft());
+    vertices.push_back(bounds.getTopRight());
+    vertices.push_back(bounds.getBottomLeft());
+    vertices.push_back(bounds.getBottomRight());
+    addGrid(warp, vertices, 2, 2, crop, texture);
+}
+
+void OutputBatch::Geometry::addGrid(const ofMatrix4x4& warp, const std::vector<ofPoint>& vertices, unsigned int columns, unsigned int rows, const ofRectangle& crop, ofTexture& texture)
+{
+    if (columns < 2 || rows < 2 || vertices.size() < columns * rows)
+    {
+        return;
+    }
+    /*
+     Inset texture coordinates as ofTexture::drawSubsection() does, so edges don't sample
+     the texture's padding
+     */
+    const ofTextureData& data = texture.getTextureData();
+    ofPoint inset;
+    if (data.textureTarget == GL_TEXTURE_2D && ofIsTextureEdgeHackEnabled())
+    {
+        inset.set(1.0 / data.tex_w, 1.0 / data.tex_h);
+    }
+    ofPoint top_left = texture.getCoordFromPoint(crop.getLeft(), crop.getTop()) + inset;
+    ofPoint bottom_right = texture.getCoordFromPoint(crop.getRight(), crop.getBottom()) - inset;
+
+    /*
+     Texture coordinates are linear in the crop, so can be interpolated across the grid
+     */
+    std::vector<Vertex> grid(columns * rows);
+    for (unsigned int y = 0; y < rows; y++)
+    {
+        for (unsigned int x = 0; x < columns; x++)
+        {
+            Vertex& vertex = grid[(y * columns) + x];
+            transform(warp, vertices[(y * columns) + x], vertex);
+            vertex.tex_coord[0] = ofLerp(top_left.x, bottom_right.x, float(x) / (columns - 1));
+            vertex.tex_coord[1] = ofLerp(top_left.y, bottom_right.y, float(y) / (rows - 1));
+            vertex.color = ofFloatColor(1.0, 1.0, 1.0, 1.0);
+        }
+    }
+    images_.reserve(images_.size() + ((columns - 1) * (rows - 1) * 6));
+    for (unsigned int y = 0; y + 1 < rows; y++)
+    {
+        for (unsigned int x = 0; x + 1 < columns; x++)
+        {
+            const Vertex& a = grid[(y * columns) + x];
+            const Vertex& b = grid[(y * columns) + x + 1];
+            const Vertex& c = grid[((y + 1) * columns) + x + 1];
+            const Vertex& d = grid[((y + 1) * columns) + x];
+            images_.push_back(a);
+            images_.push_back(b);
+            images_.push_back(c);
+            images_.push_back(a);
+            images_.push_back(c);
+            images_.push_back(d);
+        }
+    }
+    texture_data_ = data;
+    has_texture_ = true;
+}
+
+void OutputBatch::Geometry::addStrip(const ofMatrix4x4& warp, const ofMesh& mesh)
+{
+    for (size_t i = 2; i < mesh.getNumVertices(); i++)
+    {
+        /*
+         Alternate winding as a strip does, though nothing is culled
+         */
+        size_t triangle[3] = {i - 2, i - 1, i};
+        if (i % 2)
+        {
+            std::swap(triangle[0], triangle[1]);
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            Vertex vertex;
+            transform(warp, mesh.getVertex(triangle[j]), vertex);
+            vertex.tex_coord[0] = vertex.tex_coord[1] = 0.0;
+            vertex.color = mesh.getColor(triangle[j]);
+            strips_.push_back(vertex);
+        }
+    }
+}
+
+OutputBatch::OutputBatch()
+: image_count_(0), vertex_count_(0), layout_changed_(true), has_texture_(false)
+{
+
+}
+
+void OutputBatch::setOutputCount(unsigned int count)
+{
+    outputs_.clear();
+    outputs_.resize(count);
+    has_texture_ = false;
+    layout_changed_ = true;
+}
+
+unsigned int OutputBatch::getOutputCount() const
+{
+    return outputs_.size();
+}
+
+void OutputBatch::setOutput(unsigned int index, const Geometry& geometry)
+{
+    if (index >= outputs_.size())
+    {
+        return;
+    }
+    Geometry& previous = outputs_[index];
+    bool same_layout = geometry.images_.size() == previous.images_.size() && geometry.strips_.size() == previous.strips_.size();
+    previous = geometry;
+    if (geometry.has_texture_)
+    {
+        texture_data_ = geometry.texture_data_;
+        has_texture_ = true;
+    }
+    if (layout_changed_ || !same_layout)
+    {
+        layout_changed_ = true;
+        return;
+    }
+    /*
+     Copy the output's vertices over its ranges, to be uploaded by the next draw()
+     */
+    Range images = {image_starts_[index], geometry.images_.size()};
+    Range strips = {strip_starts_[index], geometry.strips_.size()};
+    if (images.count > 0)
+    {
+        std::copy(geometry.images_.begin(), geometry.images_.end(), uploaded_.begin() + images.start);
+        changed_ranges_.push_back(images);
+    }
+    if (strips.count > 0)
+    {
+        std::copy(geometry.strips_.begin(), geometry.strips_.end(), uploaded_.begin() + strips.start);
+        changed_ranges_.push_back(strips);
+    }
+}
+
+bool OutputBatch::needsRebuild(ofTexture& texture) const
+{
+    if (!has_texture_)
+    {
+        return image_count_ > 0;
+    }
+    const ofTextureData& data = texture.getTextureData();
+    return data.textureTarget != texture_data_.textureTarget
+        || data.tex_t != texture_data_.tex_t
+        || data.tex_u != texture_data_.tex_u
+        || data.width != texture_data_.width
+        || data.height != texture_data_.height
+        || data.bFlipTexture != texture_data_.bFlipTexture;
+}
+
+void OutputBatch::upload(const Range& range)
+{
+    /*
+     ofVbo keeps each attribute in its own buffer, each holding the interleaved vertices
+     from that attribute onwards, as draw() created them
+     */
+    GLuint buffers[3] = {vbo_.getVertId(), vbo_.getTexCoordId(), vbo_.getColorId()};
+    const Vertex& first = uploaded_[range.start];
+    const void *data[3] = {first.position, first.tex_coord, &first.color.r};
+    for (int i = 0; i < 3; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferSubData(GL_ARRAY_BUFFER, range.start * sizeof(Vertex), range.count * sizeof(Vertex), data[i]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OutputBatch::draw(ofTexture& texture, ofShader *shader)
+{
+    if (layout_changed_)
+    {
+        /*
+         All images come first, so they can be drawn in one call, then all strips
+         */
+        uploaded_.clear();
+        image_starts_.resize(outputs_.size());
+        strip_starts_.resize(outputs_.size());
+        for (size_t i = 0; i < outputs_.size(); i++)
+        {
+            image_starts_[i] = uploaded_.size();
+            uploaded_.insert(uploaded_.end(), outputs_[i].images_.begin(), outputs_[i].images_.end());
+        }
+        image_count_ = uploaded_.size();
+        for (size_t i = 0; i < outputs_.size(); i++)
+        {
+            strip_starts_[i] = uploaded_.size();
+            uploaded_.insert(uploaded_.end(), outputs_[i].strips_.begin(), outputs_[i].strips_.end());
+        }
+        vertex_count_ = uploaded_.size();
+        uploaded_.push_back(Vertex());
+        vbo_.clear();
+        if (vertex_count_ > 0)
+        {
+            vbo_.setVertexData(uploaded_[0].position, 4, vertex_count_, GL_DYNAMIC_DRAW, sizeof(Vertex));
+            vbo_.setTexCoordData(uploaded_[0].tex_coord, vertex_count_, GL_DYNAMIC_DRAW, sizeof(Vertex));
+            vbo_.setColorData(&uploaded_[0].color.r, vertex_count_, GL_DYNAMIC_DRAW, sizeof(Vertex));
+        }
+        changed_ranges_.clear();
+        layout_changed_ = false;
+    }
+    else
+    {
+        for (std::vector<Range>::const_iterator it = changed_ranges_.begin(); it != changed_ranges_.end(); ++it) {
+            upload(*it);
+        }
+        changed_ranges_.clear();
+    }
+    if (image_count_ > 0)
+    {
+        texture.bind();
+        if (shader)
+        {
+            shader->begin();
+        }
+        vbo_.draw(GL_TRIANGLES, 0, image_count_);
+        if (shader)
+        {
+            shader->end();
+        }
+        texture.unbind();
+    }
+    if (vertex_count_ > image_count_)
+    {
+        vbo_.draw(GL_TRIANGLES, image_count_, vertex_count_ - image_count_);
+    }
+}
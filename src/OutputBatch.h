@@ -0,0 +1,95 @@
+//
+//  OutputBatch.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__OutputBatch__
+#define __MediaPlayer_client__OutputBatch__
+
+#include "ofMain.h"
+
+/*
+ Holds the warped geometry of every output in one VBO, so all outputs are drawn with one
+ texture and shader bind and at most two draw calls: one for the images and one for the
+ blend strips.
+
+ Warps are applied to the vertices when they are added, as homogeneous coordinates, so
+ texture coordinates are still interpolated with perspective. Each output's geometry is
+ set separately. If an output keeps the same number of vertices, as it does when a grid
+ point moves, only its ranges of the VBO are uploaded again by the next draw(); otherwise
+ the whole VBO is rebuilt.
+ */
+class OutputBatch {
+private:
+    struct Vertex {
+        float position[4];
+        float tex_coord[2];
+        ofFloatColor color;
+    };
+public:
+    /*
+     The geometry of one output
+     */
+    class Geometry {
+    public:
+        Geometry();
+        void clear();
+        /*
+         Adds a quad covering bounds, showing crop from texture, transformed by warp
+         */
+        void addImage(const ofMatrix4x4& warp, const ofRectangle& bounds, const ofRectangle& crop, ofTexture& texture);
+        /*
+         Adds a grid of quads with vertices given in rows from the top, showing crop from
+         texture spread evenly over the grid, transformed by warp
+         */
+        void addGrid(const ofMatrix4x4& warp, const std::vector<ofPoint>& vertices, unsigned int columns, unsigned int rows, const ofRectangle& crop, ofTexture& texture);
+        /*
+         Adds an untextured mesh in OF_PRIMITIVE_TRIANGLE_STRIP mode, transformed by warp
+         */
+        void addStrip(const ofMatrix4x4& warp, const ofMesh& mesh);
+    private:
+        friend class OutputBatch;
+        std::vector<Vertex> images_;
+        std::vector<Vertex> strips_;
+        bool has_texture_;
+        ofTextureData texture_data_;
+    };
+    OutputBatch();
+    /*
+     Sets the number of outputs, clearing the geometry of all of them
+     */
+    void setOutputCount(unsigned int count);
+    unsigned int getOutputCount() const;
+    void setOutput(unsigned int index, const Geometry& geometry);
+    /*
+     Returns true if texture coordinates added from texture would differ from the
+     ones in the batch, which happens if the source's texture changes shape
+     */
+    bool needsRebuild(ofTexture& texture) const;
+    void draw(ofTexture& texture, ofShader *shader);
+private:
+    struct Range {
+        size_t start;
+        size_t count;
+    };
+    static void transform(const ofMatrix4x4& warp, const ofPoint& point, Vertex& vertex);
+    void upload(const Range& range);
+    std::vector<Geometry> outputs_;
+    // Where each output's images and strips start in uploaded_
+    std::vector<size_t> image_starts_;
+    std::vector<size_t> strip_starts_;
+    size_t image_count_;
+    size_t vertex_count_;
+    // vertex_count_ vertices followed by one unused one, as ofVbo reads a whole stride from
+    // each attribute, and the last vertex's texture coordinates and colour end before that
+    std::vector<Vertex> uploaded_;
+    // Ranges of uploaded_ changed since the last draw(), unless the whole VBO is to be rebuilt
+    std::vector<Range> changed_ranges_;
+    ofVbo vbo_;
+    bool layout_changed_;
+    bool has_texture_;
+    ofTextureData texture_data_;
+};
+
+#endif /* defined(__MediaPlayer_client__OutputBatch__) */
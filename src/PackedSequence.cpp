@@ -0,0 +1,350 @@
+//
+//  PackedSequence.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "PackedSequence.h"
+#include "Playlist.h"
+#include "FrameBufferPool.h"
+#include "LoadedFrame.h"
+#include <ofxHapImageSequence.h>
+#include <hap.h>
+#if !defined(TARGET_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+const char PackedSequence::Magic[8] = {'M', 'P', 'H', 'A', 'P', 'P', 'A', 'K'};
+
+/*
+ Frames start on multiples of this
+ */
+static const uint64_t FrameAlignment = 16;
+
+std::string PackedSequence::FileExtension()
+{
+    return "hpk";
+}
+
+bool PackedSequence::parseArguments(int argc, char *argv[], std::string& source, std::string& destination, unsigned int& chunks)
+{
+    bool found = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--pack" && i + 2 < argc)
+        {
+            source = argv[i + 1];
+            destination = argv[i + 2];
+            found = true;
+            i += 2;
+        }
+        else if (found && argument.compare(0, 7, "chunks=") == 0)
+        {
+            chunks = ofToInt(argument.substr(7));
+        }
+    }
+    return found;
+}
+
+/*
+ Compresses the frame in file again in chunks, keeping its .hpz header. Returns false if
+ the frame couldn't be decoded, leaving file unchanged.
+ */
+static bool rechunk(FrameBufferPool::Buffer& file, unsigned int chunks)
+{
+    LoadedFrame frame;
+    if (!frame.load(*file) || !frame.isDecoded())
+    {
+        return false;
+    }
+    size_t header_size = frame.getHeaderSize();
+    unsigned long length = HapMaxEncodedLength(frame.getDecodedSize(), frame.getTextureFormat(), chunks);
+    FrameBufferPool::Buffer rechunked = FrameBufferPool::getShared().acquire(header_size + length);
+    unsigned long used = 0;
+    unsigned int result = HapEncode(frame.getDecodedData(), frame.getDecodedSize(), frame.getTextureFormat(),
+                                    HapCompressorSnappy, chunks,
+                                    rechunked->getBinaryBuffer() + header_size, length, &used);
+    if (result != HapResult_No_Error)
+    {
+        return false;
+    }
+    memcpy(rechunked->getBinaryBuffer(), file->getBinaryBuffer(), header_size);
+    rechunked->allocate(header_size + used);
+    file = rechunked;
+    return true;
+}
+
+/*
+ Lists the frames of a sequence or playlist for pack()
+ */
+class PackSource {
+public:
+    PackSource(const std::string& path)
+    : is_playlist_(ofFilePath::getFileExt(path) == "xml")
+    {
+        if (is_playlist_)
+        {
+            playlist_.load(path);
+        }
+        else
+        {
+            sequence_.load(path);
+        }
+    }
+    unsigned int size() { return is_playlist_ ? playlist_.size() : sequence_.size(); }
+    std::string getPath(unsigned int index) { return is_playlist_ ? playlist_.getPath(index) : sequence_[index]; }
+private:
+    bool is_playlist_;
+    Playlist playlist_;
+    ofxHapImageSequence sequence_;
+};
+
+bool PackedSequence::pack(const std::string& source, const std::string& destination, unsigned int chunks)
+{
+    PackSource frames(source);
+    unsigned int count = frames.size();
+    if (count == 0)
+    {
+        ofLogError("PackedSequence") << "No frames found in " << source;
+        return false;
+    }
+    std::string path = ofToDataPath(destination, true);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+    {
+        ofLogError("PackedSequence") << "Unable to create " << path;
+        return false;
+    }
+
+    Header header;
+    memcpy(header.magic, Magic, sizeof(header.magic));
+    header.version = Version;
+    header.frame_count = count;
+    std::vector<Entry> entries(count);
+    /*
+     The table is written once the frames' offsets are known
+     */
+    uint64_t offset = sizeof(Header) + sizeof(Entry) * uint64_t(count);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&entries[0], sizeof(Entry), count, file) == count;
+
+    static const char padding[FrameAlignment] = {0};
+    for (unsigned int i = 0; i < count && ok; i++)
+    {
+        std::string frame_path = ofToDataPath(frames.getPath(i));
+        FILE *frame_file = fopen(frame_path.c_str(), "rb");
+        long size = -1;
+        if (frame_file && fseek(frame_file, 0, SEEK_END) == 0)
+        {
+            size = ftell(frame_file);
+            fseek(frame_file, 0, SEEK_SET);
+        }
+        if (size <= 0)
+        {
+            ofLogError("PackedSequence") << "Unable to read " << frame_path;
+            ok = false;
+        }
+        else
+        {
+            FrameBufferPool::Buffer buffer = FrameBufferPool::getShared().acquire(size);
+            ok = fread(buffer->getBinaryBuffer(), 1, size, frame_file) == size_t(size);
+            if (ok && chunks > 0 && !rechunk(buffer, chunks))
+            {
+                ofLogWarning("PackedSequence") << "Unable to re-chunk " << frame_path << ", packing it as it is";
+            }
+            size = buffer->size();
+            uint64_t padded = (offset + FrameAlignment - 1) & ~(FrameAlignment - 1);
+            ok = ok && fwrite(padding, 1, padded - offset, file) == padded - offset &&
+                fwrite(buffer->getBinaryBuffer(), 1, size, file) == size_t(size);
+            entries[i].offset = padded;
+            entries[i].size = size;
+            offset = padded + size;
+        }
+        if (frame_file)
+        {
+            fclose(frame_file);
+        }
+        if ((i + 1) % 1000 == 0)
+        {
+            ofLogNotice("PackedSequence") << "Packed " << i + 1 << " of " << count << " frames";
+        }
+    }
+    ok = ok && fseek(file, sizeof(Header), SEEK_SET) == 0 && fwrite(&entries[0], sizeof(Entry), count, file) == count;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        ofLogError("PackedSequence") << "Unable to write " << path;
+        ofFile::removeFile(path, false);
+        return false;
+    }
+    ofLogNotice("PackedSequence") << "Packed " << count << " frames from " << source << " to " << path;
+    return true;
+}
+
+PackedSequence::PackedSequence()
+: data_(NULL), length_(0), entries_(NULL), count_(0),
+#if defined(TARGET_WIN32)
+file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#else
+file_(-1)
+#endif
+{
+
+}
+
+PackedSequence::~PackedSequence()
+{
+    close();
+}
+
+bool PackedSequence::load(const std::string& path)
+{
+    close();
+    std::string full_path = ofToDataPath(path);
+#if defined(TARGET_WIN32)
+    file_ = CreateFileA(full_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER length;
+    if (file_ != INVALID_HANDLE_VALUE && GetFileSizeEx(file_, &length) && length.QuadPart > 0)
+    {
+        mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_)
+        {
+            data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+            length_ = length.QuadPart;
+        }
+    }
+#else
+    file_ = open(full_path.c_str(), O_RDONLY);
+    struct stat info;
+    if (file_ != -1 && fstat(file_, &info) == 0 && info.st_size > 0)
+    {
+        void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file_, 0);
+        if (mapped != MAP_FAILED)
+        {
+            data_ = static_cast<const char *>(mapped);
+            length_ = info.st_size;
+        }
+    }
+#endif
+    if (data_ == NULL)
+    {
+        ofLogError("PackedSequence") << "Unable to open " << full_path;
+        close();
+        return false;
+    }
+
+    /*
+     Check every entry now so frames can be looked up without checks later
+     */
+    const Header *header = reinterpret_cast<const Header *>(data_);
+    bool valid = length_ >= sizeof(Header) &&
+        memcmp(header->magic, Magic, sizeof(header->magic)) == 0 &&
+        header->version == Version &&
+        (length_ - sizeof(Header)) / sizeof(Entry) >= header->frame_count;
+    if (valid)
+    {
+        entries_ = reinterpret_cast<const Entry *>(data_ + sizeof(Header));
+        for (unsigned int i = 0; i < header->frame_count && valid; i++)
+        {
+            valid = entries_[i].offset <= length_ && entries_[i].size <= length_ - entries_[i].offset;
+        }
+    }
+    if (!valid)
+    {
+        ofLogError("PackedSequence") << full_path << " isn't a packed sequence we can read";
+        close();
+        return false;
+    }
+    count_ = header->frame_count;
+    return true;
+}
+
+void PackedSequence::close()
+{
+#if defined(TARGET_WIN32)
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+    }
+    if (file_ != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data_)
+    {
+        munmap(const_cast<char *>(data_), length_);
+    }
+    if (file_ != -1)
+    {
+        ::close(file_);
+        file_ = -1;
+    }
+#endif
+    data_ = NULL;
+    length_ = 0;
+    entries_ = NULL;
+    count_ = 0;
+}
+
+bool PackedSequence::isLoaded() const
+{
+    return data_ != NULL;
+}
+
+unsigned int PackedSequence::size() const
+{
+    return count_;
+}
+
+const char *PackedSequence::getFrameData(unsigned int index) const
+{
+    return data_ + entries_[index].offset;
+}
+
+size_t PackedSequence::getFrameSize(unsigned int index) const
+{
+    return entries_[index].size;
+}
+
+void PackedSequence::advise(unsigned int index, bool will_need) const
+{
+    if (index >= count_)
+    {
+        return;
+    }
+    uint64_t offset = entries_[index].offset;
+    uint64_t size = entries_[index].size;
+#if defined(TARGET_LINUX)
+    posix_fadvise(file_, offset, size, will_need ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+#elif defined(TARGET_OSX)
+    if (will_need)
+    {
+        struct radvisory advisory;
+        advisory.ra_offset = offset;
+        advisory.ra_count = int(std::min(size, uint64_t(INT_MAX)));
+        fcntl(file_, F_RDADVISE, &advisory);
+    }
+#else
+    if (will_need)
+    {
+        /*
+         Touch each page so it is read now rather than when the frame is loaded
+         */
+        volatile char sum = 0;
+        for (uint64_t i = 0; i < size; i += 4096)
+        {
+            sum += data_[offset + i];
+        }
+    }
+#endif
+}
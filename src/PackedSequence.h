@@ -0,0 +1,78 @@
+//
+//  PackedSequence.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__PackedSequence__
+#define __MediaPlayer_client__PackedSequence__
+
+#include "ofMain.h"
+
+/*
+ A Hap image sequence packed into a single file, so a sequence of thousands of frames costs
+ one open() and one file to copy.
+
+ The file is a Header, a table of one Entry per frame, then the frames' .hpz files
+ concatenated, each starting on a 16-byte boundary. Fields are little-endian. The file is
+ memory-mapped, so finding a frame is a table lookup and its bytes are read in place.
+ */
+class PackedSequence {
+public:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t frame_count;
+    };
+    struct Entry {
+        // From the start of the file
+        uint64_t offset;
+        uint64_t size;
+    };
+    static const char Magic[8];
+    static const uint32_t Version = 1;
+    static std::string FileExtension();
+
+    /*
+     Recognises --pack <source> <destination> [chunks=N], leaving chunks unchanged if absent
+     */
+    static bool parseArguments(int argc, char *argv[], std::string& source, std::string& destination, unsigned int& chunks);
+    /*
+     Packs a directory or .hpz frame of an image sequence, or every frame of an XML playlist.
+     If chunks isn't 0, each frame is decompressed and compressed again in that many chunks,
+     so it can be decompressed in parallel; the DXT data itself is unchanged.
+     */
+    static bool pack(const std::string& source, const std::string& destination, unsigned int chunks);
+
+    PackedSequence();
+    ~PackedSequence();
+    bool load(const std::string& path);
+    void close();
+    bool isLoaded() const;
+    unsigned int size() const;
+    /*
+     The frame's .hpz file, valid until the sequence is closed
+     */
+    const char *getFrameData(unsigned int index) const;
+    size_t getFrameSize(unsigned int index) const;
+    /*
+     Asks the OS to start reading the frame, or that it may be dropped from memory
+     */
+    void advise(unsigned int index, bool will_need) const;
+private:
+    // Not copyable
+    PackedSequence(const PackedSequence&);
+    PackedSequence& operator=(const PackedSequence&);
+    const char *data_;
+    uint64_t length_;
+    const Entry *entries_;
+    unsigned int count_;
+#if defined(TARGET_WIN32)
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int file_;
+#endif
+};
+
+#endif /* defined(__MediaPlayer_client__PackedSequence__) */
@@ -8,12 +8,50 @@
 
 #include "Playlist.h"
 
-Playlist::Playlist(std::string path)
+static std::string trim(const std::string& text)
+{
+    const char *whitespace = " \t\r\n";
+    std::string::size_type start = text.find_first_not_of(whitespace);
+    if (start == std::string::npos)
+    {
+        return std::string();
+    }
+    return text.substr(start, text.find_last_not_of(whitespace) - start + 1);
+}
+
+/*
+ Missing values are default_value. Surrounding whitespace and a leading + are allowed, as
+ they were when values were read with ofFromString(); anything else but digits is an error.
+ */
+static bool parseNumber(const std::string& text, unsigned int default_value, unsigned int& value)
+{
+    std::string trimmed = trim(text);
+    if (trimmed.empty())
+    {
+        value = default_value;
+        return true;
+    }
+    size_t start = trimmed[0] == '+' ? 1 : 0;
+    if (start >= trimmed.length() || !isdigit((unsigned char)trimmed[start]))
+    {
+        return false;
+    }
+    char *end = NULL;
+    unsigned long parsed = strtoul(trimmed.c_str() + start, &end, 10);
+    if (*end != 0 || parsed > UINT_MAX)
+    {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+Playlist::Playlist(std::string path) : size_(0)
 {
     load(path);
 }
 
-Playlist::Playlist()
+Playlist::Playlist() : size_(0)
 {
 
 }
@@ -25,42 +63,247 @@ Playlist::~Playlist()
 
 void Playlist::load(std::string path)
 {
-    paths_.clear();
+    entries_.clear();
+    offsets_.clear();
+    size_ = 0;
     base_ = ofFilePath::getEnclosingDirectory(path);
-    ofXml xml(path);
-    if (xml.setTo("playlist"))
+    FILE *file = fopen(ofToDataPath(path).c_str(), "rb");
+    if (file == NULL)
     {
-        if (xml.setToChild(0))
-        {
-            do {
-                std::string element_name = xml.getName();
-                if (element_name == "sequence")
+        ofLogError("Playlist") << "Unable to open " << path;
+        return;
+    }
+    PlaylistReader reader(file);
+    PlaylistReader::Element element;
+    std::string text;
+    std::string error;
+    // Elements open around the current position, outermost first
+    std::vector<std::string> open;
+    PlaylistReader::Element entry;
+    std::string entry_text;
+    unsigned int entry_line = 0;
+    bool has_playlist = false;
+    bool done = false;
+    while (!done)
+    {
+        unsigned int line = reader.getLine();
+        switch (reader.next(element, text, error)) {
+            case PlaylistReader::TokenStart:
+                if (open.empty() && element.name != "playlist")
                 {
-                    std::string sequence_base = xml.getValue();
-                    int digits = ofFromString<int>(xml.getAttribute("digits"));
-                    std::string suffix = xml.getAttribute("suffix");
-                    unsigned int count = ofFromString<unsigned int>(xml.getAttribute("count"));
-                    unsigned int start = ofFromString<unsigned int>(xml.getAttribute("start"));
-                    for (unsigned int i = 0; i < count; i++) {
-                        paths_.push_back(sequence_base + ofToString(start + i, digits, '0') + suffix);
+                    error = "Expected <playlist> but found <" + element.name + ">";
+                    done = true;
+                    break;
+                }
+                has_playlist = true;
+                if (open.size() == 1)
+                {
+                    if (element.name == "sequence" || element.name == "file")
+                    {
+                        entry = element;
+                        entry_text.clear();
+                        entry_line = line;
+                        if (element.empty)
+                        {
+                            addEntry(entry, entry_text, path, entry_line);
+                        }
+                    }
+                    else
+                    {
+                        ofLogWarning("Playlist") << path << ":" << line << ": Ignoring unknown element <" << element.name << ">";
                     }
                 }
-                else if (element_name == "file")
+                else if (open.size() == 2)
                 {
-                    paths_.push_back(xml.getValue());
+                    ofLogWarning("Playlist") << path << ":" << line << ": Ignoring <" << element.name << "> inside <" << open.back() << ">";
                 }
-            } while (xml.setToSibling());
+                if (!element.empty)
+                {
+                    open.push_back(element.name);
+                }
+                break;
+            case PlaylistReader::TokenEnd:
+                if (open.empty() || open.back() != element.name)
+                {
+                    error = "Unexpected </" + element.name + ">";
+                    done = true;
+                    break;
+                }
+                open.pop_back();
+                if (open.size() == 1 && (element.name == "sequence" || element.name == "file"))
+                {
+                    addEntry(entry, entry_text, path, entry_line);
+                }
+                break;
+            case PlaylistReader::TokenText:
+                if (open.size() == 2)
+                {
+                    entry_text += text;
+                }
+                break;
+            case PlaylistReader::TokenEndOfFile:
+                if (!open.empty())
+                {
+                    error = "Unexpected end of file inside <" + open.back() + ">";
+                }
+                else if (!has_playlist)
+                {
+                    error = "No <playlist> element";
+                }
+                done = true;
+                break;
+            case PlaylistReader::TokenError:
+                done = true;
+                break;
         }
+        if (!error.empty())
+        {
+            /*
+             Entries before the error are kept, so a truncated playlist still plays
+             */
+            ofLogError("Playlist") << path << ":" << reader.getLine() << ": " << error;
+        }
+    }
+    fclose(file);
+}
 
+void Playlist::addEntry(const PlaylistReader::Element& element, const std::string& text, const std::string& path, unsigned int line)
+{
+    Entry entry;
+    entry.base = trim(text);
+    unsigned int count = 0;
+    bool valid = !entry.base.empty();
+    if (element.name == "sequence")
+    {
+        entry.start = 0;
+        entry.suffix = element.getAttribute("suffix");
+        entry.is_sequence = true;
+        valid = valid &&
+            parseNumber(element.getAttribute("digits"), 0, entry.digits) &&
+            parseNumber(element.getAttribute("start"), 0, entry.start) &&
+            parseNumber(element.getAttribute("count"), 0, count) && count > 0;
+    }
+    else
+    {
+        entry.digits = 0;
+        entry.start = 0;
+        entry.is_sequence = false;
+        /*
+         A file may be held for a number of frames
+         */
+        valid = valid && parseNumber(element.getAttribute("hold"), 1, count) && count > 0;
     }
+    if (!valid)
+    {
+        ofLogWarning("Playlist") << path << ":" << line << ": Ignoring <" << element.name << "> without a path or with an invalid " <<
+            (element.name == "sequence" ? "digits, start or count" : "hold");
+        return;
+    }
+    entries_.push_back(entry);
+    offsets_.push_back(size_);
+    size_ += count;
+}
+
+bool Playlist::Entry::operator==(const Entry& other) const
+{
+    return base == other.base && is_sequence == other.is_sequence &&
+        (!is_sequence || (suffix == other.suffix && digits == other.digits && start == other.start));
+}
+
+unsigned int Playlist::getEntrySize(size_t entry) const
+{
+    return (entry + 1 < offsets_.size() ? offsets_[entry + 1] : size_) - offsets_[entry];
+}
+
+Playlist::Difference Playlist::compare(const Playlist& previous) const
+{
+    Difference difference;
+    size_t count = std::min(entries_.size(), previous.entries_.size());
+    size_t start = 0;
+    while (start < count && entries_[start] == previous.entries_[start] && getEntrySize(start) == previous.getEntrySize(start))
+    {
+        start++;
+    }
+    size_t end = 0;
+    while (end < count - start &&
+           entries_[entries_.size() - 1 - end] == previous.entries_[previous.entries_.size() - 1 - end] &&
+           getEntrySize(entries_.size() - 1 - end) == previous.getEntrySize(previous.entries_.size() - 1 - end))
+    {
+        end++;
+    }
+    difference.unchanged_start = start < entries_.size() ? offsets_[start] : size_;
+    difference.unchanged_end = end > 0 ? size_ - offsets_[entries_.size() - end] : 0;
+    return difference;
 }
 
-unsigned int Playlist::size()
+unsigned int Playlist::size() const
 {
-    return paths_.size();
+    return size_;
 }
 
 std::string Playlist::operator[](unsigned int index) const
 {
-    return paths_[index];
+    return getPath(index);
+}
+
+std::string Playlist::getPath(unsigned int index) const
+{
+    char buffer[1024];
+    size_t length = getPath(index, buffer, sizeof(buffer));
+    if (length < sizeof(buffer))
+    {
+        return std::string(buffer, length);
+    }
+    std::vector<char> large(length + 1);
+    getPath(index, &large[0], large.size());
+    return std::string(&large[0], length);
+}
+
+size_t Playlist::getPath(unsigned int index, char *buffer, size_t length) const
+{
+    if (index >= size_)
+    {
+        if (length > 0)
+        {
+            buffer[0] = 0;
+        }
+        return 0;
+    }
+    std::vector<unsigned int>::const_iterator found = std::upper_bound(offsets_.begin(), offsets_.end(), index) - 1;
+    const Entry& entry = entries_[found - offsets_.begin()];
+
+    /*
+     Build the path as base + zero-padded number + suffix
+     */
+    char number[16];
+    unsigned int number_length = 0;
+    if (entry.is_sequence)
+    {
+        unsigned int value = entry.start + (index - *found);
+        do {
+            number[sizeof(number) - ++number_length] = '0' + (value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (number_length < entry.digits && number_length < sizeof(number))
+        {
+            number[sizeof(number) - ++number_length] = '0';
+        }
+    }
+    const char *parts[3] = {entry.base.c_str(), number + sizeof(number) - number_length, entry.suffix.c_str()};
+    size_t part_lengths[3] = {entry.base.length(), number_length, entry.is_sequence ? entry.suffix.length() : 0};
+
+    size_t used = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (used < length)
+        {
+            memcpy(buffer + used, parts[i], std::min(part_lengths[i], length - used));
+        }
+        used += part_lengths[i];
+    }
+    if (length > 0)
+    {
+        buffer[std::min(used, length - 1)] = 0;
+    }
+    return used;
 }
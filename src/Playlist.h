@@ -10,17 +10,55 @@
 #define __MediaPlayer_client__Playlist__
 
 #include "ofMain.h"
+#include "FramePrefetcher.h"
+#include "PlaylistReader.h"
 
-class Playlist {
+/*
+ Entries are stored as loaded and paths are built on demand, so a sequence costs the
+ same however many frames it has.
+
+ The XML is parsed as it is read rather than into a document, so loading a playlist of a
+ million <file> entries needs little more memory than the entries themselves. Malformed
+ entries are skipped and logged with their line numbers.
+ */
+class Playlist : public FramePathSource {
 public:
     Playlist();
     Playlist(std::string path);
     ~Playlist();
     void load(std::string path);
-    unsigned int size();
+    unsigned int size() const;
     std::string operator [](unsigned int index) const;
+    std::string getPath(unsigned int index) const;
+    /*
+     Writes the path for index into buffer without allocating. Returns the length of the
+     path, which is only complete if it is less than length.
+     */
+    size_t getPath(unsigned int index, char *buffer, size_t length) const;
+    /*
+     The frames at the start and end which have the same paths in both playlists. The
+     frames between them, if any, have changed.
+     */
+    struct Difference {
+        unsigned int unchanged_start;
+        unsigned int unchanged_end;
+    };
+    Difference compare(const Playlist& previous) const;
 private:
-    std::vector<std::string> paths_;
+    void addEntry(const PlaylistReader::Element& element, const std::string& text, const std::string& path, unsigned int line);
+    struct Entry {
+        std::string base;
+        std::string suffix;
+        unsigned int digits;
+        unsigned int start;
+        bool is_sequence;
+        bool operator==(const Entry& other) const;
+    };
+    unsigned int getEntrySize(size_t entry) const;
+    std::vector<Entry> entries_;
+    // The first frame of each entry, ascending
+    std::vector<unsigned int> offsets_;
+    unsigned int size_;
     std::string base_;
 };
 
@@ -0,0 +1,336 @@
+//
+//  PlaylistReader.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "PlaylistReader.h"
+
+static const int EntityCount = 5;
+static const char *entities[EntityCount][2] = {
+    {"amp", "&"},
+    {"lt", "<"},
+    {"gt", ">"},
+    {"quot", "\""},
+    {"apos", "'"}
+};
+
+static bool isWhitespace(int c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string PlaylistReader::Element::getAttribute(const std::string& name) const
+{
+    for (std::vector<std::pair<std::string, std::string> >::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+        if (it->first == name)
+        {
+            return it->second;
+        }
+    }
+    return std::string();
+}
+
+PlaylistReader::PlaylistReader(FILE *file)
+: file_(file), buffer_(64 * 1024), position_(0), length_(0), line_(1)
+{
+
+}
+
+unsigned int PlaylistReader::getLine() const
+{
+    return line_;
+}
+
+bool PlaylistReader::fill()
+{
+    length_ = fread(&buffer_[0], 1, buffer_.size(), file_);
+    position_ = 0;
+    return length_ > 0;
+}
+
+int PlaylistReader::get()
+{
+    if (position_ == length_ && !fill())
+    {
+        return EOF;
+    }
+    char c = buffer_[position_++];
+    if (c == '\n')
+    {
+        line_++;
+    }
+    return (unsigned char)c;
+}
+
+int PlaylistReader::peek()
+{
+    if (position_ == length_ && !fill())
+    {
+        return EOF;
+    }
+    return (unsigned char)buffer_[position_];
+}
+
+bool PlaylistReader::readUntil(const char *terminator, std::string *text)
+{
+    size_t length = strlen(terminator);
+    std::string window;
+    int c;
+    while ((c = get()) != EOF)
+    {
+        if (text)
+        {
+            text->push_back(c);
+        }
+        window.push_back(c);
+        if (window.size() > length)
+        {
+            window.erase(0, 1);
+        }
+        if (window == terminator)
+        {
+            if (text)
+            {
+                text->resize(text->size() - length);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PlaylistReader::readName(std::string& name)
+{
+    name.clear();
+    int c;
+    while ((c = peek()) != EOF && !isWhitespace(c) && c != '/' && c != '>' && c != '=' && c != '<')
+    {
+        name.push_back(get());
+    }
+    return !name.empty();
+}
+
+void PlaylistReader::skipWhitespace()
+{
+    while (isWhitespace(peek()))
+    {
+        get();
+    }
+}
+
+PlaylistReader::Token PlaylistReader::next(Element& element, std::string& text, std::string& error)
+{
+    for (;;)
+    {
+        text.clear();
+        int c = peek();
+        if (c == EOF)
+        {
+            return TokenEndOfFile;
+        }
+        if (c != '<')
+        {
+            while ((c = peek()) != EOF && c != '<')
+            {
+                text.push_back(get());
+            }
+            if (!decodeReferences(text))
+            {
+                error = "Invalid character or entity reference";
+                return TokenError;
+            }
+            return TokenText;
+        }
+        get();
+        c = peek();
+        if (c == '?')
+        {
+            if (!readUntil("?>", NULL))
+            {
+                error = "Unterminated processing instruction";
+                return TokenError;
+            }
+            continue;
+        }
+        if (c == '!')
+        {
+            get();
+            std::string opening;
+            while (opening.size() < 7 && peek() != EOF && peek() != '>' && opening != "--")
+            {
+                opening.push_back(get());
+            }
+            if (opening == "--")
+            {
+                if (!readUntil("-->", NULL))
+                {
+                    error = "Unterminated comment";
+                    return TokenError;
+                }
+                continue;
+            }
+            if (opening == "[CDATA[")
+            {
+                if (!readUntil("]]>", &text))
+                {
+                    error = "Unterminated CDATA section";
+                    return TokenError;
+                }
+                return TokenText;
+            }
+            if (!readUntil(">", NULL))
+            {
+                error = "Unterminated declaration";
+                return TokenError;
+            }
+            continue;
+        }
+
+        element.attributes.clear();
+        element.empty = false;
+        bool is_end = c == '/';
+        if (is_end)
+        {
+            get();
+        }
+        if (!readName(element.name))
+        {
+            error = "Expected an element name";
+            return TokenError;
+        }
+        for (;;)
+        {
+            skipWhitespace();
+            c = get();
+            if (c == '>')
+            {
+                return is_end ? TokenEnd : TokenStart;
+            }
+            if (c == '/' && !is_end && peek() == '>')
+            {
+                get();
+                element.empty = true;
+                return TokenStart;
+            }
+            if (c == EOF || is_end)
+            {
+                error = "Unterminated tag <" + std::string(is_end ? "/" : "") + element.name + ">";
+                return TokenError;
+            }
+            std::pair<std::string, std::string> attribute;
+            attribute.first.push_back(c);
+            std::string rest;
+            readName(rest);
+            attribute.first += rest;
+            skipWhitespace();
+            if (get() != '=')
+            {
+                error = "Expected = after attribute " + attribute.first;
+                return TokenError;
+            }
+            skipWhitespace();
+            int quote = get();
+            if (quote != '"' && quote != '\'')
+            {
+                error = "Expected a quoted value for attribute " + attribute.first;
+                return TokenError;
+            }
+            while ((c = get()) != quote)
+            {
+                if (c == EOF || c == '<')
+                {
+                    error = "Unterminated value for attribute " + attribute.first;
+                    return TokenError;
+                }
+                attribute.second.push_back(c);
+            }
+            if (!decodeReferences(attribute.second))
+            {
+                error = "Invalid character or entity reference in attribute " + attribute.first;
+                return TokenError;
+            }
+            element.attributes.push_back(attribute);
+        }
+    }
+}
+
+bool PlaylistReader::decodeReferences(std::string& text)
+{
+    size_t ampersand = text.find('&');
+    if (ampersand == std::string::npos)
+    {
+        return true;
+    }
+    std::string decoded(text, 0, ampersand);
+    size_t position = ampersand;
+    while (position < text.length())
+    {
+        if (text[position] != '&')
+        {
+            decoded.push_back(text[position++]);
+            continue;
+        }
+        size_t semicolon = text.find(';', position);
+        if (semicolon == std::string::npos)
+        {
+            return false;
+        }
+        std::string name(text, position + 1, semicolon - position - 1);
+        position = semicolon + 1;
+        const char *entity = NULL;
+        for (int i = 0; i < EntityCount; i++)
+        {
+            if (name == entities[i][0])
+            {
+                entity = entities[i][1];
+            }
+        }
+        if (entity)
+        {
+            decoded.append(entity);
+        }
+        else if (name.length() > 1 && name[0] == '#')
+        {
+            bool hex = name[1] == 'x';
+            std::string digits(name, hex ? 2 : 1);
+            char *end = NULL;
+            unsigned long code = strtoul(digits.c_str(), &end, hex ? 16 : 10);
+            if (digits.empty() || *end != 0 || code == 0 || code > 0x10FFFF)
+            {
+                return false;
+            }
+            /*
+             Encode as UTF-8
+             */
+            if (code < 0x80)
+            {
+                decoded.push_back(char(code));
+            }
+            else if (code < 0x800)
+            {
+                decoded.push_back(char(0xC0 | (code >> 6)));
+                decoded.push_back(char(0x80 | (code & 0x3F)));
+            }
+            else if (code < 0x10000)
+            {
+                decoded.push_back(char(0xE0 | (code >> 12)));
+                decoded.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+                decoded.push_back(char(0x80 | (code & 0x3F)));
+            }
+            else
+            {
+                decoded.push_back(char(0xF0 | (code >> 18)));
+                decoded.push_back(char(0x80 | ((code >> 12) & 0x3F)));
+                decoded.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+                decoded.push_back(char(0x80 | (code & 0x3F)));
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    text.swap(decoded);
+    return true;
+}
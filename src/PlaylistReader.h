@@ -0,0 +1,67 @@
+//
+//  PlaylistReader.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__PlaylistReader__
+#define __MediaPlayer_client__PlaylistReader__
+
+#include "ofMain.h"
+
+/*
+ Reads XML a buffer at a time, returning one start tag, end tag or run of text per call,
+ so memory use doesn't grow with the size of the file.
+
+ It understands as much XML as playlists use: elements, attributes, character and entity
+ references, CDATA, comments, processing instructions and a DOCTYPE without an internal
+ subset. Nesting is left to the caller.
+ */
+class PlaylistReader {
+public:
+    enum Token {
+        TokenStart,
+        TokenEnd,
+        TokenText,
+        TokenEndOfFile,
+        TokenError
+    };
+    struct Element {
+        std::string name;
+        std::vector<std::pair<std::string, std::string> > attributes;
+        // A start tag which closes itself, eg <file/>
+        bool empty;
+        /*
+         Returns an empty string if the attribute isn't present
+         */
+        std::string getAttribute(const std::string& name) const;
+    };
+    PlaylistReader(FILE *file);
+    /*
+     Fills element for start and end tags, text for text, and error for errors
+     */
+    Token next(Element& element, std::string& text, std::string& error);
+    /*
+     The line of the next character to be read, from 1
+     */
+    unsigned int getLine() const;
+private:
+    int get();
+    int peek();
+    bool fill();
+    /*
+     Consumes characters up to and including terminator, appending those before it to text
+     if it isn't NULL. Returns false if the file ends first.
+     */
+    bool readUntil(const char *terminator, std::string *text);
+    bool readName(std::string& name);
+    void skipWhitespace();
+    static bool decodeReferences(std::string& text);
+    FILE *file_;
+    std::vector<char> buffer_;
+    size_t position_;
+    size_t length_;
+    unsigned int line_;
+};
+
+#endif /* defined(__MediaPlayer_client__PlaylistReader__) */
@@ -0,0 +1,112 @@
+//
+//  SettingsWriter.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "SettingsWriter.h"
+#if defined(TARGET_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+SettingsWriter::SettingsWriter()
+: has_pending_(false), running_(false)
+{
+
+}
+
+SettingsWriter::~SettingsWriter()
+{
+    close();
+}
+
+void SettingsWriter::setup(const std::string& path)
+{
+    close();
+    path_ = ofToDataPath(path, true);
+    running_ = true;
+    startThread();
+}
+
+void SettingsWriter::write(const std::string& contents)
+{
+    ofScopedLock lock(mutex_);
+    pending_ = contents;
+    has_pending_ = true;
+    condition_.signal();
+}
+
+void SettingsWriter::close()
+{
+    mutex_.lock();
+    running_ = false;
+    condition_.signal();
+    mutex_.unlock();
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+}
+
+void SettingsWriter::threadedFunction()
+{
+    mutex_.lock();
+    for (;;)
+    {
+        if (has_pending_)
+        {
+            std::string contents;
+            contents.swap(pending_);
+            has_pending_ = false;
+            mutex_.unlock();
+            if (!save(contents))
+            {
+                ofLogError("SettingsWriter") << "Unable to save " << path_;
+            }
+            mutex_.lock();
+        }
+        else if (running_)
+        {
+            condition_.wait(mutex_);
+        }
+        else
+        {
+            break;
+        }
+    }
+    mutex_.unlock();
+}
+
+bool SettingsWriter::save(const std::string& contents)
+{
+    std::string temporary_path = path_ + ".tmp";
+    FILE *file = fopen(temporary_path.c_str(), "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool result = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    result = fflush(file) == 0 && result;
+#if !defined(TARGET_WIN32)
+    /*
+     Make sure the contents are on disk before the rename is
+     */
+    result = fsync(fileno(file)) == 0 && result;
+#endif
+    fclose(file);
+    if (result)
+    {
+#if defined(TARGET_WIN32)
+        result = MoveFileExA(temporary_path.c_str(), path_.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+        result = rename(temporary_path.c_str(), path_.c_str()) == 0;
+#endif
+    }
+    if (!result)
+    {
+        remove(temporary_path.c_str());
+    }
+    return result;
+}
@@ -0,0 +1,39 @@
+//
+//  SettingsWriter.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__SettingsWriter__
+#define __MediaPlayer_client__SettingsWriter__
+
+#include "ofMain.h"
+
+/*
+ Writes settings on a background thread. Each write replaces the file atomically by writing
+ a temporary file and renaming it over the original. If several snapshots are passed before
+ the thread gets to them, only the latest is written.
+ */
+class SettingsWriter : public ofThread {
+public:
+    SettingsWriter();
+    ~SettingsWriter();
+    void setup(const std::string& path);
+    void write(const std::string& contents);
+    /*
+     Blocks until any pending snapshot has been written, then stops the thread.
+     */
+    void close();
+protected:
+    void threadedFunction();
+private:
+    bool save(const std::string& contents);
+    ofMutex mutex_;
+    Poco::Condition condition_;
+    std::string path_;
+    std::string pending_;
+    bool has_pending_;
+    bool running_;
+};
+
+#endif /* defined(__MediaPlayer_client__SettingsWriter__) */
@@ -0,0 +1,672 @@
+//
+//  SharedFrameCache.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "SharedFrameCache.h"
+#if !defined(TARGET_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/file.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char Magic[8] = {'M', 'P', 'F', 'R', 'A', 'M', 'E', 'S'};
+static const uint32_t Version = 2;
+/*
+ Holds are kept as a bit per process
+ */
+static const unsigned int MaximumProcesses = 32;
+static const size_t PageSize = 4096;
+// The keys each process last asked for
+static const unsigned int KeysPerProcess = 2;
+/*
+ How long a published frame is kept for processes which haven't used it yet, and how often
+ to look for processes which have gone
+ */
+static const uint64_t PendingTimeout = 1000000;
+static const uint64_t ReapInterval = 1000000;
+
+enum SlotState {
+    SlotEmpty,
+    SlotWriting,
+    SlotReady
+};
+
+/*
+ Everything but ready and lock is only read or written with lock held. ready is set once
+ the creator has filled in the rest.
+ */
+struct SharedFrameCache::Header {
+    char magic[8];
+    std::atomic<uint32_t> ready;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t padding;
+    uint64_t slot_size;
+    // The process ID holding the lock, or 0
+    std::atomic<int32_t> lock;
+    // Process IDs by index, or 0
+    int32_t processes[MaximumProcesses];
+    // The keys each process last asked for, most recent first, so frames are only kept
+    // for processes showing the same source
+    uint64_t keys[MaximumProcesses][KeysPerProcess];
+    // Ticks on every use, for least recently used eviction
+    uint64_t clock;
+};
+
+struct SharedFrameCache::Slot {
+    uint32_t state;
+    // Process index filling the slot
+    uint32_t writer;
+    uint64_t key;
+    uint32_t frame;
+    // Bits of processes using the slot's data
+    uint32_t holders;
+    // Bits of processes asking for the key which haven't used the published frame yet
+    uint32_t pending;
+    uint32_t padding;
+    uint64_t size;
+    uint64_t tag;
+    uint64_t used;
+    uint64_t published;
+};
+
+#if !defined(TARGET_WIN32)
+static bool isProcessAlive(int32_t pid)
+{
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+#endif
+
+SharedFrameCache::Reference::Reference()
+: slot(-1), data(NULL), size(0), tag(0)
+{ }
+
+SharedFrameCache::SharedFrameCache()
+: slot_count_(0), slot_size_(0), fd_(-1), segment_(NULL), segment_size_(0), header_(NULL), process_index_(-1),
+last_reap_(0), hits_(0), publishes_(0)
+{
+
+}
+
+SharedFrameCache::~SharedFrameCache()
+{
+    close();
+}
+
+bool SharedFrameCache::setup(const std::string& name, unsigned int slot_count, size_t slot_size)
+{
+    close();
+#if defined(TARGET_WIN32)
+    ofLogError("SharedFrameCache") << "Shared frame caches aren't available on this platform";
+    return false;
+#else
+    name_ = name;
+    slot_count_ = std::max(slot_count, 1U);
+    slot_size_ = ((std::max(slot_size, size_t(1)) + PageSize - 1) / PageSize) * PageSize;
+    int lock_fd = lockFile();
+    /*
+     A segment left with another geometry by processes which have all gone is replaced
+     */
+    if (!map(true) && !map(false))
+    {
+        unlockFile(lock_fd);
+        close();
+        return false;
+    }
+
+    lock();
+    reapProcesses();
+    for (unsigned int i = 0; i < MaximumProcesses && process_index_ < 0; i++)
+    {
+        if (header_->processes[i] == 0)
+        {
+            header_->processes[i] = getpid();
+            memset(header_->keys[i], 0, sizeof(header_->keys[i]));
+            process_index_ = i;
+            holds_.assign(slot_count_, 0);
+        }
+    }
+    unlock();
+    unlockFile(lock_fd);
+    if (process_index_ < 0)
+    {
+        ofLogError("SharedFrameCache") << name_ << " already has " << MaximumProcesses << " processes";
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void SharedFrameCache::close()
+{
+#if !defined(TARGET_WIN32)
+    if (header_ != NULL && process_index_ >= 0)
+    {
+        uint32_t bit = 1U << process_index_;
+        int lock_fd = lockFile();
+        lock();
+        for (unsigned int i = 0; i < slot_count_; i++)
+        {
+            Slot& slot = getSlot(i);
+            slot.holders &= ~bit;
+            slot.pending &= ~bit;
+            if (slot.state == SlotWriting && slot.writer == uint32_t(process_index_))
+            {
+                slot.state = SlotEmpty;
+            }
+        }
+        header_->processes[process_index_] = 0;
+        reapProcesses();
+        bool last = true;
+        for (unsigned int i = 0; i < MaximumProcesses; i++)
+        {
+            if (header_->processes[i] != 0)
+            {
+                last = false;
+            }
+        }
+        unlock();
+        /*
+         Nobody can open the segment while the file is locked, so it can be removed safely
+         */
+        if (last)
+        {
+            shm_unlink(("/" + name_).c_str());
+        }
+        unlockFile(lock_fd);
+    }
+    process_index_ = -1;
+    holds_.clear();
+    unmap();
+#endif
+}
+
+bool SharedFrameCache::isOpen() const
+{
+    return process_index_ >= 0;
+}
+
+SharedFrameCache::Result SharedFrameCache::acquire(uint64_t key, unsigned int frame, size_t size, Reference& reference, uint64_t wait_micros)
+{
+    if (!isOpen() || size > slot_size_)
+    {
+        return Miss;
+    }
+    uint32_t bit = 1U << process_index_;
+    uint64_t start = getTime();
+    bool reaped = false;
+    while (true)
+    {
+        uint64_t now = getTime();
+        lock();
+        uint64_t *keys = header_->keys[process_index_];
+        if (keys[0] != key)
+        {
+            memmove(keys + 1, keys, (KeysPerProcess - 1) * sizeof(uint64_t));
+            keys[0] = key;
+        }
+        if (now - last_reap_ >= ReapInterval)
+        {
+            reapProcesses();
+            last_reap_ = now;
+        }
+        bool waiting = false;
+        for (unsigned int i = 0; i < slot_count_; i++)
+        {
+            Slot& slot = getSlot(i);
+            if (slot.state == SlotEmpty || slot.key != key || slot.frame != frame)
+            {
+                continue;
+            }
+            if (slot.state == SlotReady)
+            {
+                slot.holders |= bit;
+                holds_[i]++;
+                slot.pending &= ~bit;
+                slot.used = ++header_->clock;
+                reference.slot = i;
+                reference.data = getSlotData(i);
+                reference.size = slot.size;
+                reference.tag = slot.tag;
+                unlock();
+                hits_++;
+                return Hit;
+            }
+            waiting = slot.writer != uint32_t(process_index_);
+            break;
+        }
+        if (waiting)
+        {
+            unlock();
+            /*
+             Another process is filling the frame, which is usually quicker than filling
+             it ourselves
+             */
+            if (now - start >= wait_micros)
+            {
+                return Miss;
+            }
+            ofSleepMillis(1);
+            continue;
+        }
+
+        /*
+         Take an empty slot, else the least recently used one nobody needs, else the least
+         recently used one which processes have been slow to use
+         */
+        int victim = -1;
+        int stale = -1;
+        for (unsigned int i = 0; i < slot_count_; i++)
+        {
+            Slot& slot = getSlot(i);
+            if (slot.state == SlotEmpty)
+            {
+                victim = i;
+                break;
+            }
+            if (slot.state != SlotReady || slot.holders != 0)
+            {
+                continue;
+            }
+            if (slot.pending == 0)
+            {
+                if (victim < 0 || slot.used < getSlot(victim).used)
+                {
+                    victim = i;
+                }
+            }
+            else if (now - slot.published >= PendingTimeout && (stale < 0 || slot.used < getSlot(stale).used))
+            {
+                stale = i;
+            }
+        }
+        if (victim < 0)
+        {
+            victim = stale;
+        }
+        if (victim < 0 && !reaped)
+        {
+            /*
+             Slots may be waiting on a process which has gone
+             */
+            reapProcesses();
+            last_reap_ = now;
+            reaped = true;
+            unlock();
+            continue;
+        }
+        if (victim < 0)
+        {
+            unlock();
+            return Miss;
+        }
+        Slot& slot = getSlot(victim);
+        slot.state = SlotWriting;
+        slot.writer = process_index_;
+        slot.key = key;
+        slot.frame = frame;
+        slot.holders = 0;
+        slot.pending = 0;
+        slot.size = size;
+        slot.tag = 0;
+        slot.used = ++header_->clock;
+        unlock();
+        reference.slot = victim;
+        reference.data = getSlotData(victim);
+        reference.size = size;
+        reference.tag = 0;
+        return Reserved;
+    }
+}
+
+void SharedFrameCache::publish(const Reference& reference)
+{
+    if (!isOpen() || reference.slot < 0 || reference.slot >= int(slot_count_))
+    {
+        return;
+    }
+    lock();
+    Slot& slot = getSlot(reference.slot);
+    if (slot.state == SlotWriting && slot.writer == uint32_t(process_index_))
+    {
+        slot.state = SlotReady;
+        slot.tag = reference.tag;
+        slot.published = getTime();
+        slot.holders = 1U << process_index_;
+        holds_[reference.slot] = 1;
+        slot.pending = 0;
+        for (unsigned int i = 0; i < MaximumProcesses; i++)
+        {
+            if (header_->processes[i] == 0 || int(i) == process_index_)
+            {
+                continue;
+            }
+            for (unsigned int j = 0; j < KeysPerProcess; j++)
+            {
+                if (header_->keys[i][j] == slot.key)
+                {
+                    slot.pending |= 1U << i;
+                }
+            }
+        }
+        publishes_++;
+    }
+    unlock();
+}
+
+void SharedFrameCache::release(const Reference& reference)
+{
+    if (!isOpen() || reference.slot < 0 || reference.slot >= int(slot_count_))
+    {
+        return;
+    }
+    lock();
+    Slot& slot = getSlot(reference.slot);
+    if (slot.state == SlotWriting && slot.writer == uint32_t(process_index_))
+    {
+        slot.state = SlotEmpty;
+    }
+    else if (holds_[reference.slot] > 0 && --holds_[reference.slot] == 0)
+    {
+        slot.holders &= ~(1U << process_index_);
+    }
+    unlock();
+}
+
+unsigned long SharedFrameCache::getHitCount() const
+{
+    return hits_;
+}
+
+unsigned long SharedFrameCache::getPublishCount() const
+{
+    return publishes_;
+}
+
+unsigned int SharedFrameCache::getProcessCount() const
+{
+    if (!isOpen())
+    {
+        return 0;
+    }
+    unsigned int count = 0;
+    lock();
+    for (unsigned int i = 0; i < MaximumProcesses; i++)
+    {
+        if (header_->processes[i] != 0)
+        {
+            count++;
+        }
+    }
+    unlock();
+    return count;
+}
+
+std::string SharedFrameCache::getName() const
+{
+    return name_;
+}
+
+uint64_t SharedFrameCache::getMemoryUsage() const
+{
+    return isOpen() ? segment_size_ : 0;
+}
+
+bool SharedFrameCache::getEvictionCandidate(uint64_t& bytes, double& value) const
+{
+    return false;
+}
+
+void SharedFrameCache::evictCandidate()
+{
+
+}
+
+size_t SharedFrameCache::getSegmentSize(unsigned int slot_count, size_t slot_size)
+{
+    size_t table = sizeof(Header) + slot_count * sizeof(Slot);
+    return ((table + PageSize - 1) / PageSize) * PageSize + slot_count * slot_size;
+}
+
+/*
+ Microseconds on a clock shared by every process on the host
+ */
+uint64_t SharedFrameCache::getTime()
+{
+#if defined(TARGET_WIN32)
+    return ofGetElapsedTimeMicros();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+/*
+ With create, makes a new segment unless one exists. Otherwise opens the existing one,
+ replacing it if it has another geometry and no process is using it. Called with the lock
+ file held.
+ */
+bool SharedFrameCache::map(bool create)
+{
+#if defined(TARGET_WIN32)
+    return false;
+#else
+    std::string path = "/" + name_;
+    size_t size = getSegmentSize(slot_count_, slot_size_);
+    if (create)
+    {
+        fd_ = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd_ < 0)
+        {
+            return false;
+        }
+        if (ftruncate(fd_, size) != 0)
+        {
+            ofLogError("SharedFrameCache") << "Unable to size " << name_ << " to " << size << " bytes";
+            shm_unlink(path.c_str());
+            unmap();
+            return false;
+        }
+        segment_ = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (segment_ == MAP_FAILED)
+        {
+            segment_ = NULL;
+            shm_unlink(path.c_str());
+            unmap();
+            return false;
+        }
+        segment_size_ = size;
+        header_ = static_cast<Header *>(segment_);
+        memcpy(header_->magic, Magic, sizeof(Magic));
+        header_->version = Version;
+        header_->slot_count = slot_count_;
+        header_->slot_size = slot_size_;
+        header_->ready.store(1, std::memory_order_release);
+        return true;
+    }
+
+    fd_ = shm_open(path.c_str(), O_RDWR, 0600);
+    if (fd_ < 0)
+    {
+        ofLogError("SharedFrameCache") << "Unable to open " << name_;
+        return false;
+    }
+    /*
+     The segment is created with the lock file held, so it is complete unless its creator
+     died while filling it in
+     */
+    struct stat info;
+    if (fstat(fd_, &info) == 0 && size_t(info.st_size) >= sizeof(Header))
+    {
+        segment_ = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    }
+    if (segment_ == NULL || segment_ == MAP_FAILED)
+    {
+        segment_ = NULL;
+        ofLogError("SharedFrameCache") << "Unable to map " << name_;
+        unmap();
+        return false;
+    }
+    segment_size_ = info.st_size;
+    header_ = static_cast<Header *>(segment_);
+    bool matches = header_->ready.load(std::memory_order_acquire) != 0 &&
+        memcmp(header_->magic, Magic, sizeof(Magic)) == 0 && header_->version == Version &&
+        header_->slot_count == slot_count_ && header_->slot_size == slot_size_ && segment_size_ == size;
+    if (matches)
+    {
+        return true;
+    }
+    bool in_use = false;
+    if (header_->ready.load(std::memory_order_acquire) != 0 && memcmp(header_->magic, Magic, sizeof(Magic)) == 0)
+    {
+        for (unsigned int i = 0; i < MaximumProcesses; i++)
+        {
+            if (header_->processes[i] != 0 && isProcessAlive(header_->processes[i]))
+            {
+                in_use = true;
+            }
+        }
+    }
+    unmap();
+    if (in_use)
+    {
+        ofLogError("SharedFrameCache") << name_ << " is in use with a different number or size of slots";
+        return false;
+    }
+    ofLogNotice("SharedFrameCache") << "Replacing " << name_ << ", left with a different number or size of slots";
+    shm_unlink(path.c_str());
+    return map(true);
+#endif
+}
+
+void SharedFrameCache::unmap()
+{
+#if !defined(TARGET_WIN32)
+    if (segment_ != NULL)
+    {
+        munmap(segment_, segment_size_);
+        segment_ = NULL;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+    header_ = NULL;
+    segment_size_ = 0;
+}
+
+/*
+ Locks a file named after the segment, returning its descriptor, or -1 if it couldn't be
+ locked, in which case opening and closing aren't serialised
+ */
+int SharedFrameCache::lockFile() const
+{
+#if defined(TARGET_WIN32)
+    return -1;
+#else
+    std::string path = "/tmp/" + name_ + ".lock";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        ofLogWarning("SharedFrameCache") << "Unable to open " << path;
+        return -1;
+    }
+    while (flock(fd, LOCK_EX) != 0 && errno == EINTR)
+    {
+
+    }
+    return fd;
+#endif
+}
+
+void SharedFrameCache::unlockFile(int fd) const
+{
+#if !defined(TARGET_WIN32)
+    if (fd >= 0)
+    {
+        flock(fd, LOCK_UN);
+        ::close(fd);
+    }
+#endif
+}
+
+/*
+ Critical sections are a few hundred instructions, so the lock spins. A lock held by a
+ process which has gone is taken over.
+ */
+void SharedFrameCache::lock() const
+{
+#if !defined(TARGET_WIN32)
+    int32_t pid = getpid();
+    unsigned int spins = 0;
+    int32_t holder = 0;
+    while (!header_->lock.compare_exchange_weak(holder, pid, std::memory_order_acquire))
+    {
+        if (holder != 0 && ++spins % 10000 == 0 && !isProcessAlive(holder))
+        {
+            header_->lock.compare_exchange_strong(holder, 0, std::memory_order_relaxed);
+        }
+        holder = 0;
+        sched_yield();
+    }
+#endif
+}
+
+void SharedFrameCache::unlock() const
+{
+    header_->lock.store(0, std::memory_order_release);
+}
+
+/*
+ Releases everything held by processes which exited without closing. Called with the lock
+ held.
+ */
+void SharedFrameCache::reapProcesses()
+{
+#if !defined(TARGET_WIN32)
+    for (unsigned int i = 0; i < MaximumProcesses; i++)
+    {
+        int32_t pid = header_->processes[i];
+        if (pid == 0 || int(i) == process_index_ || isProcessAlive(pid))
+        {
+            continue;
+        }
+        uint32_t bit = 1U << i;
+        for (unsigned int j = 0; j < slot_count_; j++)
+        {
+            Slot& slot = getSlot(j);
+            slot.holders &= ~bit;
+            slot.pending &= ~bit;
+            if (slot.state == SlotWriting && slot.writer == i)
+            {
+                slot.state = SlotEmpty;
+            }
+        }
+        header_->processes[i] = 0;
+        memset(header_->keys[i], 0, sizeof(header_->keys[i]));
+    }
+#endif
+}
+
+SharedFrameCache::Slot& SharedFrameCache::getSlot(unsigned int index) const
+{
+    return reinterpret_cast<Slot *>(header_ + 1)[index];
+}
+
+unsigned char *SharedFrameCache::getSlotData(unsigned int index) const
+{
+    size_t table = sizeof(Header) + slot_count_ * sizeof(Slot);
+    return static_cast<unsigned char *>(segment_) + ((table + PageSize - 1) / PageSize) * PageSize + index * slot_size_;
+}
@@ -0,0 +1,105 @@
+//
+//  SharedFrameCache.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__SharedFrameCache__
+#define __MediaPlayer_client__SharedFrameCache__
+
+#include "ofMain.h"
+#include "MemoryGovernor.h"
+#include <atomic>
+
+/*
+ A cache of decompressed frames in shared memory, used by every client process on a host
+ which opens it by the same name, so a frame shown by several processes is read and
+ decompressed by only one of them.
+
+ The first process to want a frame reserves a slot, fills it and publishes it. Processes
+ wanting the same frame meanwhile wait for it to be published, then use it in place.
+ A slot isn't reused while any process holds it, nor until every process which recently
+ asked for frames of the same source has used it or a second has passed. Processes which
+ exit without closing the cache are found and their holds released.
+
+ The segment is sized by the first process to open it; later processes must ask for the
+ same geometry. Opening and closing are serialised between processes by a lock file, and
+ the last process to close the cache removes the segment. Only available on Linux and OS X.
+
+ As a MemoryConsumer the whole segment is counted, so the memory budget allows for it, but
+ nothing is evicted as other processes may be using it.
+ */
+class SharedFrameCache : public MemoryConsumer {
+public:
+    enum Result {
+        // reference is a published frame to read, then release()
+        Hit,
+        // reference is a slot to fill, then publish() and release() once done reading it,
+        // or release() alone to abandon it
+        Reserved,
+        // Nothing cached and no slot free; decode privately
+        Miss
+    };
+    struct Reference {
+        Reference();
+        int slot;
+        unsigned char *data;
+        size_t size;
+        // Stored with the frame by its publisher
+        uint64_t tag;
+    };
+    SharedFrameCache();
+    ~SharedFrameCache();
+    /*
+     Opens or creates the segment name, with slot_count slots of slot_size bytes each.
+     Returns false if it couldn't be opened or has a different geometry.
+     */
+    bool setup(const std::string& name, unsigned int slot_count, size_t slot_size);
+    void close();
+    bool isOpen() const;
+    /*
+     Looks for frame of the source identified by key, waiting up to wait_micros if another
+     process is filling it, and otherwise reserves a slot for a frame of size bytes. Safe to
+     call from any thread.
+     */
+    Result acquire(uint64_t key, unsigned int frame, size_t size, Reference& reference, uint64_t wait_micros);
+    void publish(const Reference& reference);
+    void release(const Reference& reference);
+    unsigned long getHitCount() const;
+    unsigned long getPublishCount() const;
+    unsigned int getProcessCount() const;
+    std::string getName() const;
+    uint64_t getMemoryUsage() const;
+    bool getEvictionCandidate(uint64_t& bytes, double& value) const;
+    void evictCandidate();
+private:
+    struct Header;
+    struct Slot;
+    static size_t getSegmentSize(unsigned int slot_count, size_t slot_size);
+    static uint64_t getTime();
+    bool map(bool create);
+    void unmap();
+    int lockFile() const;
+    void unlockFile(int fd) const;
+    void lock() const;
+    void unlock() const;
+    void reapProcesses();
+    Slot& getSlot(unsigned int index) const;
+    unsigned char *getSlotData(unsigned int index) const;
+
+    std::string name_;
+    unsigned int slot_count_;
+    size_t slot_size_;
+    int fd_;
+    void *segment_;
+    size_t segment_size_;
+    Header *header_;
+    int process_index_;
+    // How many references this process holds to each slot, only used with the lock held
+    std::vector<unsigned int> holds_;
+    uint64_t last_reap_;
+    std::atomic<unsigned long> hits_;
+    std::atomic<unsigned long> publishes_;
+};
+
+#endif /* defined(__MediaPlayer_client__SharedFrameCache__) */
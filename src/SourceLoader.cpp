@@ -0,0 +1,445 @@
+//
+//  SourceLoader.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "SourceLoader.h"
+#include "Tracer.h"
+#include "FrameFingerprint.h"
+#include <sys/stat.h>
+#if defined(TARGET_LINUX)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/*
+ Milliseconds between checks of a watched file
+ */
+static const long WatchInterval = 250;
+/*
+ Microseconds to wait for a changed file to stop changing before reloading it
+ */
+static const uint64_t ReloadDelay = 500000;
+
+SourceLoader::Source::Source(const std::string& p, StageTimings *t, SharedFrameCache *c)
+: path(p), type(TypeMovie), timings(t), shared_cache(c), shared_key(0)
+{
+
+}
+
+/*
+ Processes sharing frames agree on a source by its path, type, length and modification
+ time, so an edited playlist isn't confused with its previous version
+ */
+static uint64_t getSharedKey(const SourceLoader::Source& source)
+{
+    std::string full_path = ofToDataPath(source.path, true);
+    std::string description = full_path + ":" + ofToString(source.type) + ":" + ofToString(source.size());
+    struct stat info;
+    if (stat(full_path.c_str(), &info) == 0)
+    {
+        description += ":" + ofToString(info.st_mtime) + ":" + ofToString(info.st_size);
+    }
+    return FrameFingerprint::hash(description.data(), description.size());
+}
+
+unsigned int SourceLoader::Source::size() const
+{
+    switch (type) {
+        case TypeSequence:
+            return sequence.size();
+        case TypePlaylist:
+            return playlist.size();
+        case TypePacked:
+            return packed.size();
+        default:
+            return movie_index.size();
+    }
+}
+
+std::string SourceLoader::Source::getPath(unsigned int index) const
+{
+    switch (type) {
+        case TypeSequence:
+            return sequence[index];
+        case TypePlaylist:
+            if (timings)
+            {
+                StageTimings::Scope scope(*timings, StageTimings::StagePlaylistLookup);
+                return playlist.getPath(index);
+            }
+            return playlist.getPath(index);
+        default:
+            return path;
+    }
+}
+
+std::shared_ptr<LoadedFrame> SourceLoader::Source::loadFrame(unsigned int index) const
+{
+    if (type == TypePacked)
+    {
+        return FramePrefetcher::loadFrame(packed.getFrameData(index), packed.getFrameSize(index), shared_cache, shared_key, index);
+    }
+    return FramePrefetcher::loadFrame(getPath(index), shared_cache, shared_key, index);
+}
+
+bool SourceLoader::Source::advise(unsigned int index, bool will_need) const
+{
+    if (type == TypePacked)
+    {
+        packed.advise(index, will_need);
+        return true;
+    }
+    return false;
+}
+
+SourceLoader::SourceLoader()
+: running_(false), has_request_(false), preroll_frames_(0), generation_(0), current_frame_(0), timings_(NULL), shared_cache_(NULL), reload_due_(0)
+#if defined(TARGET_LINUX)
+, inotify_(-1)
+#else
+, watched_modified_(0), watched_size_(0)
+#endif
+{
+
+}
+
+SourceLoader::~SourceLoader()
+{
+    close();
+}
+
+void SourceLoader::setTimings(StageTimings *timings)
+{
+    timings_ = timings;
+}
+
+void SourceLoader::setSharedCache(SharedFrameCache *cache)
+{
+    shared_cache_ = cache;
+}
+
+void SourceLoader::setup()
+{
+    close();
+    running_ = true;
+    startThread();
+}
+
+void SourceLoader::close()
+{
+    mutex_.lock();
+    running_ = false;
+    generation_++;
+    condition_.signal();
+    mutex_.unlock();
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+}
+
+void SourceLoader::load(const std::string& path, unsigned int preroll_frames)
+{
+    ofScopedLock lock(mutex_);
+    path_ = path;
+    preroll_frames_ = preroll_frames;
+    has_request_ = true;
+    generation_++;
+    loaded_.reset();
+    status_ = "Loading " + path;
+    condition_.signal();
+}
+
+void SourceLoader::setCurrentFrame(long frame)
+{
+    current_frame_ = frame;
+}
+
+std::shared_ptr<SourceLoader::Source> SourceLoader::takeLoaded()
+{
+    ofScopedLock lock(mutex_);
+    std::shared_ptr<Source> loaded;
+    loaded.swap(loaded_);
+    return loaded;
+}
+
+void SourceLoader::release(std::shared_ptr<Source> source)
+{
+    if (source)
+    {
+        ofScopedLock lock(mutex_);
+        releases_.push_back(source);
+        condition_.signal();
+    }
+}
+
+std::string SourceLoader::getStatus() const
+{
+    ofScopedLock lock(mutex_);
+    return status_;
+}
+
+void SourceLoader::watch(std::shared_ptr<Source> source)
+{
+    ofScopedLock lock(mutex_);
+    if (source && source->type != TypePlaylist)
+    {
+        source.reset();
+    }
+    /*
+     A reload of the previous source no longer applies
+     */
+    if (reloaded_)
+    {
+        releases_.push_back(reloaded_);
+        reloaded_.reset();
+    }
+    watched_ = source;
+    condition_.signal();
+}
+
+std::shared_ptr<SourceLoader::Source> SourceLoader::takeReloaded(Playlist::Difference& difference)
+{
+    ofScopedLock lock(mutex_);
+    std::shared_ptr<Source> reloaded;
+    reloaded.swap(reloaded_);
+    difference = reloaded_difference_;
+    return reloaded;
+}
+
+bool SourceLoader::isCurrent(unsigned int generation) const
+{
+    ofScopedLock lock(mutex_);
+    return generation == generation_;
+}
+
+void SourceLoader::setStatus(const std::string& status)
+{
+    ofScopedLock lock(mutex_);
+    status_ = status;
+}
+
+void SourceLoader::threadedFunction()
+{
+    Tracer::getShared().setThreadName("source_loader");
+    mutex_.lock();
+    for (;;)
+    {
+        if (!releases_.empty())
+        {
+            std::vector<std::shared_ptr<Source> > releases;
+            releases.swap(releases_);
+            mutex_.unlock();
+            releases.clear();
+            mutex_.lock();
+        }
+        else if (has_request_ && running_)
+        {
+            std::string path = path_;
+            unsigned int preroll_frames = preroll_frames_;
+            unsigned int generation = generation_;
+            has_request_ = false;
+            mutex_.unlock();
+            std::shared_ptr<Source> source = prepare(path, preroll_frames, generation);
+            mutex_.lock();
+            if (generation == generation_)
+            {
+                loaded_ = source;
+                status_.clear();
+            }
+            else
+            {
+                /*
+                 Superseded while loading
+                 */
+                releases_.push_back(source);
+            }
+        }
+        else if (running_ && watched_)
+        {
+            condition_.tryWait(mutex_, WatchInterval);
+            std::shared_ptr<Source> watched = watched_;
+            if (watched && running_ && !has_request_)
+            {
+                mutex_.unlock();
+                Playlist::Difference difference;
+                std::shared_ptr<Source> reloaded = reloadIfChanged(watched, difference);
+                mutex_.lock();
+                if (reloaded && watched == watched_)
+                {
+                    if (reloaded_)
+                    {
+                        releases_.push_back(reloaded_);
+                    }
+                    reloaded_ = reloaded;
+                    reloaded_difference_ = difference;
+                }
+                else if (reloaded)
+                {
+                    releases_.push_back(reloaded);
+                }
+            }
+        }
+        else if (running_)
+        {
+            condition_.wait(mutex_);
+        }
+        else
+        {
+            break;
+        }
+    }
+    mutex_.unlock();
+    stopWatchingFile();
+}
+
+std::shared_ptr<SourceLoader::Source> SourceLoader::reloadIfChanged(std::shared_ptr<Source> watched, Playlist::Difference& difference)
+{
+    if (watched->path != watched_path_)
+    {
+        stopWatchingFile();
+        watched_path_ = watched->path;
+        std::string full_path = ofToDataPath(watched_path_);
+#if defined(TARGET_LINUX)
+        /*
+         Watch the directory, as editors often save by replacing the file
+         */
+        inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_ == -1 || inotify_add_watch(inotify_, ofFilePath::getEnclosingDirectory(full_path).c_str(),
+                                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1)
+        {
+            ofLogWarning("SourceLoader") << "Unable to watch " << full_path << " for changes";
+        }
+#else
+        hasWatchedFileChanged();
+#endif
+    }
+    uint64_t now = ofGetElapsedTimeMicros();
+    if (hasWatchedFileChanged())
+    {
+        reload_due_ = now + ReloadDelay;
+    }
+    if (reload_due_ == 0 || now < reload_due_)
+    {
+        return std::shared_ptr<Source>();
+    }
+    reload_due_ = 0;
+
+    Tracer::Span span("reload_source");
+    std::shared_ptr<Source> reloaded(new Source(watched->path, timings_, shared_cache_));
+    reloaded->type = TypePlaylist;
+    reloaded->playlist.load(watched->path);
+    if (reloaded->size() == 0)
+    {
+        ofLogWarning("SourceLoader") << "Keeping the previous version of " << watched->path << " as it has no frames";
+        return std::shared_ptr<Source>();
+    }
+    reloaded->shared_key = getSharedKey(*reloaded);
+    difference = reloaded->playlist.compare(watched->playlist);
+    if (difference.unchanged_start == reloaded->size() && reloaded->size() == watched->size())
+    {
+        return std::shared_ptr<Source>();
+    }
+    ofLogNotice("SourceLoader") << "Reloaded " << watched->path << ", frames " << difference.unchanged_start << " to " <<
+        reloaded->size() - difference.unchanged_end << " changed";
+    return reloaded;
+}
+
+bool SourceLoader::hasWatchedFileChanged()
+{
+#if defined(TARGET_LINUX)
+    if (inotify_ == -1)
+    {
+        return false;
+    }
+    std::string name = ofFilePath::getFileName(watched_path_);
+    bool changed = false;
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(inotify_, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *position = buffer; position < buffer + length; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(position);
+            if (event->len > 0 && name == event->name)
+            {
+                changed = true;
+            }
+            position += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+#else
+    struct stat info;
+    if (stat(ofToDataPath(watched_path_).c_str(), &info) != 0)
+    {
+        return false;
+    }
+    bool changed = info.st_mtime != watched_modified_ || uint64_t(info.st_size) != watched_size_;
+    watched_modified_ = info.st_mtime;
+    watched_size_ = info.st_size;
+    return changed;
+#endif
+}
+
+void SourceLoader::stopWatchingFile()
+{
+#if defined(TARGET_LINUX)
+    if (inotify_ != -1)
+    {
+        ::close(inotify_);
+        inotify_ = -1;
+    }
+#endif
+    watched_path_.clear();
+    reload_due_ = 0;
+}
+
+std::shared_ptr<SourceLoader::Source> SourceLoader::prepare(const std::string& path, unsigned int preroll_frames, unsigned int generation)
+{
+    Tracer::Span span("load_source");
+    std::shared_ptr<Source> source(new Source(path, timings_, shared_cache_));
+    std::string extension = ofFilePath::getFileExt(path);
+    if (ofFile(path).isDirectory() || extension == ofxHapImage::HapImageFileExtension())
+    {
+        setStatus("Loading " + path + ": indexing");
+        source->sequence.load(path);
+        source->type = TypeSequence;
+    }
+    else if (extension == PackedSequence::FileExtension())
+    {
+        setStatus("Loading " + path + ": mapping");
+        source->packed.load(path);
+        source->type = TypePacked;
+    }
+    else if (extension == "xml")
+    {
+        setStatus("Loading " + path + ": indexing");
+        source->playlist.load(path);
+        source->type = TypePlaylist;
+    }
+    else
+    {
+        setStatus("Loading " + path + ": indexing");
+        source->movie_index.load(path);
+        source->type = TypeMovie;
+        return source;
+    }
+    source->shared_key = getSharedKey(*source);
+
+    /*
+     Load the frames which will be wanted by the time the source is swapped in
+     */
+    unsigned int size = source->size();
+    unsigned int count = std::min(preroll_frames, size);
+    long first = size > 0 ? current_frame_ % long(size) : 0;
+    for (unsigned int i = 0; i < count && isCurrent(generation); i++)
+    {
+        setStatus("Loading " + path + ": pre-rolling " + ofToString(i + 1) + "/" + ofToString(count));
+        unsigned int index = (first + i) % size;
+        source->preroll[index] = source->loadFrame(index);
+    }
+    return source;
+}
@@ -0,0 +1,145 @@
+//
+//  SourceLoader.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__SourceLoader__
+#define __MediaPlayer_client__SourceLoader__
+
+#include "ofMain.h"
+#include <ofxHapImageSequence.h>
+#include <atomic>
+#include "FramePrefetcher.h"
+#include "Playlist.h"
+#include "MovieIndex.h"
+#include "PackedSequence.h"
+#include "StageTimings.h"
+
+/*
+ Opens and indexes sources on a background thread, and pre-rolls the frames of sequences
+ and playlists which will be wanted when the source is swapped in, so the current source
+ keeps playing while a new one loads.
+
+ A playlist source can be watched, in which case its file is reloaded on the same thread
+ when it changes (using inotify on Linux, and by checking its modification time elsewhere).
+
+ Sources which are replaced are passed back to be destroyed on the same thread.
+ */
+class SourceLoader : public ofThread {
+public:
+    enum Type {
+        TypeSequence,
+        TypePlaylist,
+        TypePacked,
+        // Hap movies are indexed here, other movies must be loaded by the player
+        TypeMovie
+    };
+    class Source : public FramePathSource {
+    public:
+        /*
+         Playlist lookups are timed in timings, and frames shared through shared_cache, if
+         they are set
+         */
+        Source(const std::string& path, StageTimings *timings, SharedFrameCache *shared_cache);
+        unsigned int size() const;
+        std::string getPath(unsigned int index) const;
+        std::shared_ptr<LoadedFrame> loadFrame(unsigned int index) const;
+        bool advise(unsigned int index, bool will_need) const;
+        std::string path;
+        Type type;
+        StageTimings *timings;
+        SharedFrameCache *shared_cache;
+        // Identifies this version of the source to other processes sharing its frames
+        uint64_t shared_key;
+        // ofxHapImageSequence isn't const-correct
+        mutable ofxHapImageSequence sequence;
+        Playlist playlist;
+        PackedSequence packed;
+        MovieIndex movie_index;
+        // Frames loaded ahead of the swap, by index
+        std::map<unsigned int, FramePrefetcher::Frame> preroll;
+    };
+    SourceLoader();
+    ~SourceLoader();
+    /*
+     Must be called before setup()
+     */
+    void setTimings(StageTimings *timings);
+    /*
+     Must be called before setup(). cache must outlive the loader and its sources.
+     */
+    void setSharedCache(SharedFrameCache *cache);
+    void setup();
+    void close();
+    /*
+     Starts loading path in place of any source still loading. Up to preroll_frames frames
+     are loaded from the current frame once the source is indexed.
+     */
+    void load(const std::string& path, unsigned int preroll_frames);
+    /*
+     Called on every frame so pre-rolling starts from the right place
+     */
+    void setCurrentFrame(long frame);
+    /*
+     Returns the most recently loaded source once it is ready, and an empty pointer otherwise
+     */
+    std::shared_ptr<Source> takeLoaded();
+    /*
+     Destroys source on the loader thread
+     */
+    void release(std::shared_ptr<Source> source);
+    /*
+     Describes any load in progress, or returns an empty string
+     */
+    std::string getStatus() const;
+    /*
+     Reloads source when its playlist file changes. Pass an empty pointer to stop watching.
+     */
+    void watch(std::shared_ptr<Source> source);
+    /*
+     Returns a reload of the watched source once its file has changed, and an empty pointer
+     otherwise. difference gives the frames which are the same in both.
+     */
+    std::shared_ptr<Source> takeReloaded(Playlist::Difference& difference);
+protected:
+    void threadedFunction();
+private:
+    std::shared_ptr<Source> prepare(const std::string& path, unsigned int preroll_frames, unsigned int generation);
+    bool isCurrent(unsigned int generation) const;
+    /*
+     Called on the loader thread with mutex_ unlocked
+     */
+    std::shared_ptr<Source> reloadIfChanged(std::shared_ptr<Source> watched, Playlist::Difference& difference);
+    bool hasWatchedFileChanged();
+    void stopWatchingFile();
+    void setStatus(const std::string& status);
+    mutable ofMutex mutex_;
+    Poco::Condition condition_;
+    bool running_;
+    bool has_request_;
+    std::string path_;
+    unsigned int preroll_frames_;
+    unsigned int generation_;
+    std::shared_ptr<Source> loaded_;
+    std::vector<std::shared_ptr<Source> > releases_;
+    std::string status_;
+    std::atomic<long> current_frame_;
+    StageTimings *timings_;
+    SharedFrameCache *shared_cache_;
+
+    std::shared_ptr<Source> watched_;
+    std::shared_ptr<Source> reloaded_;
+    Playlist::Difference reloaded_difference_;
+    // Only used on the loader thread
+    std::string watched_path_;
+    uint64_t reload_due_;
+#if defined(TARGET_LINUX)
+    int inotify_;
+#else
+    time_t watched_modified_;
+    uint64_t watched_size_;
+#endif
+};
+
+#endif /* defined(__MediaPlayer_client__SourceLoader__) */
@@ -0,0 +1,128 @@
+//
+//  StageTimings.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "StageTimings.h"
+
+static const char *stage_names[StageTimings::StageCount] = {
+    "update",
+    "osc",
+    "frame_selection",
+    "playlist_lookup",
+    "frame_load",
+    "source",
+    "settings",
+    "outputs",
+    "memory",
+    "draw",
+    "draw_outputs",
+    "draw_stats"
+};
+
+StageTimings::Scope::Scope(StageTimings& timings, Stage stage)
+: timings_(timings), stage_(stage),
+start_(timings.enabled_ || timings.latest_enabled_ || Tracer::getShared().isEnabled() ? ofGetElapsedTimeMicros() : 0)
+{
+
+}
+
+StageTimings::Scope::~Scope()
+{
+    if (start_ != 0)
+    {
+        uint64_t end = ofGetElapsedTimeMicros();
+        timings_.latest_[stage_] = end - start_;
+        if (timings_.enabled_)
+        {
+            timings_.add(stage_, start_, end);
+        }
+        Tracer& tracer = Tracer::getShared();
+        if (tracer.isEnabled())
+        {
+            tracer.add(stage_names[stage_], start_, end);
+        }
+    }
+}
+
+StageTimings::StageTimings()
+: enabled_(false), latest_enabled_(false), random_(88172645463325252ULL)
+{
+    for (int i = 0; i < StageCount; i++)
+    {
+        counts_[i] = 0;
+        maxima_[i] = 0;
+        latest_[i] = 0;
+    }
+}
+
+void StageTimings::setEnabled(bool enabled)
+{
+    enabled_ = enabled;
+}
+
+bool StageTimings::isEnabled() const
+{
+    return enabled_;
+}
+
+void StageTimings::setLatestEnabled(bool enabled)
+{
+    latest_enabled_ = enabled;
+}
+
+uint64_t StageTimings::getLatest(Stage stage) const
+{
+    return latest_[stage];
+}
+
+void StageTimings::add(Stage stage, uint64_t start_micros, uint64_t end_micros)
+{
+    uint32_t duration = end_micros - start_micros;
+    ofScopedLock lock(mutex_);
+    std::vector<uint32_t>& samples = samples_[stage];
+    counts_[stage]++;
+    maxima_[stage] = std::max(maxima_[stage], duration);
+    if (samples.size() < ReservoirSize)
+    {
+        samples.push_back(duration);
+        return;
+    }
+    /*
+     Keep the new duration with probability ReservoirSize / count, in place of a random one
+     */
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    uint64_t slot = random_ % counts_[stage];
+    if (slot < ReservoirSize)
+    {
+        samples[slot] = duration;
+    }
+}
+
+StageTimings::Summary StageTimings::getSummary(Stage stage) const
+{
+    Summary summary;
+    summary.p50 = summary.p99 = summary.max = 0.0;
+    std::vector<uint32_t> sorted;
+    {
+        ofScopedLock lock(mutex_);
+        summary.samples = counts_[stage];
+        summary.max = maxima_[stage];
+        sorted = samples_[stage];
+    }
+    if (!sorted.empty())
+    {
+        std::sort(sorted.begin(), sorted.end());
+        summary.p50 = sorted[(sorted.size() - 1) / 2];
+        summary.p99 = sorted[((sorted.size() - 1) * 99) / 100];
+    }
+    return summary;
+}
+
+const char *StageTimings::getName(Stage stage)
+{
+    return stage_names[stage];
+}
@@ -0,0 +1,85 @@
+//
+//  StageTimings.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__StageTimings__
+#define __MediaPlayer_client__StageTimings__
+
+#include "ofMain.h"
+#include <atomic>
+#include "Tracer.h"
+
+/*
+ Collects the duration of each stage of the update and draw loops. Does nothing unless
+ enabled. Stages are also recorded as spans while the shared Tracer is enabled. Scopes may
+ be timed on any thread.
+
+ Each stage keeps a uniform random sample of at most ReservoirSize durations, so a long run
+ uses bounded memory; the count and maximum cover every duration.
+ */
+class StageTimings {
+public:
+    enum Stage {
+        StageUpdate,
+        StageOSC,
+        StageFrameSelection,
+        StagePlaylistLookup,
+        StageFrameLoad,
+        StageSource,
+        StageSettings,
+        StageOutputs,
+        StageMemory,
+        StageDraw,
+        StageDrawOutputs,
+        StageDrawStats,
+        StageCount
+    };
+    /*
+     Times the enclosing scope
+     */
+    class Scope {
+    public:
+        Scope(StageTimings& timings, Stage stage);
+        ~Scope();
+    private:
+        StageTimings& timings_;
+        Stage stage_;
+        uint64_t start_;
+    };
+    struct Summary {
+        size_t samples;
+        // Microseconds
+        double p50;
+        double p99;
+        double max;
+    };
+    StageTimings();
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    /*
+     Keeps only the most recent duration of each stage, for getLatest()
+     */
+    void setLatestEnabled(bool enabled);
+    /*
+     Microseconds
+     */
+    uint64_t getLatest(Stage stage) const;
+    void add(Stage stage, uint64_t start_micros, uint64_t end_micros);
+    Summary getSummary(Stage stage) const;
+    static const char *getName(Stage stage);
+private:
+    static const size_t ReservoirSize = 16384;
+    std::atomic<bool> enabled_;
+    std::atomic<bool> latest_enabled_;
+    mutable ofMutex mutex_;
+    std::vector<uint32_t> samples_[StageCount];
+    uint64_t counts_[StageCount];
+    uint32_t maxima_[StageCount];
+    // State of the xorshift generator choosing which samples to replace
+    uint64_t random_;
+    std::atomic<uint64_t> latest_[StageCount];
+};
+
+#endif /* defined(__MediaPlayer_client__StageTimings__) */
@@ -0,0 +1,149 @@
+//
+//  Tracer.cpp
+//  MediaPlayer_client
+//
+//
+
+#include "Tracer.h"
+
+#if defined(_MSC_VER)
+#define TRACER_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACER_THREAD_LOCAL __thread
+#endif
+
+static TRACER_THREAD_LOCAL void *thread_ring = NULL;
+
+Tracer::Span::Span(const char *name)
+: name_(name), start_(Tracer::getShared().isEnabled() ? ofGetElapsedTimeMicros() : 0)
+{
+
+}
+
+Tracer::Span::~Span()
+{
+    Tracer& tracer = Tracer::getShared();
+    if (start_ != 0 && tracer.isEnabled())
+    {
+        tracer.add(name_, start_, ofGetElapsedTimeMicros());
+    }
+}
+
+Tracer& Tracer::getShared()
+{
+    static Tracer *tracer = new Tracer();
+    return *tracer;
+}
+
+Tracer::Tracer()
+: enabled_(false)
+{
+
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+Tracer::Ring *Tracer::getRing()
+{
+    Ring *ring = static_cast<Ring *>(thread_ring);
+    if (ring == NULL)
+    {
+        ring = new Ring();
+        ring->events.resize(RingSize);
+        ring->head = 0;
+        ofScopedLock lock(mutex_);
+        ring->thread_id = rings_.size() + 1;
+        ring->thread_name = "thread " + ofToString(ring->thread_id);
+        rings_.push_back(ring);
+        thread_ring = ring;
+    }
+    return ring;
+}
+
+void Tracer::setThreadName(const std::string& name)
+{
+    Ring *ring = getRing();
+    ofScopedLock lock(mutex_);
+    ring->thread_name = name;
+}
+
+void Tracer::add(const char *name, uint64_t start_micros, uint64_t end_micros)
+{
+    Ring *ring = getRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Event& event = ring->events[head % RingSize];
+    event.name = name;
+    event.start = start_micros;
+    event.duration = uint32_t(std::min(end_micros - start_micros, uint64_t(UINT32_MAX)));
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Tracer::write(const std::string& path, float seconds) const
+{
+    std::string full_path = ofToDataPath(path, true);
+    FILE *file = fopen(full_path.c_str(), "w");
+    if (file == NULL)
+    {
+        ofLogError("Tracer") << "Unable to create " << full_path;
+        return false;
+    }
+    uint64_t now = ofGetElapsedTimeMicros();
+    uint64_t since = now - std::min(now, uint64_t(std::max(seconds, 0.0f) * 1000000.0));
+
+    std::vector<Ring *> rings;
+    std::vector<std::string> names;
+    mutex_.lock();
+    rings = rings_;
+    for (std::vector<Ring *>::const_iterator it = rings.begin(); it != rings.end(); ++it) {
+        names.push_back((*it)->thread_name);
+    }
+    mutex_.unlock();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<Event> events;
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+        const Ring *ring = rings[i];
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", ring->thread_id, names[i].c_str());
+        first = false;
+        /*
+         Copy while the thread may still be writing, then drop any the writer could have
+         overwritten during the copy
+         */
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = head > RingSize ? head - RingSize : 0;
+        events.clear();
+        for (uint64_t index = tail; index < head; index++)
+        {
+            events.push_back(ring->events[index % RingSize]);
+        }
+        uint64_t overwritten = ring->head.load(std::memory_order_acquire) + 1;
+        overwritten = overwritten > RingSize ? overwritten - RingSize : 0;
+        for (uint64_t index = std::max(tail, overwritten); index < head; index++)
+        {
+            const Event& event = events[index - tail];
+            if (event.start + event.duration >= since)
+            {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%u}",
+                        event.name, ring->thread_id, (unsigned long long)event.start, event.duration);
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (ok)
+    {
+        ofLogNotice("Tracer") << "Wrote trace to " << full_path;
+    }
+    else
+    {
+        ofLogError("Tracer") << "Unable to write " << full_path;
+    }
+    return ok;
+}
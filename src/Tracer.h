@@ -0,0 +1,71 @@
+//
+//  Tracer.h
+//  MediaPlayer_client
+//
+//
+
+#ifndef __MediaPlayer_client__Tracer__
+#define __MediaPlayer_client__Tracer__
+
+#include "ofMain.h"
+#include <atomic>
+
+/*
+ Records timed spans from any thread so the moments before a dropped frame can be
+ inspected later, and writes them as Chrome trace_event JSON for Perfetto or
+ chrome://tracing.
+
+ Each thread writes to its own ring buffer without locking, overwriting its oldest spans.
+ When tracing is disabled a span costs one relaxed atomic load.
+ */
+class Tracer {
+public:
+    /*
+     Times the enclosing scope. name must outlive the tracer, eg a string literal.
+     */
+    class Span {
+    public:
+        Span(const char *name);
+        ~Span();
+    private:
+        const char *name_;
+        uint64_t start_;
+    };
+    /*
+     The tracer shared by every thread. It is never destroyed.
+     */
+    static Tracer& getShared();
+    Tracer();
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+    /*
+     Names the calling thread in traces
+     */
+    void setThreadName(const std::string& name);
+    void add(const char *name, uint64_t start_micros, uint64_t end_micros);
+    /*
+     Writes spans which ended in the last seconds to path
+     */
+    bool write(const std::string& path, float seconds) const;
+private:
+    struct Event {
+        const char *name;
+        uint64_t start;
+        uint32_t duration;
+    };
+    struct Ring {
+        unsigned int thread_id;
+        std::string thread_name;
+        std::vector<Event> events;
+        // Total events ever written, the next is written at head % events.size()
+        std::atomic<uint64_t> head;
+    };
+    Ring *getRing();
+    static const size_t RingSize = 16384;
+    std::atomic<bool> enabled_;
+    mutable ofMutex mutex_;
+    // Rings are kept after their threads exit, so their spans can still be written
+    std::vector<Ring *> rings_;
+};
+
+#endif /* defined(__MediaPlayer_client__Tracer__) */
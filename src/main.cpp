@@ -1,9 +1,56 @@
 #include "ofMain.h"
 #include "ofApp.h"
 #include "ofAppGLFWWindow.h"
+#include "ofAppNoWindow.h"
+#include "Benchmark.h"
+#include "OSCReplayer.h"
+#include "PackedSequence.h"
+#include "OSCBlaster.h"
+#include "FrameClockTest.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+    std::string pack_source;
+    std::string pack_destination;
+    unsigned int pack_chunks = 0;
+    if (PackedSequence::parseArguments(argc, argv, pack_source, pack_destination, pack_chunks))
+    {
+        /*
+        Pack a sequence and exit without opening a window
+        */
+        return PackedSequence::pack(pack_source, pack_destination, pack_chunks) ? 0 : 1;
+    }
+    unsigned int clock_test_seed = 1;
+    if (FrameClockTest::parseArguments(argc, argv, clock_test_seed))
+    {
+        /*
+        Check the predictive clock against simulated frame number streams and exit
+        */
+        return FrameClockTest(clock_test_seed).run() ? 0 : 1;
+    }
+    OSCBlaster::Settings blast_settings;
+    if (OSCBlaster::parseArguments(argc, argv, blast_settings))
+    {
+        /*
+        Send a stream of OSC to another client and exit
+        */
+        return OSCBlaster(blast_settings).run() ? 0 : 1;
+    }
+    Benchmark::Settings benchmark_settings;
+    if (Benchmark::parseArguments(argc, argv, benchmark_settings))
+    {
+        /*
+        Run the benchmark workload headless
+        */
+        ofAppNoWindow window;
+        ofSetupOpenGL(&window, 1024,768,OF_WINDOW);
+
+        ofRunApp(new ofApp(new Benchmark(benchmark_settings)));
+        return 0;
+    }
+    std::string replay_path;
+    float replay_speed = 1.0;
+    bool replay = OSCReplayer::parseArguments(argc, argv, replay_path, replay_speed);
     /*
     Cause OF to go fullscreen over all displays
     http://forum.openframeworks.cc/t/fullscreen-dual-screen/693/26
@@ -12,6 +59,6 @@ int main( ){
     window.setMultiDisplayFullscreen(true);
 	ofSetupOpenGL(&window, 1024,768,OF_WINDOW);
 
-	ofRunApp(new ofApp());
+	ofRunApp(new ofApp(NULL, replay ? new OSCReplayer(replay_path, replay_speed) : NULL));
 
 }
@@ -1,6 +1,6 @@
 #include "ofApp.h"
 
-static long getMessageInteger(const ofxOscMessage& message, int index)
+static long getMessageInteger(const OSCReceiveThread::Message& message, int index)
 {
     switch (message.getArgType(index))
     {
@@ -16,7 +16,7 @@ static long getMessageInteger(const ofxOscMessage& message, int index)
     }
 }
 
-static float getMessageFloat(const ofxOscMessage& message, int index)
+static float getMessageFloat(const OSCReceiveThread::Message& message, int index)
 {
     switch (message.getArgType(index))
     {
@@ -32,27 +32,28 @@ static float getMessageFloat(const ofxOscMessage& message, int index)
     }
 }
 
-static std::string stripWhiteSpace(const std::string& string)
+//--------------------------------------------------------------
+ofApp::ofApp(Benchmark *benchmark, OSCReplayer *replayer) : benchmark(benchmark), replayer(replayer)
 {
-    std::string::size_type first = string.find_first_not_of(" \t");
-    if (first == std::string::npos)
-    {
-        return "";
-    }
-    std::string::size_type last = string.find_last_not_of(" \t");
-    return string.substr(first, last - first + 1);
+
 }
 
 //--------------------------------------------------------------
 void ofApp::setup(){
 	ofSetVerticalSync(true);
-	receiver.setup(6666);
 	in_error = true;
 	current_frame_number = 0;
     client_parameters_changed = false;
+    settings_need_saved = false;
+    settings_changed_time = 0;
     source_changed = true;
+    source_type = SourceNone;
+    output_batch_changed = true;
 	ofBackground(0);
-	font.loadFont(OF_TTF_MONO, 72);
+    if (!benchmark)
+    {
+        font.loadFont(OF_TTF_MONO, 72);
+    }
 
     /*
     Define default settings and then override them with any stored in settings.xml
@@ -70,7 +71,160 @@ void ofApp::setup(){
     client_parameters.add(fullscreen_param);
     ofParameter<bool> first_run_param("first_run", true);
     client_parameters.add(first_run_param);
+    ofParameter<int> prefetch_threads_param("prefetch_threads", 2);
+    client_parameters.add(prefetch_threads_param);
+    ofParameter<int> prefetch_frames_param("prefetch_frames", 8);
+    client_parameters.add(prefetch_frames_param);
+    ofParameter<int> readahead_frames_param("readahead_frames", 32);
+    client_parameters.add(readahead_frames_param);
+    ofParameter<bool> predictive_clock_param("predictive_clock", false);
+    client_parameters.add(predictive_clock_param);
+    ofParameter<float> settings_save_delay_param("settings_save_delay", 1.0);
+    client_parameters.add(settings_save_delay_param);
+    ofParameter<bool> record_osc_param("record_osc", false);
+    client_parameters.add(record_osc_param);
+    ofParameter<int> movie_cache_frames_param("movie_cache_frames", 30);
+    client_parameters.add(movie_cache_frames_param);
+    ofParameter<int> frame_buffer_pool_mb_param("frame_buffer_pool_mb", 256);
+    client_parameters.add(frame_buffer_pool_mb_param);
+    ofParameter<int> hap_decode_threads_param("hap_decode_threads", 0);
+    client_parameters.add(hap_decode_threads_param);
+    ofParameter<bool> tracing_param("tracing", false);
+    client_parameters.add(tracing_param);
+    ofParameter<float> trace_seconds_param("trace_seconds", 10.0);
+    client_parameters.add(trace_seconds_param);
+    ofParameter<std::string> heartbeat_destination_param("heartbeat_destination", "");
+    client_parameters.add(heartbeat_destination_param);
+    ofParameter<float> heartbeat_interval_param("heartbeat_interval", 1.0);
+    client_parameters.add(heartbeat_interval_param);
+    ofParameter<bool> reload_playlists_param("reload_playlists", true);
+    client_parameters.add(reload_playlists_param);
+    ofParameter<int> osc_port_param("osc_port", 6666);
+    client_parameters.add(osc_port_param);
+    ofParameter<int> osc_receive_buffer_kb_param("osc_receive_buffer_kb", 4096);
+    client_parameters.add(osc_receive_buffer_kb_param);
+    ofParameter<bool> osc_reuse_port_param("osc_reuse_port", false);
+    client_parameters.add(osc_reuse_port_param);
+    ofParameter<std::string> osc_multicast_group_param("osc_multicast_group", "");
+    client_parameters.add(osc_multicast_group_param);
+    ofParameter<bool> fingerprints_param("fingerprints", false);
+    client_parameters.add(fingerprints_param);
+    ofParameter<std::string> fingerprint_destination_param("fingerprint_destination", "");
+    client_parameters.add(fingerprint_destination_param);
+    ofParameter<int> fingerprint_batch_param("fingerprint_batch", 30);
+    client_parameters.add(fingerprint_batch_param);
+    ofParameter<int> memory_budget_mb_param("memory_budget_mb", 0);
+    client_parameters.add(memory_budget_mb_param);
+    ofParameter<float> memory_budget_fraction_param("memory_budget_fraction", 0.5);
+    client_parameters.add(memory_budget_fraction_param);
+    ofParameter<bool> memory_pressure_param("memory_pressure", true);
+    client_parameters.add(memory_pressure_param);
+    ofParameter<std::string> shared_frame_cache_param("shared_frame_cache", "");
+    client_parameters.add(shared_frame_cache_param);
+    ofParameter<int> shared_frame_cache_slots_param("shared_frame_cache_slots", 32);
+    client_parameters.add(shared_frame_cache_slots_param);
+    ofParameter<int> shared_frame_cache_slot_mb_param("shared_frame_cache_slot_mb", 16);
+    client_parameters.add(shared_frame_cache_slot_mb_param);
     
+    if (benchmark)
+    {
+        /*
+        Benchmarks start from the default settings with a generated source and outputs
+        */
+        client_parameters["client_id"].cast<std::string>() = benchmark->getClientID();
+        client_parameters["source"].cast<std::string>() = benchmark->setup();
+        client_parameters["first_run"].cast<bool>() = false;
+        for (unsigned int i = 0; i < benchmark->getOutputCount(); i++)
+        {
+            std::string output_name = benchmark->getOutputName(i);
+            outputs.insert(std::pair<std::string, Output>(output_name, Output(output_name)));
+        }
+        timings.setEnabled(true);
+    }
+    else
+    {
+        loadSettings();
+    }
+
+    router.setClientID(client_parameters.getString("client_id"));
+    receiver.setClientID(client_parameters.getString("client_id"));
+    outputsChanged();
+
+    /*
+    Start receiving OSC, from a log if we are replaying one
+    */
+    if (replayer)
+    {
+        replayer->setup(receiver);
+    }
+    else if (!benchmark)
+    {
+        if (client_parameters.getBool("record_osc") && recorder.setup("osc-" + ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".osclog"))
+        {
+            receiver.setRecorder(&recorder);
+        }
+        receiver.setSocketOptions(std::max(client_parameters.getInt("osc_receive_buffer_kb"), 0) * 1024,
+                                  client_parameters.getBool("osc_reuse_port"),
+                                  client_parameters.getString("osc_multicast_group"));
+        receiver.setup(client_parameters.getInt("osc_port"));
+    }
+
+    /*
+    Start loading frames ahead of playback, and sources in the background
+    */
+    setupHeartbeat();
+    FrameFingerprint::setEnabled(client_parameters.getBool("fingerprints"));
+    fingerprints.setup(client_parameters.getString("client_id"),
+                       client_parameters.getString("fingerprint_destination"),
+                       std::max(client_parameters.getInt("fingerprint_batch"), 1));
+    Tracer::getShared().setThreadName("main");
+    Tracer::getShared().setEnabled(client_parameters.getBool("tracing"));
+    FrameBufferPool::getShared().setRetainedLimit(uint64_t(std::max(client_parameters.getInt("frame_buffer_pool_mb"), 0)) * 1024 * 1024);
+    HapDecodePool::getShared().setup(std::max(client_parameters.getInt("hap_decode_threads"), 0));
+    if (!client_parameters.getString("shared_frame_cache").empty() &&
+        shared_frame_cache.setup(client_parameters.getString("shared_frame_cache"),
+                                 std::max(client_parameters.getInt("shared_frame_cache_slots"), 1),
+                                 size_t(std::max(client_parameters.getInt("shared_frame_cache_slot_mb"), 1)) * 1024 * 1024))
+    {
+        hap_movie.setSharedCache(&shared_frame_cache);
+        source_loader.setSharedCache(&shared_frame_cache);
+        memory_governor.add("shared frames", &shared_frame_cache);
+    }
+    memory_governor.add("prefetch", &prefetcher);
+    memory_governor.add("movie cache", &hap_movie);
+    memory_governor.add("free buffers", &FrameBufferPool::getShared());
+    memory_governor.setup(uint64_t(std::max(client_parameters.getInt("memory_budget_mb"), 0)) * 1024 * 1024,
+                          client_parameters.getFloat("memory_budget_fraction"),
+                          client_parameters.getBool("memory_pressure"));
+    source_loader.setTimings(&timings);
+    source_loader.setup();
+    prefetcher.setup(std::max(client_parameters.getInt("prefetch_threads"), 1),
+                     std::max(client_parameters.getInt("prefetch_frames"), 0),
+                     std::max(client_parameters.getInt("readahead_frames"), 0));
+
+    /*
+    Save settings now so that client_id is saved if we generated it. Replays leave
+    settings.xml as it was so they can be repeated.
+    */
+    if (!benchmark && !replayer)
+    {
+        settings_writer.setup("settings.xml");
+    }
+	client_parameters_changed = true;
+
+    /*
+    Monitor any subsequent settings changes so we can save them
+    */
+    ofAddListener(client_parameters.parameterChangedE, this, &ofApp::parameterChanged);
+
+    /*
+    Restore full-screen state
+    */
+    ofSetFullscreen(client_parameters.getBool("full_screen"));
+}
+
+void ofApp::loadSettings()
+{
 	ofXml xml("settings.xml");
 
 	xml.deserialize(client_parameters);
@@ -103,140 +257,179 @@ void ofApp::setup(){
         outputs.find("1")->second.parameters_changed = true;
         client_parameters["first_run"].cast<bool>() = false;
     }
-
-    /*
-    Save settings now so that client_id is saved if we generated it
-    */
-	client_parameters_changed = true;
-
-    /*
-    Monitor any subsequent settings changes so we can save them
-    */
-    ofAddListener(client_parameters.parameterChangedE, this, &ofApp::parameterChanged);
-
-    /*
-    Restore full-screen state
-    */
-    ofSetFullscreen(client_parameters.getBool("full_screen"));
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
+    if (benchmark)
+    {
+        if (benchmark->isFinished())
+        {
+            benchmark->writeReport(timings);
+            ofExit();
+            return;
+        }
+        benchmark->update(receiver);
+    }
+    StageTimings::Scope update_scope(timings, StageTimings::StageUpdate);
+
 	bool frame_was_updated = false;
     bool missed_frames_need_checked = false;
     bool outputs_were_reconfigured = false;
 
-    while (receiver.hasWaitingMessages())
     {
-        ofxOscMessage message;
-        receiver.getNextMessage(&message);
-
-        std::string address = stripWhiteSpace(message.getAddress());
-
-        std::vector<std::string> parts = ofSplitString(address, "/");
-        if (parts.size() > 1)
+        StageTimings::Scope scope(timings, StageTimings::StageOSC);
         {
-            if (parts[1] == "client")
+            Benchmark::RouterScope router_scope(benchmark.get(), Benchmark::RouterDrain);
+            receiver.drain(router, received_messages);
+            router_scope.setMessageCount(received_messages.size());
+        }
+        for (std::vector<OSCReceiveThread::TimedMessage>::const_iterator it = received_messages.begin(); it != received_messages.end(); ++it) {
+            Benchmark::RouterScope router_scope(benchmark.get(), Benchmark::RouterDispatch, it->route.leaf);
+            OSCRouter::Route route = it->route;
+            if (route.scope == OSCRouter::ScopeOutput)
             {
-                std::string client_id = client_parameters.getString("client_id");
-                if (parts.size() > 2 && parts[2] == client_id)
+                if (outputs_were_reconfigured)
+                {
+                    /*
+                     An earlier message added or removed an output, so output indices may have changed
+                     */
+                    router.route(it->message.getAddress(), it->message.getAddressLength(), route);
+                }
+                if (route.output >= 0)
                 {
-                    if (parts.size() > 3 && parts[3] == "output")
-                    {
-                        std::string output = parts[4];
-                        parts.erase(parts.begin(), parts.begin() + 5);
-                        address = "/" + ofJoinString(parts, "/");
-                        if (outputs.count(output) > 0)
-                        {
-                            outputs.find(output)->second.doOSCEvent(address, message, frame_was_updated, missed_frames_need_checked);
-                        }
-                        else
-                        {
-                            ofLogWarning() << "Ignoring OSC message for unknown output \"" << output << "\"";
-                        }
-                    }
-                    else
-                    {
-                        parts.erase(parts.begin(), parts.begin() + 3);
-                        address = "/" + ofJoinString(parts, "/");
-                        doClientOSCEvent(address, message, frame_was_updated, missed_frames_need_checked, outputs_were_reconfigured);
-                    }
+                    routed_outputs[route.output]->doOSCEvent(route.leaf, it->message, frame_was_updated, missed_frames_need_checked);
+                }
+                else
+                {
+                    ofLogWarning() << "Ignoring OSC message for unknown output \"" << std::string(it->message.getAddress() + route.output_name_start, route.output_name_length) << "\"";
                 }
             }
             else
             {
-                doClientOSCEvent(address, message, frame_was_updated, missed_frames_need_checked, outputs_were_reconfigured);
+                doClientOSCEvent(*it, frame_was_updated, missed_frames_need_checked, outputs_were_reconfigured);
             }
         }
     }
 
     if (missed_frames_need_checked)
     {
-        bool previous_error_state = in_error;
-        in_error = false;
-        frame_number_errors.clear();
+        in_error = frame_numbers.getDiscontinuityCount() > 0;
+    }
 
-        int previous = 0;
-        for (std::list<int>::const_iterator it = frame_numbers.begin(); it != frame_numbers.end(); ++it) {
-            if (it != frame_numbers.begin())
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageFrameSelection);
+        if (client_parameters.getBool("predictive_clock"))
+        {
+            /*
+            Show the frame which will be due when this one reaches the screen, a frame from now
+            */
+            long predicted_frame;
+            if (frame_clock.getFrame(ofGetElapsedTimeMicros() + (ofGetLastFrameTime() * 1000000.0), predicted_frame) && predicted_frame > current_frame_number)
             {
-                if (previous != *it - 1)
-                {
-                    if (!frame_number_errors.empty())
-                    {
-                        frame_number_errors += ",";
-                    }
-                    frame_number_errors += ofToString(previous) + "->" + ofToString(*it);
-                    in_error = true;
-                }
+                current_frame_number = predicted_frame;
+                frame_was_updated = true;
             }
-            previous = *it;
         }
     }
 
     if (source_changed)
     {
         /*
-        Load our source
+        Load our source in the background, while the current one keeps playing
         */
+        source_loader.load(client_parameters.getString("source"), std::max(client_parameters.getInt("prefetch_frames"), 0) + 1);
+        source_changed = false;
+    }
+    source_loader.setCurrentFrame(current_frame_number);
 
-        std::string source_path = client_parameters.getString("source");
-        std::string source_extension = ofFilePath::getFileExt(source_path);
-        if (ofFile(source_path).isDirectory() || source_extension == ofxHapImage::HapImageFileExtension())
-        {
-            sequence.load(source_path);
-            source_type = SourceSequence;
-        }
-        else if (source_extension == "xml")
-        {
-            playlist.load(source_path);
-            source_type = SourcePlaylist;
+    std::shared_ptr<SourceLoader::Source> loaded_source = source_loader.takeLoaded();
+    if (loaded_source)
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageSource);
+        /*
+        Swap in the new source between frames. Stop the prefetcher using the old source
+        before we replace it.
+        */
+        prefetcher.setSource(std::shared_ptr<FramePathSource>());
+        image.reset();
+        uploaded_image.reset();
+        hap_movie.close();
+        std::shared_ptr<SourceLoader::Source> previous_source = source;
+        source = loaded_source;
+        switch (source->type) {
+            case SourceLoader::TypeSequence:
+            case SourceLoader::TypePlaylist:
+            case SourceLoader::TypePacked:
+                prefetcher.setSource(source);
+                for (std::map<unsigned int, FramePrefetcher::Frame>::iterator it = source->preroll.begin(); it != source->preroll.end(); ++it) {
+                    prefetcher.addFrame(it->first, it->second);
+                }
+                source->preroll.clear();
+                source_type = source->type == SourceLoader::TypePlaylist ? SourcePlaylist : SourceSequence;
+                break;
+            default:
+                if (hap_movie.load(source->path, source->movie_index))
+                {
+                    /*
+                    Hap movies are read from their own index rather than through the player
+                    */
+                    player.close();
+                    hap_movie.setCacheSize(std::max(client_parameters.getInt("movie_cache_frames"), 1));
+                    source_type = SourceHapMovie;
+                }
+                else
+                {
+                    player.loadMovie(source->path);
+                    player.setLoopState(OF_LOOP_NORMAL);
+                    player.setSpeed(0.0);
+                    player.play();
+                    source_type = SourceMovie;
+                }
+                break;
         }
-        else
+        if (client_parameters.getBool("reload_playlists"))
         {
-            player.loadMovie(source_path);
-            player.setLoopState(OF_LOOP_NORMAL);
-            player.setSpeed(0.0);
-            player.play();
-            source_type = SourceMovie;
+            source_loader.watch(source);
         }
+        /*
+        The old source is destroyed off the render thread
+        */
+        source_loader.release(previous_source);
+        frame_was_updated = true;
+    }
 
-        source_changed = false;
+    Playlist::Difference difference;
+    std::shared_ptr<SourceLoader::Source> reloaded_source = source_loader.takeReloaded(difference);
+    if (reloaded_source)
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageSource);
+        /*
+        Apply an edited playlist in place, keeping the frame on screen and loaded frames
+        which haven't changed
+        */
+        prefetcher.reloadSource(reloaded_source, source->size(), difference.unchanged_start, difference.unchanged_end);
+        std::shared_ptr<SourceLoader::Source> previous_source = source;
+        source = reloaded_source;
+        source_loader.watch(source);
+        source_loader.release(previous_source);
     }
 
     if (frame_was_updated)
     {
+        StageTimings::Scope scope(timings, StageTimings::StageFrameLoad);
         // For now, if frame number is out of range, loop around
         int total_frames = 0;
         switch (source_type) {
             case SourceMovie:
                 total_frames = player.getTotalNumFrames();
                 break;
-            case SourceSequence:
-                total_frames = sequence.size();
+            case SourceHapMovie:
+                total_frames = hap_movie.getTotalNumFrames();
                 break;
+            case SourceSequence:
             case SourcePlaylist:
-                total_frames = playlist.size();
+                total_frames = source->size();
                 break;
             default:
                 break;
@@ -245,12 +438,12 @@ void ofApp::update(){
         {
             bool dimensions_changed = false;
             long actual_frame = current_frame_number % total_frames;
-            if (source_type == SourceSequence)
+            if (source_type == SourceSequence || source_type == SourcePlaylist)
             {
-                image.loadImage(sequence[actual_frame]);
-                if (image.getWidth() != image_dimensions.x || image.getHeight() != image_dimensions.y)
+                image = prefetcher.getFrame(actual_frame);
+                if (image && (image->getWidth() != image_dimensions.x || image->getHeight() != image_dimensions.y))
                 {
-                    image_dimensions.set(image.getWidth(), image.getHeight());
+                    image_dimensions.set(image->getWidth(), image->getHeight());
                     dimensions_changed = true;
                 }
             }
@@ -263,12 +456,12 @@ void ofApp::update(){
                     dimensions_changed = true;
                 }
             }
-            else if (source_type == SourcePlaylist)
+            else if (source_type == SourceHapMovie)
             {
-                image.loadImage(playlist[actual_frame]);
-                if (image.getWidth() != image_dimensions.x || image.getHeight() != image_dimensions.y)
+                hap_movie.setFrame(actual_frame);
+                if (hap_movie.getWidth() != image_dimensions.x || hap_movie.getHeight() != image_dimensions.y)
                 {
-                    image_dimensions.set(image.getWidth(), image.getHeight());
+                    image_dimensions.set(hap_movie.getWidth(), hap_movie.getHeight());
                     dimensions_changed = true;
                 }
             }
@@ -292,41 +485,80 @@ void ofApp::update(){
     if (client_parameters_changed || outputs_were_reconfigured)
     {
         /*
-        Save the changed parameters
-         Don't load the existing ones here because https://github.com/openframeworks/openFrameworks/issues/3643
+        Wait for changes to stop before saving, so a stream of changes from the controller
+        is saved once
         */
-        ofXml xml;
-        xml.serialize(client_parameters);
-
-        xml.setTo("//settings");
-        xml.addChild("outputs");
-
-        xml.setTo("outputs");
-
-        for (std::map<std::string, Output>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
-            ofXml output_xml;
-            output_xml.addChild("output");
-            output_xml.setTo("output");
-            output_xml.setAttribute("id", it->first);
-            output_xml.serialize(*it->second.parameters);
-            xml.addXml(output_xml);
+        settings_need_saved = true;
+        settings_changed_time = ofGetElapsedTimeMicros();
+        client_parameters_changed = false;
+    }
+    if (settings_need_saved && ofGetElapsedTimeMicros() - settings_changed_time >= client_parameters.getFloat("settings_save_delay") * 1000000.0)
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageSettings);
+        settings_writer.write(serializeSettings());
+        settings_need_saved = false;
+    }
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageOutputs);
+        for (std::map<std::string, Output>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
+            if (it->second.update(image_dimensions.x, image_dimensions.y))
+            {
+                it->second.geometry_changed = true;
+            }
         }
-        xml.setToParent();
-        xml.setToParent();
+    }
+    player.update();
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageMemory);
+        memory_governor.update(ofGetElapsedTimeMicros());
+    }
 
-        xml.save("settings.xml");
+    if (heartbeat.isDue(ofGetElapsedTimeMicros()))
+    {
+        sendHeartbeat();
+    }
+}
 
-        client_parameters_changed = false;
+std::string ofApp::serializeSettings()
+{
+    /*
+    Don't load the existing settings here because https://github.com/openframeworks/openFrameworks/issues/3643
+    */
+    storeGrids();
+    ofXml xml;
+    xml.serialize(client_parameters);
+
+    xml.setTo("//settings");
+    xml.addChild("outputs");
+
+    xml.setTo("outputs");
+
+    for (std::map<std::string, Output>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        ofXml output_xml;
+        output_xml.addChild("output");
+        output_xml.setTo("output");
+        output_xml.setAttribute("id", it->first);
+        output_xml.serialize(*it->second.parameters);
+        xml.addXml(output_xml);
     }
+    xml.setToParent();
+    xml.setToParent();
+
+    return xml.toString();
+}
+
+void ofApp::storeGrids()
+{
     for (std::map<std::string, Output>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
-        it->second.update(image_dimensions.x, image_dimensions.y);
+        it->second.storeGrid();
     }
-    player.update();
 }
 
-void ofApp::doClientOSCEvent(const std::string& local_address, const ofxOscMessage& message, bool& frame_was_updated, bool& missed_frames_need_checked, bool& outputs_were_reconfigured)
+void ofApp::doClientOSCEvent(const OSCReceiveThread::TimedMessage& received, bool& frame_was_updated, bool& missed_frames_need_checked, bool& outputs_were_reconfigured)
 {
-    if (local_address == "/frame_number_reset")
+    OSCRouter::Leaf leaf = received.route.leaf;
+    const OSCReceiveThread::Message& message = received.message;
+    if (leaf == OSCRouter::LeafFrameNumberReset)
     {
         frame_numbers.clear();
         if (message.getNumArgs() == 1)
@@ -337,44 +569,45 @@ void ofApp::doClientOSCEvent(const std::string& local_address, const ofxOscMessa
         {
             current_frame_number = 0;
         }
+        frame_clock.resetFrame(current_frame_number, received.arrival, received.time_tag);
         in_error = false;
         frame_was_updated = true;
         missed_frames_need_checked = true;
     }
-    else if (local_address == "/frame_number" && message.getNumArgs() == 1)
+    else if (leaf == OSCRouter::LeafFrameNumber && message.getNumArgs() == 1)
     {
         long incoming_frame_number = getMessageInteger(message, 0);
 
-        if (incoming_frame_number > current_frame_number)
+        frame_clock.addFrame(incoming_frame_number, received.arrival, received.time_tag);
+        /*
+        While the predictive clock is locked it decides which frame to show
+        */
+        bool clock_is_driving = client_parameters.getBool("predictive_clock") && frame_clock.isLocked();
+        if (incoming_frame_number > current_frame_number && !clock_is_driving)
         {
             current_frame_number = incoming_frame_number;
             frame_was_updated = true;
         }
 
-        frame_numbers.push_back(incoming_frame_number);
-
-        while (frame_numbers.size() > 300)
-        {
-            frame_numbers.pop_front();
-        }
+        frame_numbers.add(incoming_frame_number, received.arrival);
         missed_frames_need_checked = true;
     }
-    else if (local_address == "/display_stats" && message.getNumArgs() == 1)
+    else if (leaf == OSCRouter::LeafDisplayStats && message.getNumArgs() == 1)
     {
         client_parameters["show_stats"].cast<bool>() = getMessageInteger(message, 0);
     }
-    else if (local_address == "/full_screen" && message.getNumArgs() == 1)
+    else if (leaf == OSCRouter::LeafFullScreen && message.getNumArgs() == 1)
     {
         bool full_screen = getMessageInteger(message, 0);
         client_parameters["full_screen"].cast<bool>() = full_screen;
         ofSetFullscreen(full_screen);
     }
-    else if (local_address == "/source" && message.getNumArgs() == 1)
+    else if (leaf == OSCRouter::LeafSource && message.getNumArgs() == 1)
     {
         client_parameters["source"].cast<string>() = message.getArgAsString(0);
         source_changed = true;
     }
-    else if (local_address == "/add_output")
+    else if (leaf == OSCRouter::LeafAddOutput)
     {
         std::string name;
         if (message.getNumArgs() == 1)
@@ -388,19 +621,21 @@ void ofApp::doClientOSCEvent(const std::string& local_address, const ofxOscMessa
         if (outputs.count(name) == 0)
         {
             outputs.insert(std::pair<std::string, Output>(name, Output(name)));
+            outputsChanged();
             outputs_were_reconfigured = true;
         }
     }
-    else if (local_address == "/delete_output" && message.getNumArgs() == 1)
+    else if (leaf == OSCRouter::LeafDeleteOutput && message.getNumArgs() == 1)
     {
         std::string name = message.getArgAsString(0);
         if (outputs.count(name) == 1)
         {
             outputs.erase(name);
+            outputsChanged();
             outputs_were_reconfigured = true;
         }
     }
-    else if (local_address == "/send_config" && message.getNumArgs() == 1)
+    else if (leaf == OSCRouter::LeafSendConfig && message.getNumArgs() == 1)
     {
         std::string destination = message.getArgAsString(0);
         std::vector<std::string> parts = ofSplitString(destination, ":");
@@ -426,6 +661,7 @@ void ofApp::doClientOSCEvent(const std::string& local_address, const ofxOscMessa
             xml.setValue("source", client_parameters["source"].toString());
             xml.addChild("outputs");
             xml.setTo("outputs");
+            storeGrids();
             for (std::map<std::string, Output>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
                 ofXml output_xml;
                 output_xml.addChild("output");
@@ -442,101 +678,219 @@ void ofApp::doClientOSCEvent(const std::string& local_address, const ofxOscMessa
         }
 
     }
+    else if (leaf == OSCRouter::LeafFrameStats && message.getNumArgs() == 1)
+    {
+        std::string destination = message.getArgAsString(0);
+        std::vector<std::string> parts = ofSplitString(destination, ":");
+        if (parts.size() == 2)
+        {
+            ofxOscSender sender;
+            sender.setup(parts[0], ofToInt(parts[1]));
+            ofxOscMessage message;
+            message.setAddress("/client/frame_stats");
+            message.addStringArg(client_parameters["client_id"].toString());
+            message.addInt64Arg(frame_numbers.getLastFrameNumber());
+            message.addIntArg(frame_numbers.size());
+            message.addIntArg(frame_numbers.getGapCount());
+            message.addIntArg(frame_numbers.getReorderCount());
+            message.addIntArg(frame_numbers.getSkippedFrameCount());
+            message.addFloatArg(frame_numbers.getMeanInterval());
+            message.addFloatArg(frame_numbers.getJitter());
+            message.addStringArg(frame_numbers.getSummary());
+            sender.sendMessage(message);
+        }
+    }
+    else if (leaf == OSCRouter::LeafHeartbeat && (message.getNumArgs() == 1 || message.getNumArgs() == 2))
+    {
+        client_parameters["heartbeat_destination"].cast<std::string>() = message.getArgAsString(0);
+        if (message.getNumArgs() == 2)
+        {
+            client_parameters["heartbeat_interval"].cast<float>() = getMessageFloat(message, 1);
+        }
+        setupHeartbeat();
+    }
+    else if (leaf == OSCRouter::LeafDumpTrace && message.getNumArgs() <= 1)
+    {
+        dumpTrace(message.getNumArgs() == 1 ? getMessageFloat(message, 0) : client_parameters.getFloat("trace_seconds"));
+    }
     else
     {
         /*
          For any other address, forward it to every output
          */
         for (std::map<std::string, Output>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
-            it->second.doOSCEvent(local_address, message, frame_was_updated, missed_frames_need_checked);
+            it->second.doOSCEvent(leaf, message, frame_was_updated, missed_frames_need_checked);
         }
     }
 }
 
-void ofApp::Output::doOSCEvent(const std::string &local_address, const ofxOscMessage& message, bool &frame_was_updated, bool &missed_frames_need_checked)
+void ofApp::dumpTrace(float seconds)
 {
-    if (local_address == "/crop/active" && message.getNumArgs() == 1)
-    {
-        parameters->get("crop_active").cast<bool>() = getMessageInteger(message, 0);
-    }
-    else if (local_address == "/crop/x" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("crop_origin", 0, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/crop/y" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("crop_origin", 1, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/crop/width" && message.getNumArgs() == 1)
-    {
-        parameters->get("crop_width").cast<float>() = getMessageFloat(message, 0);
-    }
-    else if (local_address == "/crop/height" && message.getNumArgs() == 1)
+    Tracer& tracer = Tracer::getShared();
+    if (!tracer.isEnabled())
     {
-        parameters->get("crop_height").cast<float>() = getMessageFloat(message, 0);
+        ofLogWarning("ofApp") << "Set tracing to 1 in settings.xml to record traces";
+        return;
     }
-    else if (local_address == "/warp/top_left/x" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("warp_top_left", 0, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/warp/top_left/y" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("warp_top_left", 1, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/warp/top_right/x" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("warp_top_right", 0, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/warp/top_right/y" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("warp_top_right", 1, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/warp/bottom_right/x" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("warp_bottom_right", 0, getMessageFloat(message, 0));
-    }
-    else if (local_address == "/warp/bottom_right/y" && message.getNumArgs() == 1)
+    tracer.write("trace-" + ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".json", seconds);
+}
+
+void ofApp::setupHeartbeat()
+{
+    heartbeat.setup(client_parameters.getString("heartbeat_destination"), client_parameters.getFloat("heartbeat_interval"));
+    timings.setLatestEnabled(heartbeat.isActive());
+}
+
+void ofApp::sendHeartbeat()
+{
+    Heartbeat::Status status;
+    status.displayed_frame = current_frame_number;
+    status.received_frame = frame_numbers.getLastFrameNumber();
+    status.decode_time = timings.getLatest(StageTimings::StageFrameLoad) / 1000.0;
+    status.draw_time = timings.getLatest(StageTimings::StageDraw) / 1000.0;
+    status.frame_rate = ofGetFrameRate();
+    status.discontinuities = frame_numbers.getDiscontinuityCount();
+    status.cache_hits = status.cache_misses = 0;
+    if (source_type == SourceSequence || source_type == SourcePlaylist)
     {
-        updatePointParameter("warp_bottom_right", 1, getMessageFloat(message, 0));
+        status.cache_hits = prefetcher.getHitCount();
+        status.cache_misses = prefetcher.getMissCount();
     }
-    else if (local_address == "/warp/bottom_left/x" && message.getNumArgs() == 1)
+    else if (source_type == SourceHapMovie)
     {
-        updatePointParameter("warp_bottom_left", 0, getMessageFloat(message, 0));
+        status.cache_hits = hap_movie.getCacheHitCount();
+        status.cache_misses = hap_movie.getCacheMissCount();
     }
-    else if (local_address == "/warp/bottom_left/y" && message.getNumArgs() == 1)
-    {
-        updatePointParameter("warp_bottom_left", 1, getMessageFloat(message, 0));
+    heartbeat.send(client_parameters.getString("client_id"), status, ofGetElapsedTimeMicros());
+}
+
+void ofApp::outputsChanged()
+{
+    std::vector<std::string> names;
+    routed_outputs.clear();
+    for (std::map<std::string, Output>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        names.push_back(it->first);
+        routed_outputs.push_back(&it->second);
     }
-    else if (local_address == "/blend/top" && message.getNumArgs() == 1)
+    router.setOutputs(names);
+    output_batch_changed = true;
+}
+
+void ofApp::Output::doOSCEvent(OSCRouter::Leaf leaf, const OSCReceiveThread::Message& message, bool &frame_was_updated, bool &missed_frames_need_checked)
+{
+    if (leaf == OSCRouter::LeafGridSize && message.getNumArgs() == 2)
     {
-        parameters->get("blend_top").cast<float>() = getMessageFloat(message, 0);
+        /*
+         Resizing the grid discards its offsets
+         */
+        GridWarp resized;
+        resized.setup(ofClamp(getMessageInteger(message, 0), 0, 64), ofClamp(getMessageInteger(message, 1), 0, 64));
+        parameters->get(ParameterGridWarp).cast<std::string>() = resized.serialize();
+        return;
     }
-    else if (local_address == "/blend/right" && message.getNumArgs() == 1)
+    if (leaf == OSCRouter::LeafGridPoint && message.getNumArgs() == 4)
     {
-        parameters->get("blend_right").cast<float>() = getMessageFloat(message, 0);
+        /*
+         Moving a point doesn't touch the parameter, so only the affected cells are updated
+         */
+        ofPoint offset(getMessageFloat(message, 2), getMessageFloat(message, 3));
+        if (grid.setOffset(getMessageInteger(message, 0), getMessageInteger(message, 1), offset))
+        {
+            grid_changed = true;
+            parameters_changed = true;
+        }
+        return;
     }
-    else if (local_address == "/blend/bottom" && message.getNumArgs() == 1)
+    if (message.getNumArgs() != 1)
     {
-        parameters->get("blend_bottom").cast<float>() = getMessageFloat(message, 0);
+        return;
     }
-    else if (local_address == "/blend/left" && message.getNumArgs() == 1)
+    switch (leaf)
     {
-        parameters->get("blend_left").cast<float>() = getMessageFloat(message, 0);
+    case OSCRouter::LeafCropActive:
+        parameters->get(ParameterCropActive).cast<bool>() = getMessageInteger(message, 0);
+        break;
+    case OSCRouter::LeafCropX:
+        updatePointParameter(ParameterCropOrigin, 0, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafCropY:
+        updatePointParameter(ParameterCropOrigin, 1, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafCropWidth:
+        parameters->get(ParameterCropWidth).cast<float>() = getMessageFloat(message, 0);
+        break;
+    case OSCRouter::LeafCropHeight:
+        parameters->get(ParameterCropHeight).cast<float>() = getMessageFloat(message, 0);
+        break;
+    case OSCRouter::LeafWarpTopLeftX:
+        updatePointParameter(ParameterWarpTopLeft, 0, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpTopLeftY:
+        updatePointParameter(ParameterWarpTopLeft, 1, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpTopRightX:
+        updatePointParameter(ParameterWarpTopRight, 0, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpTopRightY:
+        updatePointParameter(ParameterWarpTopRight, 1, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpBottomRightX:
+        updatePointParameter(ParameterWarpBottomRight, 0, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpBottomRightY:
+        updatePointParameter(ParameterWarpBottomRight, 1, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpBottomLeftX:
+        updatePointParameter(ParameterWarpBottomLeft, 0, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafWarpBottomLeftY:
+        updatePointParameter(ParameterWarpBottomLeft, 1, getMessageFloat(message, 0));
+        break;
+    case OSCRouter::LeafBlendTop:
+        parameters->get(ParameterBlendTop).cast<float>() = getMessageFloat(message, 0);
+        break;
+    case OSCRouter::LeafBlendRight:
+        parameters->get(ParameterBlendRight).cast<float>() = getMessageFloat(message, 0);
+        break;
+    case OSCRouter::LeafBlendBottom:
+        parameters->get(ParameterBlendBottom).cast<float>() = getMessageFloat(message, 0);
+        break;
+    case OSCRouter::LeafBlendLeft:
+        parameters->get(ParameterBlendLeft).cast<float>() = getMessageFloat(message, 0);
+        break;
+    default:
+        break;
     }
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
+    if (benchmark)
+    {
+        // Benchmarks run without a window
+        return;
+    }
+    StageTimings::Scope draw_scope(timings, StageTimings::StageDraw);
     bool show_stats = client_parameters.getBool("show_stats");
     ofTexture *texture = NULL;
     ofShader *shader = NULL;
     if (source_type == SourceSequence || source_type == SourcePlaylist)
     {
-        if (image.getImageType() == ofxHapImage::IMAGE_TYPE_HAP_Q)
+        if (image)
         {
-            shader = &image.getShaderReference();
+            if (image != uploaded_image)
+            {
+                image->upload(image_texture);
+                uploaded_image = image;
+            }
+            shader = image->getShader(image_texture);
+            texture = image->getTexture(image_texture);
         }
-        texture = &image.getTextureReference();
+    }
+    else if (source_type == SourceHapMovie)
+    {
+        shader = hap_movie.getShader();
+        texture = hap_movie.getTexture();
     }
     else if (player.isLoaded())
     {
@@ -545,14 +899,47 @@ void ofApp::draw(){
     }
 
     if (texture != NULL)
+    {
+        StageTimings::Scope scope(timings, StageTimings::StageDrawOutputs);
+        /*
+        Rebuild the batch when outputs are added or removed or the texture's shape has
+        changed, otherwise pass it only the outputs whose geometry has changed
+        */
+        bool rebuild = output_batch_changed || output_batch.needsRebuild(*texture);
+        if (rebuild)
+        {
+            output_batch.setOutputCount(outputs.size());
+            output_batch_changed = false;
+        }
+        OutputBatch::Geometry geometry;
+        unsigned int index = 0;
+        for (std::map<std::string, Output>::iterator it = outputs.begin(); it != outputs.end(); ++it, ++index) {
+            if (rebuild || it->second.geometry_changed)
+            {
+                geometry.clear();
+                it->second.addTo(geometry, *texture);
+                output_batch.setOutput(index, geometry);
+                it->second.geometry_changed = false;
+            }
+        }
+        output_batch.draw(*texture, shader);
+    }
+    if (texture != NULL && FrameFingerprint::isEnabled() && source_type != SourceMovie)
+    {
+        fingerprints.add(current_frame_number,
+                         source_type == SourceHapMovie ? hap_movie.getFingerprint() : image->fingerprint,
+                         FrameFingerprint::getPresentTime());
+    }
+    if (show_stats)
     {
         for (std::map<std::string, Output>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
-            it->second.draw(*texture, shader, show_stats);
+            it->second.drawStats();
         }
     }
 
     if (show_stats)
     {
+        StageTimings::Scope scope(timings, StageTimings::StageDrawStats);
         ofPushStyle();
         if (in_error)
         {
@@ -569,15 +956,71 @@ void ofApp::draw(){
         std::vector<std::string> messages;
         std::string client_id = client_parameters.getString("client_id");
         messages.push_back("Client ID: " + client_id + " " + ofToString(ofGetFrameRate(), 0) + " FPS");
+        messages.push_back("Frame interval: " + ofToString(frame_numbers.getMeanInterval() * 1000.0, 2) + "ms jitter " + ofToString(frame_numbers.getJitter() * 1000.0, 2) + "ms");
 
         if (source_type == SourceMovie && !player.isLoaded())
         {
             std::string source_path = client_parameters.getString("source");
             messages.push_back("Frame source not loaded: " + source_path);
         }
+        if (source_type == SourceSequence || source_type == SourcePlaylist)
+        {
+            messages.push_back("Prefetch (" + ofToString(prefetcher.getWindow()) + " frames): " + ofToString(prefetcher.getHitCount()) + " hits " + ofToString(prefetcher.getMissCount()) + " misses");
+        }
+        std::string loader_status = source_loader.getStatus();
+        if (!loader_status.empty())
+        {
+            messages.push_back(loader_status);
+        }
+        if (source_type == SourceHapMovie)
+        {
+            messages.push_back("Movie cache: " + ofToString(hap_movie.getCacheHitCount()) + " hits " + ofToString(hap_movie.getCacheMissCount()) + " misses " + ofToString(hap_movie.getSeekCount()) + " seeks");
+            if (shared_frame_cache.isOpen())
+            {
+                messages.push_back("Shared frames (" + shared_frame_cache.getName() + ", " + ofToString(shared_frame_cache.getProcessCount()) + " processes): " + ofToString(shared_frame_cache.getHitCount()) + " used, " + ofToString(shared_frame_cache.getPublishCount()) + " published");
+            }
+            HapDecodePool& decode_pool = HapDecodePool::getShared();
+            unsigned long decode_frames = decode_pool.getFrameCount();
+            messages.push_back("Hap decode: " + ofToString(decode_pool.getThreadCount() + 1) + " threads, " + (decode_frames > 0 ? ofToString(double(decode_pool.getChunkCount()) / decode_frames, 1) : std::string("0")) + " chunks per frame");
+        }
+        FrameBufferPool::Statistics buffer_statistics = FrameBufferPool::getShared().getStatistics();
+        messages.push_back("Frame buffers: " + ofToString(buffer_statistics.in_use / (1024.0 * 1024.0), 1) + "MB in use " + ofToString(buffer_statistics.high_water / (1024.0 * 1024.0), 1) + "MB peak " + ofToString(buffer_statistics.retained / (1024.0 * 1024.0), 1) + "MB free, " + ofToString(buffer_statistics.allocations) + " allocations " + ofToString(buffer_statistics.reuses) + " reuses");
+        std::vector<MemoryGovernor::Usage> memory_usage = memory_governor.getUsage();
+        uint64_t memory_total = 0;
+        std::string memory_consumers;
+        for (std::vector<MemoryGovernor::Usage>::const_iterator it = memory_usage.begin(); it != memory_usage.end(); ++it) {
+            memory_total += it->bytes;
+            memory_consumers += (memory_consumers.empty() ? "" : ", ") + it->name + " " + ofToString(it->bytes / (1024.0 * 1024.0), 1) + "MB";
+        }
+        messages.push_back("Memory: " + ofToString(memory_total / (1024.0 * 1024.0), 1) + "MB of " + (memory_governor.getBudget() > 0 ? ofToString(memory_governor.getBudget() / (1024.0 * 1024.0), 0) + "MB" : std::string("unlimited")) + " (" + memory_consumers + "), " + ofToString(memory_governor.getEvictionCount()) + " evictions " + ofToString(memory_governor.getPressureCount()) + " pressure events");
+        if (FrameFingerprint::isEnabled())
+        {
+            FrameFingerprint::Record record = fingerprints.getLastRecord();
+            messages.push_back("Fingerprint: frame " + ofToString(record.frame) + " " + ofToHex(record.hash) + ", " + ofToString(fingerprints.getRecordCount()) + " frames");
+        }
+        if (client_parameters.getBool("predictive_clock"))
+        {
+            messages.push_back("Predictive clock: " + (frame_clock.isLocked() ? ofToString(frame_clock.getFrameRate(), 3) + " FPS" : std::string("not locked")));
+        }
+        if (receiver.getDroppedCount() > 0)
+        {
+            messages.push_back("OSC messages dropped: " + ofToString(receiver.getDroppedCount()));
+        }
+        if (receiver.getReceiveCallCount() > 0)
+        {
+            messages.push_back("OSC packets: " + ofToString(receiver.getDatagramCount()) + " in " + ofToString(receiver.getReceiveCallCount()) + " reads, " + ofToString(receiver.getKernelDroppedCount()) + " dropped by the system");
+        }
+        if (client_parameters.getBool("record_osc") && !replayer)
+        {
+            messages.push_back("Recording OSC: " + ofToString(recorder.getRecordedCount()) + " packets " + ofToString(recorder.getDroppedCount()) + " dropped");
+        }
+        if (replayer)
+        {
+            messages.push_back("Replaying OSC: " + ofToString(replayer->getReplayedCount()) + " packets" + (replayer->isFinished() ? " (finished)" : ""));
+        }
         if (in_error)
         {
-            messages.push_back("Frame discontinuities: " + frame_number_errors);
+            messages.push_back("Frame discontinuities: " + frame_numbers.getSummary());
         }
 
         float y_offset = 40;
@@ -593,8 +1036,38 @@ void ofApp::draw(){
     }
 }
 
+//--------------------------------------------------------------
+void ofApp::exit(){
+    /*
+    Save any changes we were waiting to save
+    */
+    if (client_parameters_changed || settings_need_saved)
+    {
+        settings_writer.write(serializeSettings());
+    }
+    settings_writer.close();
+    /*
+    Stop anything which feeds the receiver before the recorder it feeds
+    */
+    if (replayer)
+    {
+        replayer->close();
+    }
+    receiver.close();
+    recorder.close();
+    fingerprints.flush();
+    memory_governor.close();
+    hap_movie.setSharedCache(NULL);
+    shared_frame_cache.close();
+    HapDecodePool::getShared().close();
+}
+
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
+    if (key == 't')
+    {
+        dumpTrace(client_parameters.getFloat("trace_seconds"));
+    }
 
 }
 
@@ -646,9 +1119,12 @@ void ofApp::parameterChanged(ofAbstractParameter & parameter)
 }
 
 ofApp::Output::Output(std::string n) :
-name(n), dimensions_changed(true), bounding_box(ofRectangle()), crop_box(ofRectangle()), parameters(new ofParameterGroup()), parameters_changed(false)
+name(n), dimensions_changed(true), bounding_box(ofRectangle()), crop_box(ofRectangle()), parameters(new ofParameterGroup()), parameters_changed(false), grid_changed(false), storing_grid(false), geometry_changed(true)
 {
     parameters->setName("output_settings");
+    /*
+     Parameters must be added in the order of the Parameter enum, which doOSCEvent() uses to find them
+     */
     ofParameter<std::string> name_param("name", name);
     parameters->add(name_param);
     ofParameter<bool> crop_active_param("crop_active", false);
@@ -675,6 +1151,8 @@ name(n), dimensions_changed(true), bounding_box(ofRectangle()), crop_box(ofRecta
     parameters->add(blend_bottom_param);
     ofParameter<float> blend_left_param("blend_left", 0.0);
     parameters->add(blend_left_param);
+    ofParameter<std::string> grid_warp_param("grid_warp", "");
+    parameters->add(grid_warp_param);
 
     /*
      Monitor any subsequent settings changes so we can save them
@@ -700,6 +1178,10 @@ ofApp::Output& ofApp::Output::operator = (const ofApp::Output& b)
 
     blends = b.blends;
     warper = b.warper;
+    grid = b.grid;
+    grid_changed = b.grid_changed;
+    storing_grid = false;
+    geometry_changed = b.geometry_changed;
 
     ofAddListener(parameters->parameterChangedE, this, &ofApp::Output::parameterChanged);
     return *this;
@@ -713,25 +1195,37 @@ parameters_changed(p.parameters_changed),
 bounding_box(p.bounding_box),
 crop_box(p.crop_box),
 blends(p.blends),
-warper(p.warper)
+warper(p.warper),
+grid(p.grid),
+grid_changed(p.grid_changed),
+storing_grid(false),
+geometry_changed(p.geometry_changed)
 {
     ofAddListener(parameters->parameterChangedE, this, &ofApp::Output::parameterChanged);
 }
 
 void ofApp::Output::parameterChanged(ofAbstractParameter &parameter)
 {
+    if (storing_grid)
+    {
+        return;
+    }
+    if (parameter.getName() == "grid_warp")
+    {
+        grid.deserialize(parameter.cast<std::string>());
+    }
     parameters_changed = true;
     dimensions_changed = true;
 }
 
-void ofApp::Output::updatePointParameter(std::string name, int index, float value)
+void ofApp::Output::updatePointParameter(Parameter parameter, int index, float value)
 {
-    ofPoint current = parameters->get(name).cast<ofPoint>();
+    ofPoint current = parameters->get(parameter).cast<ofPoint>();
     current[index] = value;
-    parameters->get(name).cast<ofPoint>() = current;
+    parameters->get(parameter).cast<ofPoint>() = current;
 }
 
-void ofApp::Output::update(float image_width, float image_height)
+bool ofApp::Output::update(float image_width, float image_height)
 {
     if (dimensions_changed)
     {
@@ -763,104 +1257,107 @@ void ofApp::Output::update(float image_width, float image_height)
         warper.setCorner(ofxGLWarper::BOTTOM_LEFT, ofPoint(1, -1) * parameters->getPoint("warp_bottom_left").get() + warper.getCorner(ofxGLWarper::BOTTOM_LEFT));
         warper.setCorner(ofxGLWarper::BOTTOM_RIGHT, ofPoint(1, -1) * parameters->getPoint("warp_bottom_right").get() + warper.getCorner(ofxGLWarper::BOTTOM_RIGHT));
 
+        grid.setBounds(bounding_box);
+        grid.update();
+        updateBlends();
+        dimensions_changed = false;
+        grid_changed = false;
+        return true;
+    }
+    else if (grid_changed)
+    {
         /*
-         Update blend meshes
+         Only the cells around moved control points are re-tessellated
          */
-        blends.clear();
-        if (parameters->getFloat("blend_top") > 0.0)
-        {
-            ofPoint adjustment(0.0, parameters->getFloat("blend_top"));
-            ofMesh mesh;
-            mesh.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
-            mesh.addVertex(bounding_box.position);
-            mesh.addColor(ofColor::black);
-            mesh.addVertex(bounding_box.getTopRight());
-            mesh.addColor(ofColor::black);
-            mesh.addVertex(bounding_box.getTopLeft() + adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            mesh.addVertex(bounding_box.getTopRight() + adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            blends.push_back(mesh);
-        }
-        if (parameters->getFloat("blend_right") > 0.0)
-        {
-            ofPoint adjustment(parameters->getFloat("blend_right"), 0.0);
-            ofMesh mesh;
-            mesh.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
-            mesh.addVertex(bounding_box.getTopRight() - adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            mesh.addVertex(bounding_box.getTopRight());
-            mesh.addColor(ofColor::black);
-            mesh.addVertex(bounding_box.getBottomRight() - adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            mesh.addVertex(bounding_box.getBottomRight());
-            mesh.addColor(ofColor::black);
-            blends.push_back(mesh);
-        }
-        if (parameters->getFloat("blend_bottom") > 0.0)
-        {
-            ofPoint adjustment(0.0, parameters->getFloat("blend_bottom"));
-            ofMesh mesh;
-            mesh.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
-            mesh.addVertex(bounding_box.getBottomLeft() - adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            mesh.addVertex(bounding_box.getBottomRight() - adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            mesh.addVertex(bounding_box.getBottomLeft());
-            mesh.addColor(ofColor::black);
-            mesh.addVertex(bounding_box.getBottomRight());
-            mesh.addColor(ofColor::black);
-            blends.push_back(mesh);
-        }
-        if (parameters->getFloat("blend_left") > 0.0)
-        {
-            ofPoint adjustment(parameters->getFloat("blend_left"), 0.0);
-            ofMesh mesh;
-            mesh.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
-            mesh.addVertex(bounding_box.position);
-            mesh.addColor(ofColor::black);
-            mesh.addVertex(bounding_box.getTopLeft() + adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            mesh.addVertex(bounding_box.getBottomLeft());
-            mesh.addColor(ofColor::black);
-            mesh.addVertex(bounding_box.getBottomLeft() + adjustment);
-            mesh.addColor(ofColor(0.0, 0.0));
-            blends.push_back(mesh);
-        }
-        dimensions_changed = false;
+        grid.update();
+        updateBlends();
+        grid_changed = false;
+        return true;
     }
+    return false;
 }
 
-void ofApp::Output::draw(ofTexture &texture, ofShader *shader, bool show_stats)
+void ofApp::Output::updateBlends()
 {
-    warper.begin();
-
-    if (shader)
+    /*
+     Blends follow the grid, so are divided as finely as it is
+     */
+    unsigned int horizontal_segments = grid.isActive() ? grid.getVertexColumns() - 1 : 1;
+    unsigned int vertical_segments = grid.isActive() ? grid.getVertexRows() - 1 : 1;
+    blends.clear();
+    if (parameters->getFloat("blend_top") > 0.0)
+    {
+        blends.push_back(makeBlend(bounding_box.getTopLeft(), bounding_box.getTopRight(), ofPoint(0.0, parameters->getFloat("blend_top")), horizontal_segments));
+    }
+    if (parameters->getFloat("blend_right") > 0.0)
     {
-        shader->begin();
+        blends.push_back(makeBlend(bounding_box.getTopRight(), bounding_box.getBottomRight(), ofPoint(-parameters->getFloat("blend_right"), 0.0), vertical_segments));
     }
-    texture.drawSubsection(bounding_box.x, bounding_box.y, bounding_box.width, bounding_box.height, crop_box.x, crop_box.y, crop_box.width, crop_box.height);
-    if (shader)
+    if (parameters->getFloat("blend_bottom") > 0.0)
     {
-        shader->end();
+        blends.push_back(makeBlend(bounding_box.getBottomLeft(), bounding_box.getBottomRight(), ofPoint(0.0, -parameters->getFloat("blend_bottom")), horizontal_segments));
     }
-    for (std::vector<ofMesh>::iterator it = blends.begin(); it != blends.end(); ++it)
+    if (parameters->getFloat("blend_left") > 0.0)
     {
-        it->draw();
+        blends.push_back(makeBlend(bounding_box.getTopLeft(), bounding_box.getBottomLeft(), ofPoint(parameters->getFloat("blend_left"), 0.0), vertical_segments));
     }
+}
 
-    if (show_stats)
+ofMesh ofApp::Output::makeBlend(const ofPoint& start, const ofPoint& end, const ofPoint& inward, unsigned int segments) const
+{
+    /*
+     A strip from opaque black along the edge to transparent at the blend distance inside it
+     */
+    ofMesh mesh;
+    mesh.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
+    for (unsigned int i = 0; i <= segments; i++)
     {
-        ofPushStyle();
-        ofSetColor(128, 128, 128, 128);
-        ofSetLineWidth(1.0);
-        ofFill();
-        ofRect(bounding_box);
-        ofPopStyle();
+        ofPoint edge = start.getInterpolated(end, float(i) / segments);
+        mesh.addVertex(grid.map(edge));
+        mesh.addColor(ofColor::black);
+        mesh.addVertex(grid.map(edge + inward));
+        mesh.addColor(ofColor(0.0, 0.0));
+    }
+    return mesh;
+}
 
-        ofPoint draw_point = bounding_box.getCenter() - ofPoint(30, 200);
-        ofDrawBitmapString("Output: " + name, draw_point);
+void ofApp::Output::addTo(OutputBatch::Geometry& geometry, ofTexture& texture)
+{
+    ofMatrix4x4 warp = warper.getMatrix();
+    if (grid.isActive())
+    {
+        geometry.addGrid(warp, grid.getVertices(), grid.getVertexColumns(), grid.getVertexRows(), crop_box, texture);
     }
+    else
+    {
+        geometry.addImage(warp, bounding_box, crop_box, texture);
+    }
+    for (std::vector<ofMesh>::const_iterator it = blends.begin(); it != blends.end(); ++it)
+    {
+        geometry.addStrip(warp, *it);
+    }
+}
+
+void ofApp::Output::storeGrid()
+{
+    storing_grid = true;
+    parameters->get(ParameterGridWarp).cast<std::string>() = grid.serialize();
+    storing_grid = false;
+}
+
+void ofApp::Output::drawStats()
+{
+    warper.begin();
+
+    ofPushStyle();
+    ofSetColor(128, 128, 128, 128);
+    ofSetLineWidth(1.0);
+    ofFill();
+    ofRect(bounding_box);
+    ofPopStyle();
+
+    ofPoint draw_point = bounding_box.getCenter() - ofPoint(30, 200);
+    ofDrawBitmapString("Output: " + name, draw_point);
 
     warper.end();
-}
\ No newline at end of file
+}
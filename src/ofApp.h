@@ -6,13 +6,35 @@
 #include <ofxHapImageSequence.h>
 #include <ofxGLWarper.h>
 #include "Playlist.h"
+#include "FramePrefetcher.h"
+#include "OSCRouter.h"
+#include "FrameNumberTracker.h"
+#include "OSCReceiveThread.h"
+#include "FrameClock.h"
+#include "SettingsWriter.h"
+#include "StageTimings.h"
+#include "Benchmark.h"
+#include "OSCRecorder.h"
+#include "OSCReplayer.h"
+#include "OutputBatch.h"
+#include "GridWarp.h"
+#include "HapMovie.h"
+#include "SourceLoader.h"
+#include "FrameBufferPool.h"
+#include "HapDecodePool.h"
+#include "FrameFingerprint.h"
+#include "MemoryGovernor.h"
+#include "SharedFrameCache.h"
+#include "Heartbeat.h"
 
 class ofApp : public ofBaseApp{
 
 	public:
+		ofApp(Benchmark *benchmark = NULL, OSCReplayer *replayer = NULL);
 		void setup();
 		void update();
 		void draw();
+		void exit();
 
 		void keyPressed(int key);
 		void keyReleased(int key);
@@ -32,12 +54,41 @@ private:
             ~Output();
             Output& operator = (const Output& b);
             Output(const Output& p);
-            void update(float image_width, float image_height);
-            void draw(ofTexture& texture, ofShader *shader, bool show_stats);
-            void doOSCEvent(const std::string& local_address, const ofxOscMessage& message, bool& frame_was_updated, bool& missed_frames_need_checked);
+            /*
+             Returns true if the output's geometry changed
+             */
+            bool update(float image_width, float image_height);
+            void addTo(OutputBatch::Geometry& geometry, ofTexture& texture);
+            void drawStats();
+            /*
+             Copies the grid into its parameter, which is only kept up to date for saving
+             */
+            void storeGrid();
+            void doOSCEvent(OSCRouter::Leaf leaf, const OSCReceiveThread::Message& message, bool& frame_was_updated, bool& missed_frames_need_checked);
         private:
-            void updatePointParameter(std::string name, int index, float value);
+            /*
+             Positions of parameters in the group, in the order they are added
+             */
+            enum Parameter {
+                ParameterName,
+                ParameterCropActive,
+                ParameterCropOrigin,
+                ParameterCropWidth,
+                ParameterCropHeight,
+                ParameterWarpTopLeft,
+                ParameterWarpTopRight,
+                ParameterWarpBottomRight,
+                ParameterWarpBottomLeft,
+                ParameterBlendTop,
+                ParameterBlendRight,
+                ParameterBlendBottom,
+                ParameterBlendLeft,
+                ParameterGridWarp
+            };
+            void updatePointParameter(Parameter parameter, int index, float value);
             void parameterChanged(ofAbstractParameter & parameter);
+            void updateBlends();
+            ofMesh makeBlend(const ofPoint& start, const ofPoint& end, const ofPoint& inward, unsigned int segments) const;
             std::string name;
 
             bool dimensions_changed;
@@ -47,41 +98,85 @@ private:
 
             std::vector<ofMesh> blends;
             ofxGLWarper warper;
+            GridWarp grid;
+            bool grid_changed;
+            bool storing_grid;
+            // Whether the geometry changed since it was last given to the batch
+            bool geometry_changed;
 
             std::shared_ptr<ofParameterGroup> parameters;
         };
-        void doClientOSCEvent(const std::string& local_address,
-                              const ofxOscMessage& message,
+        void doClientOSCEvent(const OSCReceiveThread::TimedMessage& received,
                               bool& frame_was_updated,
                               bool& missed_frames_need_checked,
                               bool& outputs_were_reconfigured);
         void parameterChanged(ofAbstractParameter & parameter);
+        void outputsChanged();
+        void loadSettings();
+        void storeGrids();
+        /*
+         Writes the last seconds of tracing to data/
+         */
+        void dumpTrace(float seconds);
+        void setupHeartbeat();
+        void sendHeartbeat();
+        std::string serializeSettings();
 
-		ofxOscReceiver receiver;
-		std::list<int> frame_numbers;
+		// Before receiver, which passes it packets until destroyed
+		OSCRecorder recorder;
+		OSCReceiveThread receiver;
+		std::vector<OSCReceiveThread::TimedMessage> received_messages;
+		FrameNumberTracker frame_numbers;
+		FrameClock frame_clock;
 
         bool source_changed;
 		bool in_error;
 		int current_frame_number;
         std::map<std::string, Output> outputs;
+        OSCRouter router;
+        // Outputs in the order their names were given to router
+        std::vector<Output *> routed_outputs;
+        OutputBatch output_batch;
+        bool output_batch_changed;
 
 		ofTrueTypeFont font;
 
 		ofParameterGroup client_parameters;
 		bool client_parameters_changed;
+		SettingsWriter settings_writer;
+		bool settings_need_saved;
+		uint64_t settings_changed_time;
+
+		// Set when running headless with a scripted workload
+		std::shared_ptr<Benchmark> benchmark;
+		StageTimings timings;
+		Heartbeat heartbeat;
+		FrameFingerprint fingerprints;
+		// Set when replaying a log in place of receiving OSC
+		std::shared_ptr<OSCReplayer> replayer;
 
 		ofxHapPlayer player;
-        ofxHapImageSequence sequence;
-        ofxHapImage image;
-        Playlist playlist;
+        // Declared before the movie using it, so it is destroyed after
+        SharedFrameCache shared_frame_cache;
+        HapMovie hap_movie;
+        SourceLoader source_loader;
+        std::shared_ptr<SourceLoader::Source> source;
+        FramePrefetcher prefetcher;
+        FramePrefetcher::Frame image;
+        // Sequence and playlist frames are uploaded to this when drawn, uploaded_image last
+        HapTexture image_texture;
+        FramePrefetcher::Frame uploaded_image;
+        // Declared after the caches it governs, so it is destroyed first
+        MemoryGovernor memory_governor;
     
         enum SourceType {
+            SourceNone,
             SourceSequence,
             SourceMovie,
+            SourceHapMovie,
             SourcePlaylist
         };
         SourceType source_type;
-        std::string frame_number_errors;
 
         ofPoint image_dimensions;
 